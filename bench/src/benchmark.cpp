@@ -0,0 +1,364 @@
+/**
+ * Benchmarks every solver method on the shapes of the three example problems,
+ * over a range of grid sizes, and writes the results as CSV and/or JSON so that
+ * builds can be compared.
+ *
+ * benchmark [--sizes 128,256,...] [--geometries problem1,problem2,problem3]
+ *           [--methods sor,multigrid,...] [--repetitions 3] [--warmup 1]
+ *           [--time-limit 60] [--csv file] [--json file] [--help]
+ *
+ * Each size is the number of points along each side of a square grid. Every
+ * solve is timed (wall clock) after the warm up solves, and the minimum, median,
+ * mean and standard deviation of the times are reported, along with the number
+ * of unknowns solved per second (using the median), the number of iterations, the
+ * relative residual of the result and the peak resident memory of the process
+ * while solving. The peak memory leaves out the worker processes forked by the
+ * decomposed method: the potentials they share are counted (the benchmark process
+ * reads all of them at the end of each solve), but their own memory isn't, as the
+ * peak of the child processes can't be reset between benchmarks. Values that
+ * aren't finite (eg the residual of a solve that diverged) are written as null
+ * in the JSON file.
+ *
+ * Bigger grids take at least four times as long each time the size doubles, so
+ * once a method has taken more than a quarter of the time limit on a geometry,
+ * it is skipped for larger sizes of that geometry.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "finiteDiffDecomposed.h"
+#include "finiteDiffIterative.h"
+#include "finiteDiffMatrix.h"
+#include "finiteDiffMultigrid.h"
+#include "finiteDiffQuadtree.h"
+#include "stencilEngine.h"
+#include "stencilOperator.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+/* A solver method, returning the number of iterations (-1 if it doesn't have any
+ * or doesn't report them).
+ */
+struct Method {
+    std::string name;
+    std::function<int(const electrostatics::UnsolvedElectrostaticSystem&,
+            electrostatics::SolvedElectrostaticSystem&)> solve;
+};
+
+struct Result {
+    std::string geometry;
+    int size;
+    std::string method;
+    long unknowns;
+    int repetitions;
+    double minSeconds, medianSeconds, meanSeconds, stddevSeconds;
+    double unknownsPerSecond;
+    int iterations;
+    double relativeResidual;
+    long peakRSSKiB;
+    std::string status;     // "ok", "skipped", or the error message
+};
+
+std::vector<Method> allMethods() {
+    std::vector<Method> methods;
+    methods.push_back({"iterative1000", [](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+            electrostatics::SolvedElectrostaticSystem &solved) {
+        electrostatics::finiteDiffIterative(unsolved, solved, 1000);
+        return 1000;
+    }});
+    methods.push_back({"sor", [](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+            electrostatics::SolvedElectrostaticSystem &solved) {
+        return electrostatics::finiteDiffSOR(unsolved, solved, 1e-8);
+    }});
+    methods.push_back({"sormixed", [](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+            electrostatics::SolvedElectrostaticSystem &solved) {
+        return electrostatics::finiteDiffSORMixed(unsolved, solved, 1e-8);
+    }});
+    methods.push_back({"decomposed", [](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+            electrostatics::SolvedElectrostaticSystem &solved) {
+        return electrostatics::finiteDiffDecomposed(unsolved, solved, 0, 1e-8);
+    }});
+    methods.push_back({"multigrid", [](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+            electrostatics::SolvedElectrostaticSystem &solved) {
+        return electrostatics::finiteDiffMultigrid(unsolved, solved, 1e-8);
+    }});
+    for(std::string matrixMethod : {"eigenbicon", "eigenbiconmatrixfree", "eigencg", "eigencgmixed",
+            "eigenbiconmixed", "eigenldlt", "eigensparselu", "viennabicon"}) {
+        methods.push_back({matrixMethod, [matrixMethod](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+                electrostatics::SolvedElectrostaticSystem &solved) {
+            // Every repetition should include the factorization
+            electrostatics::clearFactorizationCache();
+            return electrostatics::finiteDiffMatrix(unsolved, solved, matrixMethod);
+        }});
+    }
+    methods.push_back({"quadtree", [](const electrostatics::UnsolvedElectrostaticSystem &unsolved,
+            electrostatics::SolvedElectrostaticSystem &solved) {
+        electrostatics::finiteDiffQuadtree(unsolved, solved);
+        return -1;
+    }});
+    return methods;
+}
+
+/* The shapes of problems 1-3 (see the cfg directory), scaled to a size by size grid. */
+electrostatics::UnsolvedElectrostaticSystem makeGeometry(std::string geometry, int size) {
+    int low = -size/2;
+    int high = low + size - 1;
+    electrostatics::UnsolvedElectrostaticSystem system(low, high, low, high);
+    if(geometry == "problem1") {
+        system.setBoundaryCircle(0, 0, size/10.0, 0);
+        system.setBoundaryRing(0, 0, high, 100);
+    }
+    else if(geometry == "problem2") {
+        system.setBoundaryCircle(0, 0, size/5.0, 0);
+        system.setLeftBoundary(50);
+        system.setRightBoundary(-50);
+    }
+    else if(geometry == "problem3") {
+        system.setTopBoundary(-100);
+        system.setBottomBoundary(-100);
+        for(int n=-2; n<=2; n++) system.setBoundaryCircle(n*size/6, 0, std::max(2.0, size/100.0), 0);
+    }
+    else throw std::invalid_argument("Unknown geometry " + geometry);
+    return system;
+}
+
+/* Resets the peak resident memory of the process (VmHWM) to the current amount,
+ * if the kernel allows it.
+ */
+void resetPeakRSS() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if(clearRefs) clearRefs << "5";
+}
+
+long peakRSSKiB() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.compare(0, 6, "VmHWM:") == 0) return std::stol(line.substr(6));
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+Result runBenchmark(const Method &method, std::string geometry, int size, int repetitions, int warmup) {
+    Result result = {geometry, size, method.name, 0, repetitions, 0, 0, 0, 0, 0, -1, 0, 0, "ok"};
+    electrostatics::UnsolvedElectrostaticSystem unsolved = makeGeometry(geometry, size);
+    result.unknowns = (long)size*size - unsolved.getBoundaryConditionPositions().count();
+    electrostatics::SolvedElectrostaticSystem solved(unsolved.getIMin(), unsolved.getIMax(),
+            unsolved.getJMin(), unsolved.getJMax());
+
+    resetPeakRSS();
+    for(int run=0; run<warmup; run++) method.solve(unsolved, solved);
+    std::vector<double> times;
+    for(int run=0; run<repetitions; run++) {
+        auto start = std::chrono::steady_clock::now();
+        result.iterations = method.solve(unsolved, solved);
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    result.peakRSSKiB = peakRSSKiB();
+    result.relativeResidual = electrostatics::relativeResidual(unsolved, solved);
+
+    std::sort(times.begin(), times.end());
+    result.minSeconds = times.front();
+    result.medianSeconds = (times[(repetitions-1)/2] + times[repetitions/2]) / 2;
+    double sum = 0;
+    for(double time : times) sum += time;
+    result.meanSeconds = sum / repetitions;
+    double squares = 0;
+    for(double time : times) squares += (time - result.meanSeconds) * (time - result.meanSeconds);
+    result.stddevSeconds = (repetitions > 1) ? sqrt(squares / (repetitions-1)) : 0;
+    result.unknownsPerSecond = (result.medianSeconds > 0) ? result.unknowns / result.medianSeconds : 0;
+    return result;
+}
+
+std::vector<std::string> splitList(std::string list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while(std::getline(stream, item, ',')) {
+        if(!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+/* JSON has no infinity or NaN, so they are written as null. */
+std::string jsonNumber(double value) {
+    if(!std::isfinite(value)) return "null";
+    std::ostringstream number;
+    number << value;
+    return number.str();
+}
+
+void printUsage(std::ostream &output) {
+    output << "Usage: benchmark [--sizes 128,256,...] [--geometries problem1,problem2,problem3]\n"
+        "                 [--methods sor,multigrid,...] [--repetitions 3] [--warmup 1]\n"
+        "                 [--time-limit 60] [--csv file] [--json file] [--help]\n";
+}
+
+/* Quotes a string for CSV (quoteCharacter '"') or JSON (quoteCharacter '\\'). In
+ * JSON every control character is escaped, as error messages can hold any of them.
+ */
+std::string quote(std::string text, char quoteCharacter) {
+    bool json = (quoteCharacter == '\\');
+    std::string quoted(1, '"');
+    for(char c : text) {
+        if(json && (unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+            quoted += escaped;
+            continue;
+        }
+        if(c == '"') quoted += quoteCharacter;
+        if(c == '\\' && json) quoted += '\\';
+        if(c == '\n') c = ' ';
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+void writeCSV(std::ostream &output, const std::vector<Result> &results) {
+    output << "geometry,size,method,unknowns,repetitions,minSeconds,medianSeconds,meanSeconds,stddevSeconds,"
+        "unknownsPerSecond,iterations,relativeResidual,peakRSSKiB,status\n";
+    for(const Result &result : results) {
+        output << result.geometry << "," << result.size << "," << result.method << "," << result.unknowns << ","
+            << result.repetitions << "," << result.minSeconds << "," << result.medianSeconds << ","
+            << result.meanSeconds << "," << result.stddevSeconds << "," << result.unknownsPerSecond << ","
+            << result.iterations << "," << result.relativeResidual << "," << result.peakRSSKiB << ","
+            << quote(result.status, '"') << "\n";
+    }
+}
+
+void writeJSON(std::ostream &output, const std::vector<Result> &results) {
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    bool openMP = false;
+#ifdef _OPENMP
+    openMP = true;
+#endif
+
+    output << "{\n  \"build\": {\"compiler\": " << quote(__VERSION__, '\\') << ", \"openmp\": "
+        << (openMP ? "true" : "false") << ", \"stencilInstructionSet\": "
+        << quote(electrostatics::stencilInstructionSet(), '\\') << ", \"date\": \"" << date << "\"},\n";
+    output << "  \"results\": [";
+    for(int n=0; n<(int)results.size(); n++) {
+        const Result &result = results[n];
+        output << (n ? ",\n" : "\n") << "    {\"geometry\": \"" << result.geometry << "\", \"size\": " << result.size
+            << ", \"method\": \"" << result.method << "\", \"unknowns\": " << result.unknowns
+            << ", \"repetitions\": " << result.repetitions << ", \"minSeconds\": " << jsonNumber(result.minSeconds)
+            << ", \"medianSeconds\": " << jsonNumber(result.medianSeconds) << ", \"meanSeconds\": "
+            << jsonNumber(result.meanSeconds) << ", \"stddevSeconds\": " << jsonNumber(result.stddevSeconds)
+            << ", \"unknownsPerSecond\": " << jsonNumber(result.unknownsPerSecond) << ", \"iterations\": "
+            << result.iterations << ", \"relativeResidual\": " << jsonNumber(result.relativeResidual)
+            << ", \"peakRSSKiB\": " << result.peakRSSKiB
+            << ", \"status\": " << quote(result.status, '\\') << "}";
+    }
+    output << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> sizes = {128, 256, 512, 1024, 2048, 4096};
+    std::vector<std::string> geometries = {"problem1", "problem2", "problem3"};
+    std::vector<Method> methods = allMethods();
+    int repetitions = 3;
+    int warmup = 1;
+    double timeLimit = 60;
+    std::string csvFile, jsonFile;
+
+    std::string option;
+    try {
+        for(int arg=1; arg<argc; arg++) {
+            option = argv[arg];
+            if(option == "--help" || option == "-h") {
+                printUsage(std::cout);
+                return 0;
+            }
+            if(arg+1 >= argc) {
+                std::cerr << "Missing value for " << option << "\n";
+                printUsage(std::cerr);
+                return 1;
+            }
+            std::string value = argv[++arg];
+            if(option == "--sizes") {
+                sizes.clear();
+                for(std::string size : splitList(value)) sizes.push_back(std::stoi(size));
+            }
+            else if(option == "--geometries") geometries = splitList(value);
+            else if(option == "--methods") {
+                std::vector<Method> chosen;
+                for(std::string name : splitList(value)) {
+                    auto found = std::find_if(methods.begin(), methods.end(),
+                            [&](const Method &method) { return method.name == name; });
+                    if(found == methods.end()) {
+                        std::cerr << "Unknown method " << name << "\n";
+                        return 1;
+                    }
+                    chosen.push_back(*found);
+                }
+                methods = chosen;
+            }
+            else if(option == "--repetitions") repetitions = std::max(1, std::stoi(value));
+            else if(option == "--warmup") warmup = std::max(0, std::stoi(value));
+            else if(option == "--time-limit") timeLimit = std::stod(value);
+            else if(option == "--csv") csvFile = value;
+            else if(option == "--json") jsonFile = value;
+            else {
+                std::cerr << "Unknown option " << option << "\n";
+                printUsage(std::cerr);
+                return 1;
+            }
+        }
+    }
+    // std::stoi and std::stod throw for values that aren't numbers
+    catch(const std::exception &error) {
+        std::cerr << "Invalid value for " << option << " (" << error.what() << ")\n";
+        printUsage(std::cerr);
+        return 1;
+    }
+
+    std::vector<Result> results;
+    for(std::string geometry : geometries) {
+        for(const Method &method : methods) {
+            bool tooSlow = false;
+            for(int size : sizes) {
+                std::cerr << geometry << " " << size << " " << method.name << "... " << std::flush;
+                Result result = {geometry, size, method.name, 0, 0, 0, 0, 0, 0, 0, -1, 0, 0, "skipped"};
+                if(!tooSlow) {
+                    try {
+                        result = runBenchmark(method, geometry, size, repetitions, warmup);
+                        tooSlow = result.medianSeconds > timeLimit/4;
+                    }
+                    catch(const std::exception &error) {
+                        result.status = error.what();
+                        tooSlow = true;
+                    }
+                }
+                std::cerr << result.status << " " << result.medianSeconds << "s\n";
+                results.push_back(result);
+            }
+        }
+    }
+
+    if(!jsonFile.empty()) {
+        std::ofstream output(jsonFile);
+        writeJSON(output, results);
+    }
+    if(!csvFile.empty()) {
+        std::ofstream output(csvFile);
+        writeCSV(output, results);
+    }
+    else writeCSV(std::cout, results);
+    return 0;
+}
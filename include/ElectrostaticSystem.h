@@ -32,6 +32,7 @@
 
 #include <Eigen/Dense>
 #include <string>
+#include "GridView.h"
 
 namespace electrostatics{
 
@@ -70,23 +71,49 @@ class ElectrostaticSystem {
         void setPotentialIJ(int i, int j, double potential);
         void setPotentialK(long k, double potential);
 
+        /* Get/set the potentials at every position at once, indexed (i-iMin, j-jMin). */
+        const doubleGrid& getPotentials() const { return potentials; }
+        void setPotentials(const doubleGrid &newPotentials);
 
-        /* Convert between (i, j) coordinates and (k) positions. */
+        /* Unchecked access to the potentials, indexed by (i, j), for loops over the
+         * whole system (see GridView).
+         */
+        GridView<double> potentialView() {
+            return GridView<double>(potentials.data(), iMin, jMin, getLengthI(), getLengthJ());
+        }
+        GridView<const double> potentialView() const {
+            return GridView<const double>(potentials.data(), iMin, jMin, getLengthI(), getLengthJ());
+        }
+
+
+        /* Convert between (i, j) coordinates and (k) positions. The version of k2ij
+         * that returns an array allocates it with new[], so it must be deleted.
+         */
         long ij2k(int i, int j) const;
         int* k2ij(long k) const;
+        void k2ij(long k, int &i, int &j) const;
 
         /* Print out the system potentials in the grid form described above. */
         void print() const;
 
         /* Save a file with the specified name containing the system potentials in the 
-         * correct format for using with GNU Plot.
+         * correct format for using with GNU Plot. The potentials are written to 6
+         * significant figures, or if roundTrip is true with as many as are needed to
+         * read back exactly the same value.
          */
-        void saveFile(std::string fileName) const;
+        void saveFile(std::string fileName, bool roundTrip=false) const;
 
         /* Compare this system to otherSystem. Stores the absoulte difference in the relevant
          * position of comparisonResults.
         */
         void compareTo(const ElectrostaticSystem &otherSystem, ElectrostaticSystem &comparisonResults);
+
+        /* Set the potentials to the absolute difference between the potentials in
+         * two views (eg of systems or mapped solution files). Their dimensions must
+         * match the system. Either view can be of doubles or floats.
+         */
+        template<typename ScalarA, typename ScalarB>
+        void setDifference(GridView<const ScalarA> potentialsA, GridView<const ScalarB> potentialsB);
 };
 
 } // namespace electrostatics
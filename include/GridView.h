@@ -0,0 +1,94 @@
+/**
+ * Fast access to the grids of an ElectrostaticSystem for loops that visit every point.
+ *
+ * A GridView points at the data of a grid (eg the potentials or boundary
+ * condition positions), stored the same way as in ElectrostaticSystem: column
+ * major, so position (k) is at k = (i-iMin) + (j-jMin)*lengthI and each row j
+ * is a contiguous run of lengthI values.
+ *
+ * Unlike getPotentialIJ etc, nothing is range checked, so it should only be used
+ * with positions that are known to be in the grid. The view doesn't own the
+ * data, and is only valid while the grid it was made from exists and isn't
+ * resized.
+ *
+ * eg, to add one to every potential:
+ *
+ * GridView<double> potentials = system.potentialView();
+ * for(int j=potentials.getJMin(); j<=potentials.getJMax(); j++) {
+ *     for(double &potential : potentials.row(j)) potential += 1;
+ * }
+ */
+
+#ifndef GRIDVIEW_H
+#define GRIDVIEW_H
+
+namespace electrostatics {
+
+/* A row of a grid, indexed by i. Can be used with range based for loops. */
+template<typename Scalar>
+class RowSpan {
+    protected:
+        Scalar *first;
+        int iMin, length;
+
+    public:
+        RowSpan(Scalar *first, int iMin, int length) : first(first), iMin(iMin), length(length) {}
+
+        Scalar& operator[](int i) const { return first[i-iMin]; }
+        Scalar* begin() const { return first; }
+        Scalar* end() const { return first + length; }
+        int size() const { return length; }
+};
+
+template<typename Scalar>
+class GridView {
+    protected:
+        Scalar *data;
+        int iMin, jMin, lengthI, lengthJ;
+
+    public:
+        /* Constructor */
+        GridView(Scalar *data, int iMin, int jMin, int lengthI, int lengthJ) :
+            data(data), iMin(iMin), jMin(jMin), lengthI(lengthI), lengthJ(lengthJ) {}
+
+        /* A read only view can be made from a writable one. */
+        template<typename OtherScalar>
+        GridView(const GridView<OtherScalar> &other) :
+            data(other.getData()), iMin(other.getIMin()), jMin(other.getJMin()),
+            lengthI(other.getLengthI()), lengthJ(other.getLengthJ()) {}
+
+
+        /* Methods */
+
+        int getIMin() const { return iMin; }
+        int getIMax() const { return iMin + lengthI - 1; }
+        int getJMin() const { return jMin; }
+        int getJMax() const { return jMin + lengthJ - 1; }
+        int getLengthI() const { return lengthI; }
+        int getLengthJ() const { return lengthJ; }
+        long getKMax() const { return (long)lengthI*lengthJ - 1; }
+        Scalar* getData() const { return data; }
+
+        /* The value at position (i, j) or (k). */
+        Scalar& operator()(int i, int j) const { return data[(i-iMin) + (long)(j-jMin)*lengthI]; }
+        Scalar& atK(long k) const { return data[k]; }
+
+        /* Row j of the grid. */
+        RowSpan<Scalar> row(int j) const { return RowSpan<Scalar>(data + (long)(j-jMin)*lengthI, iMin, lengthI); }
+
+        /* Calls function(i, j, value) for every position, a row at a time. */
+        template<typename Function>
+        void forEachIJ(Function function) const {
+            Scalar *value = data;
+            for(int j=jMin; j<jMin+lengthJ; j++) {
+                for(int i=iMin; i<iMin+lengthI; i++) {
+                    function(i, j, *value);
+                    value++;
+                }
+            }
+        }
+};
+
+} // namespace electrostatics
+
+#endif
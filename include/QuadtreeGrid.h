@@ -0,0 +1,148 @@
+/**
+ * A class to represent an UnsolvedElectrostaticSystem on an adaptively refined
+ * (quadtree) grid, so that it can be solved with far fewer unknowns than there are
+ * points in the system.
+ *
+ * The points of the system are grouped into square leaves of 2^level by 2^level
+ * points, which are found by splitting the square containing the whole system
+ * into four until the leaves are allowed:
+ * - leaves must be inside the system
+ * - boundary conditions are always single points (level 0)
+ * - leaves other than single points can't have any boundary conditions within
+ *   refinementMargin points of them
+ * - neighbouring leaves can't differ by more than one level
+ * so the leaves only get bigger away from boundary conditions as fast as the last
+ * rule allows. The margin is the same for leaves of every size, so big leaves can
+ * be used close to long plates.
+ *
+ * Each leaf has a single potential, at its centre. The equations are the finite
+ * volume form of the finite difference equations: the sum, over the edges a leaf
+ * shares with its neighbours, of
+ * (length of shared edge) * (neighbour potential - leaf potential) / (distance between centres)
+ * is zero, with a correction where a leaf is next to a bigger one (see solve).
+ * When every leaf is a single point this is exactly the equation used for the
+ * uniform grid (see finiteDiffMatrix).
+ *
+ * Away from the boundary conditions it is the error indicators that decide how
+ * big the leaves are: after solving, adapt splits leaves where the potential isn't
+ * close to quadratic and joins groups of four where it is, so the grid can be
+ * refined until the error is small enough everywhere.
+ */
+
+#ifndef QUADTREEGRID_H
+#define QUADTREEGRID_H
+
+#include <Eigen/Dense>
+#include <utility>
+#include <vector>
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+struct QuadtreeLeaf {
+    int a, b;           // Position (from zero) of the bottom left point of the leaf
+    int level;          // The leaf is 2^level by 2^level points
+    bool boundaryCondition;
+};
+
+/* Quadratic fit of the potential around the centre of a leaf, where the potential
+ * at (x, y) from the centre is potential + gradientA*x + gradientB*y +
+ * curvatureA*x^2/2 + curvatureB*y^2/2 + curvatureAB*x*y.
+ */
+struct QuadtreeFit {
+    double gradientA, gradientB;
+    double curvatureA, curvatureB, curvatureAB;
+};
+
+class QuadtreeGrid {
+    protected:
+        const UnsolvedElectrostaticSystem &unsolvedSystem;
+        int lengthI, lengthJ;
+        int rootLevel, maxLevel;
+        int refinementMargin;
+
+        // Number of boundary conditions in the points below and to the left of (a, b)
+        Eigen::Matrix<long, Eigen::Dynamic, Eigen::Dynamic> boundaryConditionSums;
+
+        std::vector<QuadtreeLeaf> leaves;
+        Eigen::VectorXd potentials;     // Potential of each leaf
+        Eigen::MatrixXi leafIndex;      // Leaf containing each point, indexed (a, b)
+
+        long boundaryConditionsIn(int aMin, int bMin, int aEnd, int bEnd) const;
+        bool canBeLeaf(int a, int b, int level) const;
+        void build(int a, int b, int level, std::vector<QuadtreeLeaf> &newLeaves,
+                std::vector<double> &newPotentials) const;
+        void split(int leaf, std::vector<QuadtreeLeaf> &newLeaves, std::vector<double> &newPotentials) const;
+        void setLeaves(std::vector<QuadtreeLeaf> &newLeaves, std::vector<double> &newPotentials);
+        bool balance();
+
+        /* Calls function(neighbour, sharedLength) for each neighbouring leaf on one
+         * side of leaf (0 right, 1 left, 2 above, 3 below).
+         */
+        template<typename Function>
+        void forEachNeighbour(int leaf, int side, Function function) const;
+
+        /* Average potential gradient across each side of leaf (zero at the edges of
+         * the system), in the same order as forEachNeighbour, and the distance from
+         * the centre of the leaf to where it is found.
+         */
+        void sideGradients(int leaf, double gradients[4], double distances[4],
+                const std::vector<QuadtreeFit> *fits=nullptr) const;
+
+        /* Quadratic fit of the potential across each leaf, from its neighbours. */
+        std::vector<QuadtreeFit> quadraticFits() const;
+
+        /* Adds (leaf, coefficient) pairs to terms that sum to scale * the potential
+         * gradient of leaf along axis (0 for a, 1 for b), as in sideGradients.
+         */
+        void gradientTerms(int leaf, int axis, double scale, std::vector<std::pair<int, double> > &terms) const;
+
+    public:
+        /* Constructor - makes the coarsest grid allowed for the boundary conditions,
+         * with each leaf starting at the average of initialGuess over it (or zero if
+         * it is null). The grid is only valid while unsolvedSystem exists.
+         */
+        QuadtreeGrid(const UnsolvedElectrostaticSystem &unsolvedSystem, int maxLevel=5,
+                int refinementMargin=2, const ElectrostaticSystem *initialGuess=nullptr);
+
+
+        /* Methods */
+
+        const std::vector<QuadtreeLeaf>& getLeaves() const { return leaves; }
+        long getNumberOfLeaves() const { return leaves.size(); }
+        long getNumberOfUnknowns() const;
+        const Eigen::VectorXd& getPotentials() const { return potentials; }
+
+        /* Number of the leaf containing position (i, j). Throws std::out_of_range if
+         * it isn't in the system.
+         */
+        int findLeaf(int i, int j) const;
+
+        /* Solve for the potential of every leaf, using the current potentials as the
+         * starting guess, until the relative residual is less than tolerance. Returns
+         * the number of iterations.
+         */
+        int solve(double tolerance=1e-10);
+
+        /* Estimate of the error in the potential of each leaf from assuming it is
+         * quadratic across the leaf: the size of the cubic term at its edge, from the
+         * change in curvature between the leaf and its neighbours.
+         */
+        Eigen::VectorXd errorIndicators() const;
+
+        /* Split leaves with an error indicator more than refinementTolerance, and join
+         * groups of four leaves with error indicators less than a sixteenth of it
+         * (where allowed). Returns true if the grid changed. Should be followed by solve.
+         */
+        bool adapt(double refinementTolerance);
+
+        /* Set the potential of every point in solvedSystem (which must have the same
+         * extents), from the quadratic fit of the potential across each leaf.
+         */
+        void resample(SolvedElectrostaticSystem &solvedSystem) const;
+};
+
+} // namespace electrostatics
+
+#endif
@@ -4,8 +4,11 @@
  * Inherits from ElectrostaticSystem, adding methods that wouldn't
  * make sense for an unsolved system, eg plotting, finding equipotentials etc.
  *
- * This extra functionallity has not yet been implemented, so it is currently
- * the exact same as ElectrostaticSystem.
+ * The electric field is found from the potentials whenever it is needed (a row
+ * at a time, or at single points) rather than stored, so it never needs any more
+ * memory than the potentials, and is always up to date with them. It is
+ * E = -grad(potential), with central differences, or one sided differences at
+ * the edges of the grid.
  */
 
 #ifndef SOLVEDELECTROSTATICSYSTEM_H
@@ -18,13 +21,6 @@
 namespace electrostatics {
 
 class SolvedElectrostaticSystem : public ElectrostaticSystem{
-    protected:
-        doubleGrid field;   // Strength of the field
-        doubleGrid fieldX;  // Component of field in x direction
-        doubleGrid fieldY;  // Component of field in y direction
-        bool fieldFound;    // True if the field has been found
-        double maxField;    // The maximum magnitude of the field
-
     public:
         /* Constructors */
         SolvedElectrostaticSystem(int iMin, int iMax, int jMin, int jMax);
@@ -32,11 +28,33 @@ class SolvedElectrostaticSystem : public ElectrostaticSystem{
 
         /* Methods */
 
-        /* Calculates the components of the field and stores them in fieldX and fieldY. */
-        void findField();
-
-        /* Saves the magnitude of the field in a file that gnuplot can plot easily. */
-        void saveFieldGNUPlot(std::string fileName);
+        /* Get the components of the field at position (i, j). Throws
+         * std::out_of_range if (i, j) isn't in the grid.
+         */
+        void getFieldIJ(int i, int j, double &fieldX, double &fieldY) const;
+
+        /* Find the components of the field along row j, writing the field at i to
+         * fieldX[i-iMin] and fieldY[i-iMin] (so each needs space for lengthI values).
+         * Throws std::out_of_range if j isn't in the grid.
+         */
+        void findFieldRow(int j, double *fieldX, double *fieldY) const;
+
+        /* Find the largest magnitude of the field anywhere in the grid. */
+        double findMaxField() const;
+
+        /* Saves the direction of the field in a file that gnuplot can plot easily,
+         * written the same way as by saveFile.
+         */
+        void saveFieldGNUPlot(std::string fileName, bool roundTrip=false) const;
+
+        /* As above, but only at every spacing'th point in each direction, starting
+         * from (iStart, jStart) and going no further than (iEnd, jEnd), eg for
+         * plotting arrows. Throws std::out_of_range if the region isn't in the grid
+         * and std::invalid_argument if spacing is less than 1 or the region is
+         * empty.
+         */
+        void saveFieldGNUPlot(std::string fileName, int spacing, int iStart, int iEnd, int jStart, int jEnd,
+                bool roundTrip=false) const;
 };
 
 } // namespace electrostatics
@@ -0,0 +1,69 @@
+/**
+ * A class to hold the solutions needed to find the potentials of an
+ * UnsolvedElectrostaticSystem for any combination of electrode voltages.
+ *
+ * The finite difference equations are linear, so if each electrode is solved
+ * for at 1V with every other boundary condition at 0V, the solution for any
+ * set of electrode voltages is the sum of those solutions multiplied by the
+ * electrode voltages. The boundary conditions that don't belong to an electrode
+ * keep their potentials, and are solved for together (with all the electrodes
+ * at 0V) as one more solution that is always added on.
+ *
+ * All the solutions are found at once, using a single factorization of the
+ * reduced system of equations (see reducedSystem in finiteDiffMatrix.h).
+ */
+
+#ifndef SUPERPOSITIONBASIS_H
+#define SUPERPOSITIONBASIS_H
+
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include "ElectrostaticSystem.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+class SuperpositionBasis {
+    protected:
+        int iMin, iMax, jMin, jMax;
+        std::vector<std::string> electrodeNames;
+        std::vector<double> defaultVoltages;    // Voltages given in the unsolved system
+        std::vector<doubleGrid> electrodeSolutions;
+        doubleGrid fixedSolution;   // Solution for boundary conditions not in an electrode
+
+    public:
+        /* Constructor - solves for every electrode of unsolvedSystem. Each electrode
+         * must have a single voltage, or std::invalid_argument is thrown.
+         */
+        SuperpositionBasis(const UnsolvedElectrostaticSystem &unsolvedSystem);
+
+
+        /* Methods */
+
+        /* Get min/max values for i and j. */
+        int getIMin() const { return iMin; }
+        int getIMax() const { return iMax; }
+        int getJMin() const { return jMin; }
+        int getJMax() const { return jMax; }
+
+        /* Get the names of the electrodes, in the same order as their voltages. */
+        const std::vector<std::string>& getElectrodeNames() const { return electrodeNames; }
+
+        /* Get the voltage of each electrode in the unsolved system. */
+        const std::vector<double>& getDefaultVoltages() const { return defaultVoltages; }
+
+        /* Get the number of an electrode from its name. Throws std::invalid_argument
+         * if there isn't an electrode with that name.
+         */
+        int getElectrodeNumber(std::string name) const;
+
+        /* Stores the solution with the specified electrode voltages (one for each
+         * electrode, in the same order as the electrode names) in solvedSystem.
+         */
+        void combine(const std::vector<double> &voltages, SolvedElectrostaticSystem &solvedSystem) const;
+};
+
+} // namespace electrostatics
+#endif
@@ -0,0 +1,72 @@
+/**
+ * A class to run tasks (eg the commands of a .cfg file) on several threads, while
+ * giving the same results as running them one at a time in order.
+ *
+ * Each task lists the names of the resources (eg systems or files) it reads and
+ * writes. A task has to wait for:
+ * - the last earlier task that writes any resource it reads or writes
+ * - any earlier tasks that read a resource it writes, since the last write
+ * Tasks that don't have to wait for each other can run at the same time.
+ *
+ * A barrier task waits for every earlier task, and every later task waits for it,
+ * so it always runs on its own (eg for timers).
+ *
+ * Anything a task writes to the output stream it is given is stored, and written
+ * to the real output in the order the tasks were added, so the output is the same
+ * however many threads are used.
+ */
+
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace electrostatics {
+
+class TaskGraph {
+    protected:
+        struct Task {
+            std::function<void(std::ostream&)> function;
+            std::vector<int> dependencies;
+        };
+        std::vector<Task> tasks;
+
+        // For finding dependencies as tasks are added
+        std::unordered_map<std::string, int> lastWriter;
+        std::unordered_map<std::string, std::vector<int> > readersSinceWrite;
+        int lastBarrier;
+
+        void runInOrder(std::ostream &output);
+        void runInParallel(int threads, std::ostream &output);
+
+    public:
+        /* Constructor */
+        TaskGraph() : lastBarrier(-1) {}
+
+
+        /* Methods */
+
+        /* Add a task, returning its number (from 0, in the order they are added). */
+        int addTask(std::function<void(std::ostream&)> function, const std::vector<std::string> &reads,
+                const std::vector<std::string> &writes, bool barrier=false);
+
+        int getNumberOfTasks() const { return tasks.size(); }
+
+        /* Numbers of the tasks that task has to wait for (in increasing order). */
+        const std::vector<int>& getDependencies(int task) const { return tasks.at(task).dependencies; }
+
+        /* Run every task, using up to threads threads. With one thread the tasks are
+         * run in order, writing straight to output. If a task throws an exception, no
+         * more tasks are started, and once the output of the tasks before it has been
+         * written, it is thrown again.
+         */
+        void run(int threads, std::ostream &output);
+};
+
+} // namespace electrostatics
+
+#endif
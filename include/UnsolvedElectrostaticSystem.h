@@ -14,12 +14,28 @@
  *
  * would mean that positions 2, 4, 6, 7 and 8 of the potentials are boundary 
  * conditions, while the other positions are unknown points.
+ *
+ * Boundary conditions can also belong to named electrodes. While an electrode
+ * is selected, any boundary conditions that are set become part of it. This is
+ * used to solve for the contribution of each electrode separately (see
+ * SuperpositionBasis).
+ *
+ * The shapes are drawn a row at a time: the part of each row covered by the
+ * shape is worked out and clipped to the grid, then filled in one go, so shapes
+ * partly (or completely) off the grid cost nothing extra. Only rings and circles
+ * are clipped like this: points, lines and rectangles that go off the grid throw
+ * std::out_of_range, without setting anything. The points that aren't
+ * boundary conditions can also be listed as runs along each row (see
+ * interiorSpans), so solvers can skip over the boundary conditions without
+ * testing every point.
  */
 
 #ifndef UNSOLVEDELECTROSTATICSYSTEM_H
 #define UNSOLVEDELECTROSTATICSYSTEM_H
 
 #include <Eigen/Dense>
+#include <string>
+#include <vector>
 #include "ElectrostaticSystem.h"
 
 namespace electrostatics {
@@ -27,11 +43,41 @@ namespace electrostatics {
 // Matrix to represent a grid of boolean values    
 typedef Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> boolGrid; 
 
+/* A run of points along a row, from a=start to a=end-1 (positions in the row,
+ * from 0).
+ */
+struct PointSpan {
+    int start, end;
+};
+
+/* Runs of points for each row of a grid, run-length encoded: the runs in row b
+ * (from 0) are spans[rowStarts[b]] to spans[rowStarts[b+1]-1], in order along
+ * the row.
+ */
+struct RowSpans {
+    std::vector<long> rowStarts;
+    std::vector<PointSpan> spans;
+};
+
 class UnsolvedElectrostaticSystem : public ElectrostaticSystem{
     protected:
         /* Boolean grid to mark the positions of the boundary conditions. */
         boolGrid boundaryConditionPositions; 
 
+        /* Names of the electrodes, the electrode number (index in electrodeNames)
+         * of each position or -1 if it isn't part of an electrode, and the
+         * currently selected electrode (-1 if none). electrodeNumbers is empty
+         * until the first electrode is selected.
+         */
+        std::vector<std::string> electrodeNames;
+        Eigen::MatrixXi electrodeNumbers;
+        int currentElectrode;
+
+        /* Set the points from i=iStart to i=iEnd of row j as boundary conditions
+         * with the specified potential, leaving out any that aren't on the grid.
+         */
+        void setBoundarySpan(int j, int iStart, int iEnd, double potential);
+
     public:
         /* Constructor */
         UnsolvedElectrostaticSystem(int iMin, int iMax, int jMin, int jMax);
@@ -39,14 +85,43 @@ class UnsolvedElectrostaticSystem : public ElectrostaticSystem{
 
         /* Methods */
 
+        /* Get the grid marking the positions of all the boundary conditions. */
+        const boolGrid& getBoundaryConditionPositions() const { return boundaryConditionPositions; }
+
+        /* Unchecked access to the boundary condition positions, indexed by (i, j) (see GridView). */
+        GridView<const bool> boundaryConditionView() const {
+            return GridView<const bool>(boundaryConditionPositions.data(), iMin, jMin, getLengthI(), getLengthJ());
+        }
+
         /* Test if position (i, j) or (k) is a boundary condition. */
         bool isBoundaryConditionIJ(int i, int j) const;
         bool isBoundaryConditionK(long k) const;
 
+        /* The runs of points along each row that aren't boundary conditions. */
+        RowSpans interiorSpans() const;
+
         /* Set/unset position (i, j) or (k) as a boundary condition. */
         void setBoundaryConditionIJ(int i, int j, bool isBoundaryCondition);
         void setBoundaryConditionK(long k, bool isBoundaryCondition);
 
+        /* Select the electrode (creating it if it is new) that any boundary conditions
+         * set from now on will belong to, or deselect it so they don't belong to one.
+         */
+        void selectElectrode(std::string name);
+        void deselectElectrode();
+
+        /* Get the names of all the electrodes. */
+        const std::vector<std::string>& getElectrodeNames() const { return electrodeNames; }
+
+        /* Get the number of the electrode at position (i, j), or -1 if it isn't part of one. */
+        int getElectrodeIJ(int i, int j) const;
+
+        /* Get the potentials to start solving from: the boundary conditions, with the
+         * other points taken from initialGuess (or zero if initialGuess is null).
+         * initialGuess must have the same extents as this system.
+         */
+        doubleGrid startingPotentials(const ElectrostaticSystem *initialGuess) const;
+
         /* Set a point as a boundary condition with specified potential. */
         void setBoundaryPoint(int i, int j, double potential);
 
@@ -62,7 +137,9 @@ class UnsolvedElectrostaticSystem : public ElectrostaticSystem{
          */
         void setBoundaryCircle(int centreI, int centreJ, double radius, double potential);
 
-        /* Set a line as a boundary condition - from (i1,j1) to (i2,j2). */
+        /* Set a line as a boundary condition - from (i1,j1) to (i2,j2).
+         * Throws std::out_of_range if either end is off the grid.
+         */
         void setBoundaryLine(int i1, int j1, int i2, int j2, double potential);
 
         /* Set the edges of the system as a boundary conditions. */
@@ -77,6 +154,7 @@ class UnsolvedElectrostaticSystem : public ElectrostaticSystem{
          * Top right point: (right, top).
          * Bottom right point: (right, bottom).
          * NOTE: Rectange is not filled!
+         * Throws std::out_of_range if any corner is off the grid.
          */
         void setBoundaryRectangle(int left, int right, int top, int bottom, double potential);
 };
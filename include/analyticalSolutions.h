@@ -2,6 +2,7 @@
 #define ANALYTICALSOLUTIONS_H
 
 #include <cmath>
+#include "GridView.h"
 
 namespace electrostatics {
 
@@ -11,6 +12,15 @@ double analyticalProblem1(int i, int j, double radiusA, double radiusB, double p
 /* Analytical solution for problem 2. uniformField is the value of the field without the cylinder present. */
 double analyticalProblem2(int i, int j, double cylinderRadius, double uniformField);
 
+/* Set every potential of a grid (eg a solved system's potentialView) to the
+ * analytical solution, exactly the same as from the functions above. The rows are
+ * split between threads, and each row is found in one loop that the compiler can
+ * vectorise.
+ */
+void analyticalProblem1Grid(GridView<double> potentials, double radiusA, double radiusB, double potentialA,
+        double potentialB);
+void analyticalProblem2Grid(GridView<double> potentials, double cylinderRadius, double uniformField);
+
 /* Function to find the uniform electric field between two (vertical) parallel plates. */
 double uniformField(double leftPosition, double rightPosition, double leftPotential, double rightPotential);
 
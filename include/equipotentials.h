@@ -0,0 +1,64 @@
+/**
+ * Finding equipotentials (lines of constant potential) in a grid of potentials,
+ * with marching squares.
+ *
+ * Each cell of the grid (the square between four neighbouring points) that a
+ * level passes through has a line segment across it, between points on its
+ * edges found by linear interpolation. Where the two corners on each diagonal of
+ * a cell are on the same side of the level, the mean of the four corners decides
+ * which way the segments go.
+ *
+ * The grid is split into square tiles of cells, and the segments of each tile (for
+ * each level) are found and joined into lines at the same time as the other
+ * tiles. The lines are then joined to the lines they meet at the edges of the
+ * tiles. Segments are joined by the edge of the grid they meet at rather than by
+ * comparing positions, so the lines are the same whatever size the tiles are.
+ */
+
+#ifndef EQUIPOTENTIALS_H
+#define EQUIPOTENTIALS_H
+
+#include <string>
+#include <vector>
+#include "GridView.h"
+
+namespace electrostatics {
+
+struct ContourPoint {
+    double i, j;
+};
+
+struct Equipotential {
+    double potential;
+    bool closed;                        // If it is a loop, when the last point is the same as the first
+    std::vector<ContourPoint> points;
+};
+
+/* numberOfLevels potentials evenly spaced between the smallest and largest of
+ * potentials, not including them. Throws std::invalid_argument if numberOfLevels
+ * is less than 1. The potentials here and in findEquipotentials can be doubles or
+ * floats.
+ */
+template<typename Scalar>
+std::vector<double> equipotentialLevels(GridView<const Scalar> potentials, int numberOfLevels);
+
+/* Find the equipotentials at each of levels, in order of the levels. A point at
+ * exactly a level counts as above it. Throws std::invalid_argument if tileSize is
+ * less than 1.
+ */
+template<typename Scalar>
+std::vector<Equipotential> findEquipotentials(GridView<const Scalar> potentials, const std::vector<double> &levels,
+        int tileSize=128);
+
+/* Saves equipotentials in a file that gnuplot can plot with lines. Each line
+ * starts with a comment "# potential <potential> <open or closed>", followed by
+ * a row "i j" for each point, and the lines are separated by a blank row. The
+ * numbers are written as by formatDouble. Throws std::runtime_error if the file
+ * can't be written.
+ */
+void saveEquipotentials(const std::vector<Equipotential> &equipotentials, std::string fileName,
+        bool roundTrip=false);
+
+} // namespace electrostatics
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef FINITEDIFFDECOMPOSED_H
+#define FINITEDIFFDECOMPOSED_H
+
+#include "ElectrostaticSystem.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* Red-black successive over-relaxation (as in finiteDiffSOR) split between several
+ * processes, so that a solve can use the memory bandwidth of every socket of a
+ * machine rather than just the one a single process's threads end up on.
+ *
+ * The rows of the grid (b) are split into one block per process. The potentials
+ * are kept in shared memory (an anonymous MAP_SHARED mapping made before the
+ * worker processes are forked), and each process only ever writes the rows it
+ * owns. The halo - the row either side of a block, owned by the neighbouring
+ * processes - is read straight from the shared mapping, so exchanging it is just
+ * waiting at a (process shared) barrier after each colour has been updated.
+ * Each process copies its own rows into the mapping, so on a NUMA machine they
+ * are stored in the memory of the socket it runs on. If pinProcesses is true,
+ * process n is pinned to the nth CPU it is allowed to run on, so it stays there.
+ * This is only worth doing when nothing else is running, as solves running at the
+ * same time would all be pinned to the same CPUs.
+ *
+ * Process 0 is the calling process. While it waits at the barrier it checks
+ * whether any of the workers has exited, and if one has, the barrier is aborted
+ * and the other workers are killed.
+ *
+ * Points of one colour don't depend on each other, so the result (and the number
+ * of iterations) is exactly the same as finiteDiffSOR, whatever the number of
+ * processes. If processes is 0 or less, one per online CPU is used. There are
+ * never more processes than rows.
+ *
+ * Throws std::runtime_error if the shared memory or the processes can't be made,
+ * or a worker process fails.
+ *
+ * Returns the number of iterations done.
+ */
+int finiteDiffDecomposed(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, int processes=0, double tolerance=1e-8,
+        double omega=0, int maxIterations=1000000, const ElectrostaticSystem *initialGuess=nullptr,
+        bool pinProcesses=false);
+
+} // namespace electrostatics
+
+#endif
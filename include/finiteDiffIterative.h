@@ -11,10 +11,65 @@ namespace electrostatics {
 /* Uses the finite difference method to solve an UnsolvedElectrostaticsSystem.
  * The result is saved in the SolvedElectrostaticsSystem which is also passed
  * to the finction.
+ *
+ * The points that aren't boundary conditions start from their potential in
+ * initialGuess if it is given (it must have the same extents as the unsolved
+ * system), otherwise from zero.
+ *
+ * sweepsPerPass iterations are done in each pass over the grid, to keep the
+ * potentials in the cache on large grids (see StencilEngine::jacobiIterations).
+ * The result is the same for any number. 0 chooses it from the cache size.
  */
 
 void finiteDiffIterative(const UnsolvedElectrostaticSystem &unsolvedSystem, 
-        SolvedElectrostaticSystem &solvedSystem, int maxIterations=10000);
+        SolvedElectrostaticSystem &solvedSystem, int maxIterations=10000,
+        const ElectrostaticSystem *initialGuess=nullptr, int sweepsPerPass=0);
+
+/* The optimal over-relaxation factor for red-black SOR on a lengthI by lengthJ
+ * grid, from the spectral radius of the Jacobi method for a rectangle with fixed
+ * edges:
+ * rho = (cos(pi/lengthI) + cos(pi/lengthJ)) / 2
+ * omega = 2 / (1 + sqrt(1 - rho^2))
+ */
+double optimalOmega(int lengthI, int lengthJ);
+
+/* One colour (0 or 1, added to i+j) of a red-black SOR iteration over rows b=bStart
+ * to b=bEnd-1 of potentials, a lengthI by lengthJ grid stored a row at a time. Only
+ * the runs of points in interior (see UnsolvedElectrostaticSystem::interiorSpans)
+ * are updated, so the boundary conditions are skipped without testing them. If
+ * sources isn't null it is added to the sum of the neighbours of each point.
+ * Returns the largest change. This is the update shared by all the SOR solvers.
+ */
+template<typename Scalar>
+Scalar sorSweep(Scalar *potentials, int lengthI, int lengthJ, const RowSpans &interior,
+        const Scalar *sources, Scalar omega, int colour, int bStart, int bEnd);
+
+/* Uses red-black successive over-relaxation to solve an UnsolvedElectrostaticSystem,
+ * updating the SolvedElectrostaticSystem in place until the largest change to any
+ * potential in an iteration is less than tolerance (or maxIterations is reached).
+ *
+ * If omega is not between 0 and 2 the optimal over-relaxation factor for the
+ * size of the grid is used. Each half of an iteration is split between OpenMP
+ * threads when compiled with openmp.
+ *
+ * Starts from initialGuess if it is given, as for finiteDiffIterative.
+ *
+ * Returns the number of iterations done.
+ */
+int finiteDiffSOR(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double tolerance=1e-8, double omega=0,
+        int maxIterations=1000000, const ElectrostaticSystem *initialGuess=nullptr);
+
+/* As finiteDiffSOR, but the iterations are done in single precision, which halves
+ * the memory bandwidth they need, with the residual found in double precision and
+ * corrected (iterative refinement) until the corrections are less than tolerance.
+ * The result is as accurate as finiteDiffSOR's.
+ *
+ * Returns the total number of single precision iterations done.
+ */
+int finiteDiffSORMixed(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double tolerance=1e-8, double omega=0,
+        int maxIterations=1000000, const ElectrostaticSystem *initialGuess=nullptr);
 
 } // namespace electrostatics
 
@@ -4,6 +4,7 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <string>
+#include <vector>
 #include "SolvedElectrostaticSystem.h"
 #include "UnsolvedElectrostaticSystem.h"
 
@@ -16,13 +17,54 @@ namespace electrostatics {
  *
  * Method can be the following:
  * "eigenbicon" - Biconjugate gradient stabalized method from eigen
- * "eigensparselu" - Eigen sparse LU module
+ * "eigensparselu" - Eigen sparse LU module. The factorization is kept, and
+ * reused by the next solve if it has the same extents and boundary condition
+ * positions (only the boundary potentials are different). Sparse LU solves on
+ * different threads take turns using the cached factorization
  * "viennabicon" - Biconjugate gradient method from vienna library - (will run
  * on gpu if opencl or cuda flag is set and required libraries are installed)
+ * "eigenbiconmatrixfree" - Biconjugate gradient stabalized method from eigen,
+ * applying the finite difference stencil directly instead of storing the matrix
+ * "eigencg" - Conjugate gradient method from eigen with an incomplete Cholesky
+ * preconditioner, on the reduced system of equations (see reducedSystem)
+ * "eigenldlt" - Eigen simplicial LDLT (sparse Cholesky) module, on the reduced
+ * system of equations
+ * "eigencgmixed", "eigenbiconmixed" - Conjugate gradient (with incomplete
+ * Cholesky) or biconjugate gradient stabilized methods on the reduced system,
+ * working in single precision, with the residual corrected in double precision
+ * (iterative refinement) until it is as accurate as the double precision methods
+ *
+ * The iterative methods (eigenbicon, viennabicon, eigenbiconmatrixfree, eigencg
+ * and the mixed precision methods) start from initialGuess if it is given, which must have the same
+ * extents as the unsolved system. Starting from the solution of a similar system
+ * (eg with slightly different voltages) needs far fewer iterations than starting
+ * from zero. The direct methods don't use it.
+ *
+ * Returns the number of iterations done by the iterative methods, 0 for the
+ * direct methods, or -1 for viennabicon (which doesn't report it). Throws
+ * std::runtime_error if the sparse LU factorization fails (eg if the matrix is
+ * singular).
  */
 
-void finiteDiffMatrix(const UnsolvedElectrostaticSystem &unsolvedSystem, 
-        SolvedElectrostaticSystem &solvedSystem, std::string method);
+int finiteDiffMatrix(const UnsolvedElectrostaticSystem &unsolvedSystem, 
+        SolvedElectrostaticSystem &solvedSystem, std::string method,
+        const ElectrostaticSystem *initialGuess=nullptr);
+
+/* Number of sparse LU solves that reused/didn't reuse the cached factorization. */
+long factorizationCacheHits();
+long factorizationCacheMisses();
+
+/* Frees the cached sparse LU factorization. */
+void clearFactorizationCache();
+
+/* Forms a reduced system of equations Av = b for an UnsolvedElectrostaticSystem,
+ * where v only contains the potentials of the points that are not boundary
+ * conditions. The boundary values are moved to b, which makes A symmetric
+ * positive definite (as long as every unknown point is connected to a boundary
+ * condition). unknownPositions is filled with the position (k) of each unknown.
+ */
+void reducedSystem(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        Eigen::SparseMatrix<double> &A, Eigen::VectorXd &b, std::vector<long> &unknownPositions);
 
 } // namespace electrostatics
 
@@ -0,0 +1,45 @@
+#ifndef FINITEDIFFMULTIGRID_H
+#define FINITEDIFFMULTIGRID_H
+
+#include <Eigen/Dense>
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* Solves an UnsolvedElectrostaticsSystem with the conjugate gradient method,
+ * preconditioned with geometric multigrid. The result is saved in the
+ * SolvedElectrostaticsSystem which is also passed to the function.
+ *
+ * The grid and its boundary conditions are repeatedly coarsened by a factor of
+ * two. Each conjugate gradient iteration applies one V-cycle (red-black
+ * Gauss-Seidel smoothing on each level with a correction from the level below,
+ * symmetric so that it is a valid preconditioner) to the residual, to find the
+ * next search direction. Iterations continue until the norm of the residual has
+ * dropped by a factor of tolerance, or maxCycles iterations have been done. The
+ * work per iteration grows linearly with the number of grid points.
+ *
+ * Starts from initialGuess if it is given (it must have the same extents as
+ * the unsolved system). The tolerance is still relative to the residual when
+ * starting from zero, so a good guess needs fewer iterations.
+ *
+ * Returns the number of conjugate gradient iterations done, which is also the
+ * number of V-cycles (one per iteration), or 0 if the initial solution already
+ * met the tolerance.
+ */
+int finiteDiffMultigrid(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double tolerance=1e-8, int maxCycles=100,
+        const ElectrostaticSystem *initialGuess=nullptr);
+
+/* Finds an initial guess for solving an UnsolvedElectrostaticSystem, by solving
+ * it on a grid with half as many points in each direction (with finiteDiffMultigrid
+ * to the given tolerance) and interpolating the result back onto the full grid.
+ * The guess is saved in the SolvedElectrostaticSystem, which must have the same
+ * extents as the unsolved system.
+ */
+void coarseGridGuess(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &guess, double tolerance=1e-6);
+
+} // namespace electrostatics
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef FINITEDIFFQUADTREE_H
+#define FINITEDIFFQUADTREE_H
+
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* Solves an UnsolvedElectrostaticSystem on an adaptively refined grid (see
+ * QuadtreeGrid), which only uses single points near the boundary conditions and
+ * where the field changes quickly, and bigger squares (up to 2^maxLevel points
+ * across) everywhere else. The result is interpolated onto the
+ * SolvedElectrostaticSystem which is also passed to the function.
+ *
+ * Starting from the coarsest grid allowed (with each square starting at the
+ * average of initialGuess over it, if it isn't null), the grid is solved and
+ * adapted until the estimated error of every square is less than
+ * refinementTolerance, or it has been adapted maxPasses times. The estimate is
+ * only of the error from interpolating across each square, and the error in the
+ * potentials of the squares themselves is usually about 20 times bigger, so if
+ * refinementTolerance is 0, 5e-5 times the largest boundary potential is used,
+ * which gives errors of about 0.1% of it.
+ *
+ * Returns the number of unknowns in the final grid (the uniform grid has one for
+ * every point that isn't a boundary condition).
+ */
+long finiteDiffQuadtree(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double refinementTolerance=0, int maxLevel=5,
+        int maxPasses=10, const ElectrostaticSystem *initialGuess=nullptr);
+
+} // namespace electrostatics
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * Wall clock timing of the phases of the program (eg assembling a matrix,
+ * factorizing it, solving, writing files), added up over a whole run so it can be
+ * seen where the time goes.
+ *
+ * A ScopedPhase measures the wall clock time from when it is made until it is
+ * stopped or destroyed, and adds it to the total for its phase. Unlike the CPU
+ * time measured by std::clock, this isn't inflated by the time of every OpenMP
+ * (or ViennaCL) thread being added together. Phases can be timed on several
+ * threads at once, and can be inside each other, eg a solve inside a timed
+ * command, so the totals don't always add up to the time of the run.
+ *
+ * Phase names are "part of the program: phase", eg "sparselu: factorize".
+ */
+
+#ifndef PHASETIMER_H
+#define PHASETIMER_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace electrostatics {
+
+struct PhaseTiming {
+    std::string name;
+    long calls;
+    double totalSeconds;
+    double maxSeconds;
+};
+
+class ScopedPhase {
+    protected:
+        const char *name;
+        std::chrono::steady_clock::time_point start;
+        bool stopped;
+
+    public:
+        /* Constructor - starts timing. name must last until the phase is stopped. */
+        explicit ScopedPhase(const char *name) :
+            name(name), start(std::chrono::steady_clock::now()), stopped(false) {}
+
+        /* Destructor - stops timing, if it hasn't been already. */
+        ~ScopedPhase() { stop(); }
+
+        ScopedPhase(const ScopedPhase&) = delete;
+        ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+
+        /* Methods */
+
+        /* Stop timing before the end of the block and add the time to the phase. */
+        void stop();
+};
+
+/* Add seconds to the total for a phase. */
+void recordPhase(const char *name, double seconds);
+
+/* The timings of every phase so far, in the order they were first recorded. */
+std::vector<PhaseTiming> phaseTimings();
+
+void resetPhaseTimings();
+
+/* Writes a table of the phase timings (calls, total, mean and max time). */
+void printPhaseReport(std::ostream &output);
+
+/* Saves the phase timings as JSON. Throws std::runtime_error if the file can't be written. */
+void savePhaseReportJSON(std::string fileName);
+
+} // namespace electrostatics
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * Plots of solutions drawn straight to image files (PNG or PPM), without writing
+ * the potentials to a text file for gnuplot first.
+ *
+ * The potentials are drawn as a heat map with the same palette as the plot files
+ * (see the plotfile command), from the smallest potential to the largest. If the
+ * grid is bigger than the image can be, each pixel is the mean of a square block
+ * of points, so the grid keeps its shape. Field arrows and equipotential lines
+ * can then be drawn over the top.
+ *
+ * The image is the right way up: its top row is the largest j.
+ */
+
+#ifndef RASTERPLOT_H
+#define RASTERPLOT_H
+
+#include <string>
+#include <vector>
+#include "GridView.h"
+#include "equipotentials.h"
+#include "SolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+struct RasterImage {
+    int width, height;
+    int pointsPerPixel;             // Width (and height) of the block of points in each pixel
+    int iMin, jMax;                 // Position of the first point of the top left pixel
+    double minPotential, maxPotential;
+    std::vector<double> potentials; // Mean potential of each pixel, a row at a time from the top
+    std::vector<unsigned char> rgb; // Colour of each pixel, 3 bytes each, in the same order
+};
+
+/* Draw the potentials as a heat map, no more than maxWidth by maxHeight pixels.
+ * The blocks of points are averaged in parallel when compiled with openmp. The
+ * potentials can be doubles or floats (eg a solution stored as floats).
+ */
+template<typename Scalar>
+RasterImage renderPotentials(GridView<const Scalar> potentials, int maxWidth, int maxHeight);
+
+/* Draw arrows in the direction of the field of system (which image was drawn
+ * from), every spacing points in each direction.
+ */
+void drawFieldArrows(RasterImage &image, const SolvedElectrostaticSystem &system, int spacing);
+
+/* Draw equipotentials (see findEquipotentials) found from the potentials image was
+ * drawn from.
+ */
+void drawEquipotentials(RasterImage &image, const std::vector<Equipotential> &equipotentials);
+
+/* Save the image. Throws std::runtime_error if the file can't be written. */
+void savePNG(const RasterImage &image, std::string fileName);
+void savePPM(const RasterImage &image, std::string fileName);
+
+} // namespace electrostatics
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * Binary files for saving and loading solved systems.
+ *
+ * Text files (see ElectrostaticSystem::saveFile) are large and slow to write
+ * for big grids, so solutions can also be saved as a 64 byte header followed
+ * by the potentials, stored the same way as in ElectrostaticSystem (column
+ * major, so each row j is lengthI consecutive values), as doubles or floats:
+ *
+ * bytes 0-7    "ESSOLN" followed by two zero bytes
+ * bytes 8-11   version of the format (currently 1)
+ * bytes 12-15  bytes per value, 8 (double) or 4 (float)
+ * bytes 16-31  iMin, iMax, jMin, jMax
+ * bytes 32-63  unused (zero)
+ *
+ * Everything is in the byte order of the machine that saved the file.
+ *
+ * Loading a file maps it into memory (with mmap) instead of reading it, so
+ * the potentials can be used directly from the file without copying them. A
+ * solved system can also be kept in memory in the same form, as floats, to
+ * halve the memory it needs when it is only going to be exported or plotted.
+ * Gnuplot can also read the files directly, eg for a 601x201 grid of doubles:
+ *
+ * splot "name.bin" binary array=(601,201) skip=64 format="%float64" origin=(iMin,jMin,0)
+ */
+
+#ifndef SOLUTIONFILE_H
+#define SOLUTIONFILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "ElectrostaticSystem.h"
+#include "GridView.h"
+
+namespace electrostatics {
+
+struct SolutionFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bytesPerValue;
+    int32_t iMin, iMax, jMin, jMax;
+    char unused[32];
+};
+
+/* Save the potentials of system to a binary file, as floats if singlePrecision
+ * is true, otherwise as doubles. Throws std::runtime_error if the file can't be
+ * written.
+ */
+void saveSolutionFile(const ElectrostaticSystem &system, std::string fileName,
+        bool singlePrecision=false);
+
+/* A binary solution file mapped into memory. Throws std::runtime_error if the
+ * file can't be opened or isn't a valid solution file. The file is unmapped when
+ * it is destroyed, after which any views of it are invalid.
+ */
+class MappedSolutionFile {
+    protected:
+        void *mapping;
+        size_t mappingSize;
+        const SolutionFileHeader *header;
+        const void *values;
+
+    public:
+        /* Constructors - map the file called fileName, or make the file in memory
+         * (not saved anywhere) from the potentials of system.
+         */
+        MappedSolutionFile(std::string fileName);
+        MappedSolutionFile(const ElectrostaticSystem &system, bool singlePrecision);
+        ~MappedSolutionFile();
+
+        MappedSolutionFile(const MappedSolutionFile&) = delete;
+        MappedSolutionFile& operator=(const MappedSolutionFile&) = delete;
+
+
+        /* Methods */
+
+        int getIMin() const { return header->iMin; }
+        int getIMax() const { return header->iMax; }
+        int getJMin() const { return header->jMin; }
+        int getJMax() const { return header->jMax; }
+        int getLengthI() const { return header->iMax - header->iMin + 1; }
+        int getLengthJ() const { return header->jMax - header->jMin + 1; }
+
+        /* True if the potentials are stored as floats instead of doubles. */
+        bool isSinglePrecision() const { return header->bytesPerValue == sizeof(float); }
+
+        /* Get the potential at position (i, j), as a double whichever precision it
+         * is stored with. Throws std::out_of_range if (i, j) isn't in the grid.
+         */
+        double getPotentialIJ(int i, int j) const;
+
+        /* Unchecked access to the potentials in the file (see GridView), without
+         * copying them. Throws std::logic_error if they aren't stored with that
+         * precision.
+         */
+        GridView<const double> potentialView() const;
+        GridView<const float> singlePrecisionView() const;
+
+        /* Copy the potentials into system, which must have the same extents (or
+         * std::invalid_argument is thrown).
+         */
+        void copyTo(ElectrostaticSystem &system) const;
+};
+
+} // namespace electrostatics
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * Fast application of the finite difference stencil for the iterative methods.
+ *
+ * The potentials are copied into a PaddedGrid, which has an extra row/column of
+ * ghost points (always zero) around the edges of the system. Because of these,
+ * the sum of the surrounding potentials can be found the same way for every
+ * point, without checking whether each neighbour is inside the grid:
+ *
+ * sum = P(i+1, j) + P(i-1, j) + P(i, j+1) + P(i, j-1)
+ *
+ * Only the number of surrounding points (that it is divided by) is different at
+ * the edges. Adding a zero doesn't change the sum, so results are exactly the
+ * same as only adding the neighbours that exist.
+ *
+ * The boundary conditions are never updated, so the points that aren't boundary
+ * conditions are stored as runs of consecutive points in each row. Each run is
+ * split into the points away from the edges of the system, which are updated by
+ * the interior kernel (vectorised with AVX2 or AVX-512 when the processor
+ * supports them, chosen when the program starts), and the points on the edges,
+ * updated by the edge kernel.
+ *
+ * For grids too big to fit in the cache, several Jacobi iterations can be done
+ * in one pass down the grid (see jacobiIterations), so each row is loaded from
+ * memory once per pass instead of once per iteration.
+ */
+
+#ifndef STENCILENGINE_H
+#define STENCILENGINE_H
+
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* A grid with a layer of ghost points around it. Point (a, b) of the grid (from
+ * zero, as in ElectrostaticSystem) is at values[(a+1) + (b+1)*stride], and the
+ * ghost points are zero.
+ */
+class PaddedGrid {
+    protected:
+        int lengthI, lengthJ;
+        long stride;
+        std::vector<double> values;
+
+    public:
+        /* Constructors */
+        PaddedGrid() : lengthI(0), lengthJ(0), stride(0) {}
+        PaddedGrid(int lengthI, int lengthJ);
+
+
+        /* Methods */
+
+        int getLengthI() const { return lengthI; }
+        int getLengthJ() const { return lengthJ; }
+        long getStride() const { return stride; }
+
+        /* Pointer to the first (non ghost) point of row b. */
+        double* row(int b) { return values.data() + (b+1)*stride + 1; }
+        const double* row(int b) const { return values.data() + (b+1)*stride + 1; }
+
+        /* Copy potentials (indexed (a, b)) into/out of the grid. */
+        void load(const doubleGrid &potentials);
+        void store(doubleGrid &potentials) const;
+};
+
+/* A run of points in row b, from a = start to a = end-1, that aren't boundary conditions. */
+struct StencilRun {
+    int b;
+    int start, end;
+};
+
+/* Which kernel a run of points is updated with. */
+enum StencilRegion { interiorRegion, edgeRegion };
+
+/* Jacobi update of count consecutive points, from the potentials in from to
+ * the same points in to (with stride between rows):
+ * to = (sum of surrounding from) / surroundingPoints
+ */
+template<StencilRegion region>
+struct JacobiKernel;
+
+/* Points away from the edges of the system always have 4 surrounding points. */
+template<>
+struct JacobiKernel<interiorRegion> {
+    static void apply(const double *from, double *to, long stride, int count);
+};
+
+/* Points on the edges of the system have fewer surrounding points, which is
+ * found from their position (a, b) in a system with lengths lengthI, lengthJ.
+ */
+template<>
+struct JacobiKernel<edgeRegion> {
+    static void apply(const double *from, double *to, long stride, int count,
+            int a, int b, int lengthI, int lengthJ);
+};
+
+class StencilEngine {
+    protected:
+        int lengthI, lengthJ;
+        std::vector<StencilRun> runs;
+        std::vector<long> rowStarts;    // Index of the first run in each row
+
+        /* Jacobi update of the points in a run, or in every run of row b. */
+        void updateRun(const StencilRun &run, const PaddedGrid &from, PaddedGrid &to) const;
+        void updateRow(int b, const PaddedGrid &from, PaddedGrid &to) const;
+
+    public:
+        /* Constructor */
+        StencilEngine(const UnsolvedElectrostaticSystem &unsolvedSystem);
+
+
+        /* Methods */
+
+        int getLengthI() const { return lengthI; }
+        int getLengthJ() const { return lengthJ; }
+
+        /* Runs of points that aren't boundary conditions, in order of b then a. */
+        const std::vector<StencilRun>& getRuns() const { return runs; }
+
+        /* One Jacobi iteration from the potentials in from to to. The boundary
+         * conditions in to are left as they are.
+         */
+        void jacobiSweep(const PaddedGrid &from, PaddedGrid &to) const;
+
+        /* Does iterations Jacobi iterations, going from gridA to gridB on odd
+         * iterations and back from gridB to gridA on even ones, so the result is
+         * in gridB if iterations is odd. Gives exactly the same result as calling
+         * jacobiSweep for each iteration.
+         *
+         * sweepsPerPass iterations are done in each pass down the grid, as a
+         * wavefront: iteration t+1 of row b is done just after iteration t of row
+         * b+1, two rows behind iteration t. Only about 2*sweepsPerPass rows of
+         * each grid are in use at once, so they stay in the cache. If
+         * sweepsPerPass is 0 it is chosen from the size of the cache (see
+         * autoSweepsPerPass). 1 does one whole iteration at a time.
+         */
+        void jacobiIterations(PaddedGrid &gridA, PaddedGrid &gridB, int iterations,
+                int sweepsPerPass=0) const;
+
+        /* The most sweeps per pass for which the rows in use fit in the (level 2) cache. */
+        int autoSweepsPerPass() const;
+};
+
+/* Name of the instruction set used by the interior kernel: "avx512", "avx2" or
+ * "scalar".
+ */
+std::string stencilInstructionSet();
+
+/* True if the processor (and compiler) support the named instruction set. */
+bool stencilInstructionSetSupported(std::string instructionSet);
+
+/* Use the named instruction set for the interior kernel (eg "scalar" to compare
+ * against). Throws std::invalid_argument if it isn't supported.
+ */
+void useStencilInstructionSet(std::string instructionSet);
+
+} // namespace electrostatics
+
+#endif
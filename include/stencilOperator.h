@@ -0,0 +1,179 @@
+/**
+ * A matrix-free version of the coefficients matrix used by finiteDiffMatrix.
+ *
+ * Instead of storing every coefficient of the (kMax+1) x (kMax+1) matrix A,
+ * the finite difference stencil is applied directly, using only the grid size
+ * and the positions of the boundary conditions. For a point (i, j) with
+ * position k:
+ *
+ * (Av)(k) = v(k)                                        if (i, j) is a boundary condition
+ * (Av)(k) = sum of surrounding v - surroundingPoints*v(k)  otherwise
+ *
+ * which is the same product as for the assembled matrix. It can be used in
+ * place of a sparse matrix with eigen's iterative solvers (eg BiCGSTAB), along
+ * with StencilDiagonalPreconditioner.
+ */
+
+#ifndef STENCILOPERATOR_H
+#define STENCILOPERATOR_H
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include "ElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+class StencilOperator;
+} // namespace electrostatics
+
+// Eigen needs to know the operator behaves like a sparse matrix of doubles
+namespace Eigen {
+namespace internal {
+template<>
+struct traits<electrostatics::StencilOperator> : public traits<Eigen::SparseMatrix<double> > {};
+} // namespace internal
+} // namespace Eigen
+
+namespace electrostatics {
+
+class StencilOperator : public Eigen::EigenBase<StencilOperator> {
+    protected:
+        int lengthI, lengthJ;
+        long kMax;
+        boolGrid boundaryConditionPositions;
+
+    public:
+        // Types and flags needed by eigen
+        typedef double Scalar;
+        typedef double RealScalar;
+        typedef int StorageIndex;
+        enum {
+            ColsAtCompileTime = Eigen::Dynamic,
+            MaxColsAtCompileTime = Eigen::Dynamic,
+            IsRowMajor = false
+        };
+
+        /* Constructor */
+        StencilOperator(const UnsolvedElectrostaticSystem &unsolvedSystem);
+
+
+        /* Methods */
+
+        /* Size of the matrix that this operator represents. */
+        Eigen::Index rows() const { return kMax+1; }
+        Eigen::Index cols() const { return kMax+1; }
+
+        /* The inverse of the diagonal of the matrix. */
+        Eigen::VectorXd inverseDiagonal() const;
+
+        /* Adds alpha*A*x to result. */
+        template<typename Rhs, typename Dest>
+        void addProduct(const Rhs &x, Dest &result, double alpha) const;
+
+        /* Lazy product with a vector - evaluated by addProduct. */
+        template<typename Rhs>
+        Eigen::Product<StencilOperator, Rhs, Eigen::AliasFreeProduct> operator*(
+                const Eigen::MatrixBase<Rhs> &x) const {
+            return Eigen::Product<StencilOperator, Rhs, Eigen::AliasFreeProduct>(*this, x.derived());
+        }
+};
+
+/* Jacobi (diagonal) preconditioner for a StencilOperator, with the interface eigen's
+ * iterative solvers expect from a preconditioner.
+ */
+class StencilDiagonalPreconditioner {
+    protected:
+        Eigen::VectorXd inverseDiagonal;
+
+    public:
+        StencilDiagonalPreconditioner() {}
+        explicit StencilDiagonalPreconditioner(const StencilOperator &stencil) { compute(stencil); }
+
+        StencilDiagonalPreconditioner& analyzePattern(const StencilOperator &) { return *this; }
+        StencilDiagonalPreconditioner& factorize(const StencilOperator &stencil) {
+            inverseDiagonal = stencil.inverseDiagonal();
+            return *this;
+        }
+        StencilDiagonalPreconditioner& compute(const StencilOperator &stencil) { return factorize(stencil); }
+
+        template<typename Rhs>
+        Eigen::VectorXd solve(const Rhs &b) const { return inverseDiagonal.cwiseProduct(b); }
+
+        Eigen::ComputationInfo info() { return Eigen::Success; }
+};
+
+/* Norm of the residual b - Av of the equations for unsolvedSystem, with v the
+ * potentials of solvedSystem, relative to the residual with every point that
+ * isn't a boundary condition at zero (the same measure as the tolerance of
+ * finiteDiffMultigrid). Throws std::invalid_argument if the extents don't match.
+ */
+double relativeResidual(const UnsolvedElectrostaticSystem &unsolvedSystem, const ElectrostaticSystem &solvedSystem);
+
+
+/* Template methods */
+
+template<typename Rhs, typename Dest>
+void StencilOperator::addProduct(const Rhs &x, Dest &result, double alpha) const {
+    #pragma omp parallel for schedule(static)
+    for(int b=0; b<lengthJ; b++) {
+        long rowStart = (long)b*lengthI;
+        bool interiorRow = b>0 && b<lengthJ-1;
+        for(int a=0; a<lengthI; a++) {
+            long k = rowStart + a;
+            if(boundaryConditionPositions(a, b)) {
+                result(k) += alpha*x(k);
+            }
+            // Points away from the edges always have 4 surrounding points
+            else if(interiorRow && a>0 && a<lengthI-1) {
+                result(k) += alpha*(x(k+1) + x(k-1) + x(k+lengthI) + x(k-lengthI) - 4*x(k));
+            }
+            else {
+                int surroundingPoints = 0;
+                double sum = 0;
+                if(a<lengthI-1) {
+                    surroundingPoints += 1;
+                    sum += x(k+1);
+                }
+                if(a>0) {
+                    surroundingPoints += 1;
+                    sum += x(k-1);
+                }
+                if(b<lengthJ-1) {
+                    surroundingPoints += 1;
+                    sum += x(k+lengthI);
+                }
+                if(b>0) {
+                    surroundingPoints += 1;
+                    sum += x(k-lengthI);
+                }
+                result(k) += alpha*(sum - surroundingPoints*x(k));
+            }
+        }
+    }
+}
+
+} // namespace electrostatics
+
+
+// Tells eigen to use StencilOperator::addProduct for products with a vector
+namespace Eigen {
+namespace internal {
+template<typename Rhs>
+struct generic_product_impl<electrostatics::StencilOperator, Rhs, SparseShape, DenseShape, GemvProduct>
+    : generic_product_impl_base<electrostatics::StencilOperator, Rhs,
+        generic_product_impl<electrostatics::StencilOperator, Rhs> > {
+
+    typedef typename Product<electrostatics::StencilOperator, Rhs>::Scalar Scalar;
+
+    template<typename Dest>
+    static void scaleAndAddTo(Dest &dst, const electrostatics::StencilOperator &lhs, const Rhs &rhs,
+            const Scalar &alpha) {
+        // Evaluates rhs into a temporary only if it isn't already a plain vector
+        const Eigen::Ref<const Eigen::VectorXd> x(rhs);
+        lhs.addProduct(x, dst, alpha);
+    }
+};
+} // namespace internal
+} // namespace Eigen
+
+#endif
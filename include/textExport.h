@@ -0,0 +1,54 @@
+/**
+ * Fast writing of large text files (eg for gnuplot).
+ *
+ * Numbers are converted with std::to_chars instead of through a stream. By
+ * default doubles are written the same way as by std::ostream (6 significant
+ * figures, like printf's %g), so files are exactly the same as they were before.
+ * Alternatively they can be written with the fewest digits that read back as
+ * exactly the same double.
+ *
+ * The rows of a file are formatted in blocks, with each thread formatting part of
+ * the block into its own buffer, and then each buffer is written to the file in
+ * one go.
+ */
+
+#ifndef TEXTEXPORT_H
+#define TEXTEXPORT_H
+
+#include <string>
+#include <functional>
+#include "GridView.h"
+
+namespace electrostatics {
+
+/* The most characters written by formatDouble or formatInt. */
+const int maxDoubleCharacters = 32;
+const int maxIntCharacters = 12;
+
+/* Write value at out, returning a pointer to the character after it. If roundTrip
+ * is true the shortest representation that reads back as value is used, otherwise
+ * it is written the same as std::ostream would.
+ */
+char* formatDouble(char *out, double value, bool roundTrip=false);
+char* formatInt(char *out, int value);
+
+/* Write numberOfRows rows to the file fileName, where formatRow(row, out) writes
+ * row number row (from 0) at out, returning a pointer to the character after it.
+ * A row can't be more than maxRowCharacters long. Rows can be formatted in any
+ * order, and at the same time, but are written to the file in order. Throws
+ * std::runtime_error if the file can't be written.
+ */
+void writeTextRows(std::string fileName, long numberOfRows, long maxRowCharacters,
+        std::function<char*(long row, char *out)> formatRow);
+
+/* Write potentials to the file fileName in the format for GNU Plot, a row of the
+ * file for each j (see ElectrostaticSystem::saveFile). Single precision potentials
+ * are written the same as they would be after converting them to doubles. Throws
+ * std::runtime_error if the file can't be written.
+ */
+template<typename Scalar>
+void savePotentialsText(GridView<const Scalar> potentials, std::string fileName, bool roundTrip=false);
+
+} // namespace electrostatics
+
+#endif
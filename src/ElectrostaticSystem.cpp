@@ -1,10 +1,10 @@
 #include <Eigen/Dense>
 #include <stdexcept>
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <cmath>
 #include "ElectrostaticSystem.h"
+#include "textExport.h"
 
 namespace electrostatics {
 
@@ -26,8 +26,7 @@ double ElectrostaticSystem::getPotentialIJ(int i, int j) const {
 }
 double ElectrostaticSystem::getPotentialK(long k) const {
     if(k>kMax || k<0) throw std::out_of_range("Error: Trying to get element out of range!");
-    int* ij = k2ij(k);
-    return potentials(ij[0]-iMin, ij[1]-jMin);
+    return potentials.data()[k];
 }
 
 void ElectrostaticSystem::setPotentialIJ(int i, int j, double potential) {
@@ -37,8 +36,14 @@ void ElectrostaticSystem::setPotentialIJ(int i, int j, double potential) {
 }
 void ElectrostaticSystem::setPotentialK(long k, double potential) {
     if(k>kMax || k<0) throw std::out_of_range("Error: Trying to set element out of range!");
-    int* ij = k2ij(k);
-    potentials(ij[0]-iMin, ij[1]-jMin) = potential;
+    potentials.data()[k] = potential;
+}
+
+void ElectrostaticSystem::setPotentials(const doubleGrid &newPotentials) {
+    if(newPotentials.rows() != potentials.rows() || newPotentials.cols() != potentials.cols()) {
+        throw std::invalid_argument("The dimensions of the new potentials must match the system!");
+    }
+    potentials = newPotentials;
 }
 
 long ElectrostaticSystem::ij2k(int i, int j) const {
@@ -50,15 +55,24 @@ long ElectrostaticSystem::ij2k(int i, int j) const {
 }
 
 int* ElectrostaticSystem::k2ij(long k) const {
-    if(k>kMax || k<0) throw std::out_of_range(
-            "Error: Trying to convert to position (k)  out of range!");
     int* ij = new int[2];
-    int j = k / (iMax-iMin+1);
-    int i = k - j*(iMax-iMin+1);
-    ij[0] = i + iMin;
-    ij[1] = j + jMin;
+    try {
+        k2ij(k, ij[0], ij[1]);
+    }
+    catch(...) {
+        delete[] ij;
+        throw;
+    }
     return ij;
 }
+void ElectrostaticSystem::k2ij(long k, int &i, int &j) const {
+    if(k>kMax || k<0) throw std::out_of_range(
+            "Error: Trying to convert to position (k)  out of range!");
+    j = k / (iMax-iMin+1);
+    i = k - j*(iMax-iMin+1);
+    i += iMin;
+    j += jMin;
+}
 
 /* To convert from the matrix representaion to the grid representation,
  * transpose the matrix and reverse each column
@@ -67,16 +81,9 @@ void ElectrostaticSystem::print() const {
     std::cout << potentials.transpose().colwise().reverse();
 }
 
-void ElectrostaticSystem::saveFile(std::string fileName) const {
-    std::ofstream outputFile;
-    outputFile.open(fileName.c_str());
-    for(int j=jMin; j<=jMax; j++) {
-        for(int i=iMin; i<=iMax; i++) {
-            outputFile << getPotentialIJ(i, j) << " ";
-        }
-        outputFile << "\n";
-    }
-    outputFile.close();
+/* Each row j of the file has the potentials for that row, each followed by a space. */
+void ElectrostaticSystem::saveFile(std::string fileName, bool roundTrip) const {
+    savePotentialsText(potentialView(), fileName, roundTrip);
 }
 
 void ElectrostaticSystem::compareTo(const ElectrostaticSystem &otherSystem,
@@ -93,12 +100,29 @@ void ElectrostaticSystem::compareTo(const ElectrostaticSystem &otherSystem,
                 "The dimensions of both systems and the system for the results must match!");
     }
 
-    for(int i=iMin; i<=iMax; i++) {
-        for(int j=jMin; j<jMax; j++) {
-            comparisonResults.setPotentialIJ(i, j, fabs(this->getPotentialIJ(i,j) -
-                        otherSystem.getPotentialIJ(i, j)));
-        }
+    comparisonResults.potentials = (potentials - otherSystem.potentials).cwiseAbs();
+}
+
+template<typename ScalarA, typename ScalarB>
+void ElectrostaticSystem::setDifference(GridView<const ScalarA> potentialsA,
+        GridView<const ScalarB> potentialsB) {
+    if(potentialsA.getIMin() != iMin || potentialsA.getIMax() != iMax ||
+            potentialsA.getJMin() != jMin || potentialsA.getJMax() != jMax ||
+            potentialsB.getIMin() != iMin || potentialsB.getIMax() != iMax ||
+            potentialsB.getJMin() != jMin || potentialsB.getJMax() != jMax) {
+        throw std::invalid_argument("The dimensions of both grids and the system must match!");
     }
+
+    typedef Eigen::Matrix<ScalarA, Eigen::Dynamic, Eigen::Dynamic> GridA;
+    typedef Eigen::Matrix<ScalarB, Eigen::Dynamic, Eigen::Dynamic> GridB;
+    Eigen::Map<const GridA> a(potentialsA.getData(), getLengthI(), getLengthJ());
+    Eigen::Map<const GridB> b(potentialsB.getData(), getLengthI(), getLengthJ());
+    potentials = (a.template cast<double>() - b.template cast<double>()).cwiseAbs();
 }
 
+template void ElectrostaticSystem::setDifference<double, double>(GridView<const double>, GridView<const double>);
+template void ElectrostaticSystem::setDifference<double, float>(GridView<const double>, GridView<const float>);
+template void ElectrostaticSystem::setDifference<float, double>(GridView<const float>, GridView<const double>);
+template void ElectrostaticSystem::setDifference<float, float>(GridView<const float>, GridView<const float>);
+
 } // namespace electrostatics
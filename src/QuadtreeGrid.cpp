@@ -0,0 +1,503 @@
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/IterativeLinearSolvers>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "QuadtreeGrid.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* Leaves are kept in Z order (interleaving the bits of a and b), so leaves close
+ * together in the system are close together in the list of unknowns.
+ */
+static unsigned long long zOrder(int a, int b) {
+    unsigned long long key = 0;
+    for(int bit=0; bit<31; bit++) {
+        key |= (unsigned long long)((a >> bit) & 1) << (2*bit);
+        key |= (unsigned long long)((b >> bit) & 1) << (2*bit + 1);
+    }
+    return key;
+}
+
+
+/* Constructor */
+
+QuadtreeGrid::QuadtreeGrid(const UnsolvedElectrostaticSystem &unsolvedSystem, int maxLevel,
+        int refinementMargin, const ElectrostaticSystem *initialGuess) :
+    unsolvedSystem(unsolvedSystem), lengthI(unsolvedSystem.getLengthI()),
+    lengthJ(unsolvedSystem.getLengthJ()), maxLevel(maxLevel), refinementMargin(refinementMargin) {
+
+        // Summed area table of the boundary conditions
+        const boolGrid &boundaryConditions = unsolvedSystem.getBoundaryConditionPositions();
+        boundaryConditionSums = Eigen::Matrix<long, Eigen::Dynamic, Eigen::Dynamic>::Zero(lengthI+1, lengthJ+1);
+        for(int b=0; b<lengthJ; b++) {
+            long rowSum = 0;
+            for(int a=0; a<lengthI; a++) {
+                rowSum += boundaryConditions(a, b);
+                boundaryConditionSums(a+1, b+1) = boundaryConditionSums(a+1, b) + rowSum;
+            }
+        }
+
+        rootLevel = 0;
+        while((1 << rootLevel) < std::max(lengthI, lengthJ)) rootLevel++;
+        std::vector<QuadtreeLeaf> newLeaves;
+        std::vector<double> newPotentials;
+        build(0, 0, rootLevel, newLeaves, newPotentials);
+        setLeaves(newLeaves, newPotentials);
+        balance();
+
+        // Each leaf starts at the average of the guess over it
+        if(initialGuess) {
+            doubleGrid startingPotentials = unsolvedSystem.startingPotentials(initialGuess);
+            for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+                int size = 1 << leaves[leaf].level;
+                potentials(leaf) = startingPotentials.block(leaves[leaf].a, leaves[leaf].b, size, size).mean();
+            }
+        }
+}
+
+
+/* Methods */
+
+long QuadtreeGrid::boundaryConditionsIn(int aMin, int bMin, int aEnd, int bEnd) const {
+    aMin = std::max(aMin, 0);
+    bMin = std::max(bMin, 0);
+    aEnd = std::min(aEnd, lengthI);
+    bEnd = std::min(bEnd, lengthJ);
+    if(aMin >= aEnd || bMin >= bEnd) return 0;
+    return boundaryConditionSums(aEnd, bEnd) - boundaryConditionSums(aMin, bEnd) -
+        boundaryConditionSums(aEnd, bMin) + boundaryConditionSums(aMin, bMin);
+}
+
+bool QuadtreeGrid::canBeLeaf(int a, int b, int level) const {
+    int size = 1 << level;
+    if(a+size > lengthI || b+size > lengthJ) return false;
+    if(level == 0) return true;
+    if(level > maxLevel) return false;
+    return boundaryConditionsIn(a-refinementMargin, b-refinementMargin, a+size+refinementMargin,
+            b+size+refinementMargin) == 0;
+}
+
+/* Adds the leaves inside the square of size 2^level at (a, b) to newLeaves. */
+void QuadtreeGrid::build(int a, int b, int level, std::vector<QuadtreeLeaf> &newLeaves,
+        std::vector<double> &newPotentials) const {
+    if(a >= lengthI || b >= lengthJ) return;
+    if(canBeLeaf(a, b, level)) {
+        QuadtreeLeaf leaf;
+        leaf.a = a;
+        leaf.b = b;
+        leaf.level = level;
+        leaf.boundaryCondition = (level == 0) && unsolvedSystem.getBoundaryConditionPositions()(a, b);
+        newLeaves.push_back(leaf);
+        newPotentials.push_back(leaf.boundaryCondition ? unsolvedSystem.getPotentials()(a, b) : 0);
+        return;
+    }
+    int half = 1 << (level-1);
+    build(a, b, level-1, newLeaves, newPotentials);
+    build(a+half, b, level-1, newLeaves, newPotentials);
+    build(a, b+half, level-1, newLeaves, newPotentials);
+    build(a+half, b+half, level-1, newLeaves, newPotentials);
+}
+
+/* The children of a leaf start with its potential. */
+void QuadtreeGrid::split(int leaf, std::vector<QuadtreeLeaf> &newLeaves,
+        std::vector<double> &newPotentials) const {
+    const QuadtreeLeaf &parent = leaves[leaf];
+    int half = 1 << (parent.level-1);
+    for(int child=0; child<4; child++) {
+        QuadtreeLeaf childLeaf;
+        childLeaf.a = parent.a + (child%2)*half;
+        childLeaf.b = parent.b + (child/2)*half;
+        childLeaf.level = parent.level-1;
+        childLeaf.boundaryCondition = false;
+        newLeaves.push_back(childLeaf);
+        newPotentials.push_back(potentials(leaf));
+    }
+}
+
+void QuadtreeGrid::setLeaves(std::vector<QuadtreeLeaf> &newLeaves, std::vector<double> &newPotentials) {
+    std::vector<long> order(newLeaves.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](long first, long second) {
+        return zOrder(newLeaves[first].a, newLeaves[first].b) < zOrder(newLeaves[second].a, newLeaves[second].b);
+    });
+
+    leaves.resize(newLeaves.size());
+    potentials.resize(newLeaves.size());
+    for(long n=0; n<(long)order.size(); n++) {
+        leaves[n] = newLeaves[order[n]];
+        potentials(n) = newPotentials[order[n]];
+    }
+
+    leafIndex.resize(lengthI, lengthJ);
+    for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+        int size = 1 << leaves[leaf].level;
+        leafIndex.block(leaves[leaf].a, leaves[leaf].b, size, size).setConstant(leaf);
+    }
+}
+
+/* Splits leaves that are more than one level bigger than a neighbour, until there
+ * aren't any.
+ */
+bool QuadtreeGrid::balance() {
+    bool changed = false;
+    while(true) {
+        std::vector<QuadtreeLeaf> newLeaves;
+        std::vector<double> newPotentials;
+        bool splitAny = false;
+        for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+            bool tooBig = false;
+            for(int side=0; side<4 && leaves[leaf].level>=2; side++) {
+                forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) {
+                    if(leaves[neighbour].level < leaves[leaf].level-1) tooBig = true;
+                });
+            }
+            if(tooBig) {
+                split(leaf, newLeaves, newPotentials);
+                splitAny = true;
+            }
+            else {
+                newLeaves.push_back(leaves[leaf]);
+                newPotentials.push_back(potentials(leaf));
+            }
+        }
+        if(!splitAny) return changed;
+        setLeaves(newLeaves, newPotentials);
+        changed = true;
+    }
+}
+
+template<typename Function>
+void QuadtreeGrid::forEachNeighbour(int leaf, int side, Function function) const {
+    const QuadtreeLeaf &current = leaves[leaf];
+    int size = 1 << current.level;
+    bool alongJ = (side < 2);   // Neighbours to the right/left are found along the j direction
+    int across;                 // The row/column just outside the leaf
+    if(side == 0) across = current.a + size;
+    else if(side == 1) across = current.a - 1;
+    else if(side == 2) across = current.b + size;
+    else across = current.b - 1;
+    if(across < 0 || across >= (alongJ ? lengthI : lengthJ)) return;
+
+    int start = alongJ ? current.b : current.a;
+    for(int position=start; position<start+size; ) {
+        int neighbour = alongJ ? leafIndex(across, position) : leafIndex(position, across);
+        const QuadtreeLeaf &other = leaves[neighbour];
+        int otherEnd = (alongJ ? other.b : other.a) + (1 << other.level);
+        int sharedLength = std::min(otherEnd, start+size) - position;
+        function(neighbour, sharedLength);
+        position += sharedLength;
+    }
+}
+
+/* Where fits is given, the potentials of neighbours that aren't level with the
+ * centre of leaf are first moved along the side to be level with it, using the
+ * neighbour's fit.
+ */
+void QuadtreeGrid::sideGradients(int leaf, double gradients[4], double distances[4],
+        const std::vector<QuadtreeFit> *fits) const {
+    const QuadtreeLeaf &current = leaves[leaf];
+    int size = 1 << current.level;
+    for(int side=0; side<4; side++) {
+        double weightedGradients = 0;
+        double weightedDistances = 0;
+        double totalLength = 0;
+        forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) {
+            const QuadtreeLeaf &other = leaves[neighbour];
+            int otherSize = 1 << other.level;
+            double distance = (size + otherSize) / 2.0;
+            double potential = potentials(neighbour);
+            if(fits && !other.boundaryCondition) {
+                const QuadtreeFit &fit = (*fits)[neighbour];
+                double offset = (side < 2) ? (current.b + size/2.0) - (other.b + otherSize/2.0) :
+                    (current.a + size/2.0) - (other.a + otherSize/2.0);
+                potential += (side < 2) ? fit.gradientB*offset + fit.curvatureB*offset*offset/2 :
+                    fit.gradientA*offset + fit.curvatureA*offset*offset/2;
+            }
+            weightedGradients += sharedLength * (potential - potentials(leaf)) / distance;
+            weightedDistances += sharedLength * distance / 2;
+            totalLength += sharedLength;
+        });
+        gradients[side] = (totalLength > 0) ? weightedGradients / totalLength : 0;
+        distances[side] = (totalLength > 0) ? weightedDistances / totalLength : size / 2.0;
+        if(side%2 == 1) gradients[side] = -gradients[side];  // Left/below are in the opposite direction
+    }
+}
+
+/* The gradient and curvature along each axis come from the gradients across the
+ * two sides. They are found twice, so the second time the first fits can be used
+ * for neighbours that aren't level with the leaf. The cross term comes from how
+ * the gradient along one axis changes between the neighbours along the other.
+ * Boundary conditions are left out of the corrections and the cross term, as the
+ * potential isn't smooth across them.
+ */
+std::vector<QuadtreeFit> QuadtreeGrid::quadraticFits() const {
+    std::vector<QuadtreeFit> firstFits;
+    std::vector<QuadtreeFit> fits(leaves.size());
+    for(int pass=0; pass<2; pass++) {
+        for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+            double gradients[4], distances[4];
+            sideGradients(leaf, gradients, distances, pass ? &firstFits : nullptr);
+            QuadtreeFit &fit = fits[leaf];
+            fit.gradientA = (gradients[0]*distances[1] + gradients[1]*distances[0]) / (distances[0] + distances[1]);
+            fit.gradientB = (gradients[2]*distances[3] + gradients[3]*distances[2]) / (distances[2] + distances[3]);
+            fit.curvatureA = (gradients[0] - gradients[1]) / (distances[0] + distances[1]);
+            fit.curvatureB = (gradients[2] - gradients[3]) / (distances[2] + distances[3]);
+        }
+        if(pass == 0) firstFits = fits;
+    }
+
+    for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+        int size = 1 << leaves[leaf].level;
+        double crossSum = 0;
+        double totalLength = 0;
+        for(int side=0; side<4; side++) {
+            double sign = (side%2 == 1) ? -1 : 1;
+            forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) {
+                if(leaves[neighbour].boundaryCondition) return;
+                double distance = (size + (1 << leaves[neighbour].level)) / 2.0;
+                double change = (side < 2) ? fits[neighbour].gradientB - fits[leaf].gradientB :
+                    fits[neighbour].gradientA - fits[leaf].gradientA;
+                crossSum += sharedLength * sign * change / distance;
+                totalLength += sharedLength;
+            });
+        }
+        fits[leaf].curvatureAB = (totalLength > 0) ? crossSum / totalLength : 0;
+    }
+    return fits;
+}
+
+long QuadtreeGrid::getNumberOfUnknowns() const {
+    long unknowns = 0;
+    for(const QuadtreeLeaf &leaf : leaves) unknowns += !leaf.boundaryCondition;
+    return unknowns;
+}
+
+int QuadtreeGrid::findLeaf(int i, int j) const {
+    int a = i - unsolvedSystem.getIMin();
+    int b = j - unsolvedSystem.getJMin();
+    if(a<0 || a>=lengthI || b<0 || b>=lengthJ) throw std::out_of_range(
+            "Error: Trying to get element out of range!");
+    return leafIndex(a, b);
+}
+
+void QuadtreeGrid::gradientTerms(int leaf, int axis, double scale,
+        std::vector<std::pair<int, double> > &terms) const {
+    int size = 1 << leaves[leaf].level;
+    for(int side=2*axis; side<2*axis+2; side++) {
+        double totalLength = 0;
+        forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) { totalLength += sharedLength; });
+        if(totalLength == 0) continue;
+        double sign = (side%2 == 1) ? -1 : 1;
+        forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) {
+            double distance = (size + (1 << leaves[neighbour].level)) / 2.0;
+            double coefficient = scale * sign * sharedLength / (2 * totalLength * distance);
+            terms.push_back(std::make_pair(neighbour, coefficient));
+            terms.push_back(std::make_pair(leaf, -coefficient));
+        });
+    }
+}
+
+/* The flux between two leaves of the same size is (shared length) * (difference in
+ * potential) / (distance between centres), as for the uniform grid. Where a leaf
+ * is next to a bigger one, their centres aren't level, so the bigger leaf's
+ * potential is moved along its gradient to be level with the smaller leaf's centre
+ * first. Without this the error doesn't go down as the grid is refined. The
+ * corrections for the two small leaves along one side of a big leaf cancel, so the
+ * big leaf's own equation doesn't need them. The equations aren't symmetric any
+ * more, so they are solved with BiCGSTAB.
+ */
+int QuadtreeGrid::solve(double tolerance) {
+    std::vector<long> unknownNumbers(leaves.size(), -1);
+    long unknowns = 0;
+    for(long leaf=0; leaf<(long)leaves.size(); leaf++) {
+        if(!leaves[leaf].boundaryCondition) unknownNumbers[leaf] = unknowns++;
+    }
+    if(unknowns == 0) return 0;
+
+    std::vector<Eigen::Triplet<double> > coefficients;
+    Eigen::VectorXd b = Eigen::VectorXd::Zero(unknowns);
+    Eigen::VectorXd guess(unknowns);
+    std::vector<std::pair<int, double> > terms;
+    for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+        long p = unknownNumbers[leaf];
+        if(p < 0) continue;
+        guess(p) = potentials(leaf);
+        const QuadtreeLeaf &current = leaves[leaf];
+        int size = 1 << current.level;
+
+        // Sum of coefficient * (leaf potential - neighbour potential) over the sides
+        terms.clear();
+        for(int side=0; side<4; side++) {
+            forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) {
+                const QuadtreeLeaf &other = leaves[neighbour];
+                int otherSize = 1 << other.level;
+                double coefficient = sharedLength / ((size + otherSize) / 2.0);
+                terms.push_back(std::make_pair(leaf, coefficient));
+                terms.push_back(std::make_pair(neighbour, -coefficient));
+                if(otherSize > size) {
+                    // Offset of this leaf's centre from the neighbour's, along the side
+                    double offset = (side < 2) ? (current.b + size/2.0) - (other.b + otherSize/2.0) :
+                        (current.a + size/2.0) - (other.a + otherSize/2.0);
+                    gradientTerms(neighbour, (side < 2) ? 1 : 0, -coefficient*offset, terms);
+                }
+            });
+        }
+        for(const std::pair<int, double> &term : terms) {
+            long q = unknownNumbers[term.first];
+            if(q >= 0) coefficients.push_back(Eigen::Triplet<double>(p, q, term.second));
+            else b(p) -= term.second * potentials(term.first);
+        }
+    }
+    Eigen::SparseMatrix<double> A(unknowns, unknowns);
+    A.setFromTriplets(coefficients.begin(), coefficients.end());
+
+    /* The default drop tolerance of the incomplete LU factorisation sometimes gives
+     * a preconditioner that makes BiCGSTAB break down, so a smaller one is used,
+     * and if it still fails the (slower but safe) diagonal preconditioner is used.
+     */
+    Eigen::BiCGSTAB<Eigen::SparseMatrix<double>, Eigen::IncompleteLUT<double> > solver;
+    solver.preconditioner().setDroptol(1e-4);
+    solver.preconditioner().setFillfactor(10);
+    solver.setTolerance(tolerance);
+    solver.compute(A);
+    Eigen::VectorXd solution = solver.solveWithGuess(b, guess);
+    int iterations = solver.iterations();
+    if(solver.info() != Eigen::Success || !solution.allFinite()) {
+        Eigen::BiCGSTAB<Eigen::SparseMatrix<double> > diagonalSolver;
+        diagonalSolver.setTolerance(tolerance);
+        diagonalSolver.compute(A);
+        solution = diagonalSolver.solveWithGuess(b, guess);
+        iterations += diagonalSolver.iterations();
+    }
+
+    for(long leaf=0; leaf<(long)leaves.size(); leaf++) {
+        if(unknownNumbers[leaf] >= 0) potentials(leaf) = solution(unknownNumbers[leaf]);
+    }
+    return iterations;
+}
+
+/* The third derivative along each axis is found from how the curvature changes
+ * between the leaf and its neighbours, and the error of the quadratic fit at the
+ * edge of the leaf is then third derivative * (size/2)^3 / 6.
+ */
+Eigen::VectorXd QuadtreeGrid::errorIndicators() const {
+    std::vector<QuadtreeFit> fits = quadraticFits();
+    Eigen::VectorXd indicators = Eigen::VectorXd::Zero(leaves.size());
+    for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+        if(leaves[leaf].boundaryCondition) continue;
+        int size = 1 << leaves[leaf].level;
+        double thirdDerivative = 0;
+        for(int side=0; side<4; side++) {
+            double weightedChanges = 0;
+            double totalLength = 0;
+            forEachNeighbour(leaf, side, [&](int neighbour, int sharedLength) {
+                if(leaves[neighbour].boundaryCondition) return;
+                double distance = (size + (1 << leaves[neighbour].level)) / 2.0;
+                double change = (side < 2) ? fits[neighbour].curvatureA - fits[leaf].curvatureA :
+                    fits[neighbour].curvatureB - fits[leaf].curvatureB;
+                weightedChanges += sharedLength * fabs(change) / distance;
+                totalLength += sharedLength;
+            });
+            if(totalLength > 0) thirdDerivative = std::max(thirdDerivative, weightedChanges / totalLength);
+        }
+        indicators(leaf) = thirdDerivative * size*size*size / 48;
+    }
+    return indicators;
+}
+
+/* Joining four leaves roughly multiplies the error indicator by 8 (it goes as
+ * size^3), and the indicators are noisy, so only leaves with less than a sixteenth
+ * of the tolerance are joined to stop them being split again straight away.
+ */
+bool QuadtreeGrid::adapt(double refinementTolerance) {
+    Eigen::VectorXd indicators = errorIndicators();
+    std::vector<bool> done(leaves.size(), false);
+    std::vector<QuadtreeLeaf> newLeaves;
+    std::vector<double> newPotentials;
+    bool changed = false;
+
+    for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+        if(done[leaf]) continue;
+        const QuadtreeLeaf &current = leaves[leaf];
+        int size = 1 << current.level;
+
+        // Join with the other three leaves of the same parent
+        if(current.a % (2*size) == 0 && current.b % (2*size) == 0 &&
+                canBeLeaf(current.a, current.b, current.level+1)) {
+            int siblings[4] = {leaf, leafIndex(current.a+size, current.b), leafIndex(current.a, current.b+size),
+                leafIndex(current.a+size, current.b+size)};
+            bool join = true;
+            double potentialSum = 0;
+            for(int sibling : siblings) {
+                join = join && !done[sibling] && leaves[sibling].level == current.level &&
+                    indicators(sibling) < refinementTolerance/16;
+                potentialSum += potentials(sibling);
+            }
+            // The parent would be split again by balance if it had a neighbour that is too small
+            for(int sibling=0; sibling<4 && join; sibling++) {
+                for(int side=0; side<4; side++) {
+                    forEachNeighbour(siblings[sibling], side, [&](int neighbour, int sharedLength) {
+                        if(leaves[neighbour].level < current.level) join = false;
+                    });
+                }
+            }
+            if(join) {
+                QuadtreeLeaf parent = current;
+                parent.level += 1;
+                newLeaves.push_back(parent);
+                newPotentials.push_back(potentialSum/4);
+                for(int sibling : siblings) done[sibling] = true;
+                changed = true;
+                continue;
+            }
+        }
+
+        if(current.level > 0 && indicators(leaf) > refinementTolerance) {
+            split(leaf, newLeaves, newPotentials);
+            changed = true;
+        }
+        else {
+            newLeaves.push_back(current);
+            newPotentials.push_back(potentials(leaf));
+        }
+        done[leaf] = true;
+    }
+
+    if(!changed) return false;
+    setLeaves(newLeaves, newPotentials);
+    balance();
+    return true;
+}
+
+void QuadtreeGrid::resample(SolvedElectrostaticSystem &solvedSystem) const {
+    if(solvedSystem.getIMin() != unsolvedSystem.getIMin() || solvedSystem.getIMax() != unsolvedSystem.getIMax() ||
+            solvedSystem.getJMin() != unsolvedSystem.getJMin() || solvedSystem.getJMax() != unsolvedSystem.getJMax()) {
+        throw std::invalid_argument("The dimensions of the solved system must match the grid!");
+    }
+
+    GridView<double> solvedPotentials = solvedSystem.potentialView();
+    std::vector<QuadtreeFit> fits = quadraticFits();
+    for(int leaf=0; leaf<(int)leaves.size(); leaf++) {
+        const QuadtreeFit &fit = fits[leaf];
+        int size = 1 << leaves[leaf].level;
+        double centre = (size-1) / 2.0;
+        for(int y=0; y<size; y++) {
+            for(int x=0; x<size; x++) {
+                double dx = x - centre;
+                double dy = y - centre;
+                long k = (leaves[leaf].a + x) + (long)(leaves[leaf].b + y)*lengthI;
+                solvedPotentials.atK(k) = potentials(leaf) + fit.gradientA*dx + fit.gradientB*dy +
+                    fit.curvatureA*dx*dx/2 + fit.curvatureB*dy*dy/2 + fit.curvatureAB*dx*dy;
+            }
+        }
+    }
+}
+
+} // namespace electrostatics
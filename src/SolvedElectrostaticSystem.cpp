@@ -2,66 +2,151 @@
 #include <stdexcept>
 #include "ElectrostaticSystem.h"
 #include <iostream>
-#include <fstream>
 #include <cmath>
 #include <string>
-#include <list>
+#include <algorithm>
 #include <vector>
 #include "SolvedElectrostaticSystem.h"
+#include "phaseTimer.h"
+#include "textExport.h"
 
 namespace electrostatics {
 
 /* Constructors */
 
 SolvedElectrostaticSystem::SolvedElectrostaticSystem(int iMin, int iMax, int jMin, int jMax) :
-    ElectrostaticSystem(iMin, iMax, jMin, jMax) {
-        fieldFound = false;
-        maxField = 0;
+    ElectrostaticSystem(iMin, iMax, jMin, jMax) {}
+
+
+/* The field from the potentials, indexed from 0 by (a, b), at a single point or
+ * along a whole row. A grid one point wide has no field across it.
+ */
+static inline void fieldAtPoint(const double *potentials, int lengthI, int lengthJ, int a, int b,
+        double &fieldX, double &fieldY) {
+    long k = a + (long)b*lengthI;
+    // Components in i direction
+    if(lengthI == 1) fieldX = 0;
+    else if(a == lengthI-1) fieldX = -(potentials[k] - potentials[k-1]);
+    else if(a == 0) fieldX = -(potentials[k+1] - potentials[k]);
+    else fieldX = -((potentials[k+1] - potentials[k-1])/2);
+
+    // Components in j direction
+    if(lengthJ == 1) fieldY = 0;
+    else if(b == lengthJ-1) fieldY = -(potentials[k] - potentials[k-lengthI]);
+    else if(b == 0) fieldY = -(potentials[k+lengthI] - potentials[k]);
+    else fieldY = -((potentials[k+lengthI] - potentials[k-lengthI])/2);
+}
+
+/* Away from the ends of the row the same differences are taken at every point,
+ * so the loops can be vectorised.
+ */
+static void fieldAlongRow(const double *potentials, int lengthI, int lengthJ, int b,
+        double *fieldX, double *fieldY) {
+    const double *row = potentials + (long)b*lengthI;
+    for(int a=1; a<lengthI-1; a++) fieldX[a] = -((row[a+1] - row[a-1])/2);
+    if(lengthI == 1) fieldX[0] = 0;
+    else {
+        fieldX[0] = -(row[1] - row[0]);
+        fieldX[lengthI-1] = -(row[lengthI-1] - row[lengthI-2]);
+    }
+
+    if(lengthJ == 1) {
+        for(int a=0; a<lengthI; a++) fieldY[a] = 0;
+    }
+    else if(b == lengthJ-1) {
+        const double *below = row - lengthI;
+        for(int a=0; a<lengthI; a++) fieldY[a] = -(row[a] - below[a]);
+    }
+    else if(b == 0) {
+        const double *above = row + lengthI;
+        for(int a=0; a<lengthI; a++) fieldY[a] = -(above[a] - row[a]);
+    }
+    else {
+        const double *below = row - lengthI;
+        const double *above = row + lengthI;
+        for(int a=0; a<lengthI; a++) fieldY[a] = -((above[a] - below[a])/2);
+    }
 }
 
 
 /* Methods */
 
-void SolvedElectrostaticSystem::findField() {
-    fieldX = doubleGrid::Zero(iMax-iMin+1, jMax-jMin+1);    // X components of field
-    fieldY = doubleGrid::Zero(iMax-iMin+1, jMax-jMin+1);    // Y components of field
-    field = doubleGrid::Zero(iMax-iMin+1, jMax-jMin+1);     // Magnitude of field
-    for(int i=iMin; i<=iMax; i++) {
-        for(int j=jMin; j<=jMax; j++) {
-            // Components in i direction
-            if(i==iMax) fieldX(i-iMin, j-jMin) = -(getPotentialIJ(i, j) - getPotentialIJ(i-1, j));
-            else if(i==iMin) fieldX(i-iMin, j-jMin) = -(getPotentialIJ(i+1, j)  - getPotentialIJ(i, j));
-            else fieldX(i-iMin, j-jMin) = -((getPotentialIJ(i+1, j) - getPotentialIJ(i-1, j))/2);
-
-            // Components in j direction
-            if(j==jMax) fieldY(i-iMin, j-jMin) = -(getPotentialIJ(i, j) - getPotentialIJ(i, j-1));
-            else if(j==jMin) fieldY(i-iMin, j-jMin) = -(getPotentialIJ(i, j+1)  - getPotentialIJ(i, j));
-            else fieldY(i-iMin, j-jMin) = -((getPotentialIJ(i, j+1) - getPotentialIJ(i, j-1))/2);
-
-            // Full field
-            double currentField = sqrt( pow(fieldX(i-iMin, j-jMin), 2) +
-                    pow(fieldY(i-iMin, j-jMin), 2) );
-            field(i-iMin, j-jMin) = currentField;
-
-            if(currentField > maxField) maxField = currentField;
+void SolvedElectrostaticSystem::getFieldIJ(int i, int j, double &fieldX, double &fieldY) const {
+    if(i>iMax || i<iMin || j>jMax || j<jMin) throw std::out_of_range("Error: Trying to get element out of range!");
+    fieldAtPoint(potentials.data(), getLengthI(), getLengthJ(), i-iMin, j-jMin, fieldX, fieldY);
+}
+
+void SolvedElectrostaticSystem::findFieldRow(int j, double *fieldX, double *fieldY) const {
+    if(j>jMax || j<jMin) throw std::out_of_range("Error: Trying to get element out of range!");
+    fieldAlongRow(potentials.data(), getLengthI(), getLengthJ(), j-jMin, fieldX, fieldY);
+}
+
+/* The rows are split between OpenMP threads (when compiled with openmp), each
+ * with its own row of field components, and the largest squared magnitudes of
+ * the threads are combined at the end.
+ */
+double SolvedElectrostaticSystem::findMaxField() const {
+    ScopedPhase fieldPhase("field: compute");
+    int lengthI = getLengthI();
+    int lengthJ = getLengthJ();
+    double maxFieldSquared = 0;
+    #pragma omp parallel reduction(max:maxFieldSquared)
+    {
+        std::vector<double> fieldX(lengthI);
+        std::vector<double> fieldY(lengthI);
+        #pragma omp for schedule(static)
+        for(int b=0; b<lengthJ; b++) {
+            fieldAlongRow(potentials.data(), lengthI, lengthJ, b, fieldX.data(), fieldY.data());
+            for(int a=0; a<lengthI; a++) {
+                maxFieldSquared = std::max(maxFieldSquared, fieldX[a]*fieldX[a] + fieldY[a]*fieldY[a]);
+            }
         }
     }
-    fieldFound = true;
+    return sqrt(maxFieldSquared);
 }
 
-void SolvedElectrostaticSystem::saveFieldGNUPlot(std::string fileName) {
-    if(!fieldFound) findField();
-    std::ofstream outputFile;
-    outputFile.open(fileName.c_str());
-    for(int i=iMin; i<=iMax; i++) {
-        for(int j=jMin; j<=jMax; j++) {
-            double fieldMagnitude = sqrt( pow(fieldX(i-iMin, j-jMin), 2) + pow(fieldY(i-iMin, j-jMin), 2) );
-            outputFile << i << " " << j << " " << fieldX(i-iMin, j-jMin)/fieldMagnitude << 
-            " " << fieldY(i-iMin, j-jMin)/fieldMagnitude <<"\n";
-        }
-        outputFile << "\n";
+void SolvedElectrostaticSystem::saveFieldGNUPlot(std::string fileName, bool roundTrip) const {
+    saveFieldGNUPlot(fileName, 1, iMin, iMax, jMin, jMax, roundTrip);
+}
+
+/* Each row of the file is one point, with a blank line after each column i. Only
+ * the points that are written are found, as they are written, on the threads
+ * formatting the rows.
+ */
+void SolvedElectrostaticSystem::saveFieldGNUPlot(std::string fileName, int spacing, int iStart, int iEnd,
+        int jStart, int jEnd, bool roundTrip) const {
+    if(iStart<iMin || iEnd>iMax || jStart<jMin || jEnd>jMax) {
+        throw std::out_of_range("Error: The region of the field to save isn't in the grid!");
+    }
+    if(spacing < 1 || iStart > iEnd || jStart > jEnd) {
+        throw std::invalid_argument("Error: The spacing must be at least 1 and the region not empty!");
     }
-    outputFile.close();
+
+    ScopedPhase exportPhase("export: field text");
+    int lengthI = getLengthI();
+    int lengthJ = getLengthJ();
+    const double *potentialData = potentials.data();
+    long columns = (iEnd-iStart) / spacing + 1;
+    long pointsPerColumn = (jEnd-jStart) / spacing + 1;
+    long maxRowCharacters = pointsPerColumn * (2*maxIntCharacters + 2*maxDoubleCharacters + 4) + 1;
+    writeTextRows(fileName, columns, maxRowCharacters, [&](long row, char *out) {
+        int i = iStart + row*spacing;
+        for(int j=jStart; j<=jEnd; j+=spacing) {
+            double fieldX, fieldY;
+            fieldAtPoint(potentialData, lengthI, lengthJ, i-iMin, j-jMin, fieldX, fieldY);
+            double fieldMagnitude = sqrt(fieldX*fieldX + fieldY*fieldY);
+            out = formatInt(out, i);
+            *out++ = ' ';
+            out = formatInt(out, j);
+            *out++ = ' ';
+            out = formatDouble(out, fieldX/fieldMagnitude, roundTrip);
+            *out++ = ' ';
+            out = formatDouble(out, fieldY/fieldMagnitude, roundTrip);
+            *out++ = '\n';
+        }
+        *out++ = '\n';
+        return out;
+    });
 }
 
 } // namespace electrostatics
@@ -0,0 +1,124 @@
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "finiteDiffMatrix.h"
+#include "SuperpositionBasis.h"
+#include "GridView.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* Constructor
+ *
+ * Column e of the right hand side holds the contributions of the boundary
+ * conditions of electrode e at 1V, and the last column holds the contributions
+ * of the boundary conditions that aren't part of an electrode at their own
+ * potentials.
+ */
+SuperpositionBasis::SuperpositionBasis(const UnsolvedElectrostaticSystem &unsolvedSystem) :
+    iMin(unsolvedSystem.getIMin()), iMax(unsolvedSystem.getIMax()),
+    jMin(unsolvedSystem.getJMin()), jMax(unsolvedSystem.getJMax()),
+    electrodeNames(unsolvedSystem.getElectrodeNames()) {
+
+        int electrodes = electrodeNames.size();
+        int lengthI = unsolvedSystem.getLengthI();
+        int lengthJ = unsolvedSystem.getLengthJ();
+
+        Eigen::SparseMatrix<double> A;
+        Eigen::VectorXd boundaryValues;
+        std::vector<long> unknownPositions;
+        reducedSystem(unsolvedSystem, A, boundaryValues, unknownPositions);
+        long unknowns = unknownPositions.size();
+
+        GridView<const bool> boundaryConditions = unsolvedSystem.boundaryConditionView();
+        GridView<const double> potentials = unsolvedSystem.potentialView();
+
+        // The value of each boundary condition in each of the solutions
+        defaultVoltages.assign(electrodes, 0);
+        std::vector<bool> voltageFound(electrodes, false);
+        electrodeSolutions.assign(electrodes, doubleGrid::Zero(lengthI, lengthJ));
+        fixedSolution = doubleGrid::Zero(lengthI, lengthJ);
+        for(int j=jMin; j<=jMax; j++) {
+            for(int i=iMin; i<=iMax; i++) {
+                if(!boundaryConditions(i, j)) continue;
+                int electrode = unsolvedSystem.getElectrodeIJ(i, j);
+                if(electrode < 0) {
+                    fixedSolution(i-iMin, j-jMin) = potentials(i, j);
+                }
+                else {
+                    electrodeSolutions[electrode](i-iMin, j-jMin) = 1;
+                    if(!voltageFound[electrode]) {
+                        defaultVoltages[electrode] = potentials(i, j);
+                        voltageFound[electrode] = true;
+                    }
+                    else if(potentials(i, j) != defaultVoltages[electrode]) {
+                        throw std::invalid_argument("Error: Electrode " + electrodeNames[electrode] +
+                                " has more than one voltage!");
+                    }
+                }
+            }
+        }
+
+        // Right hand sides: sum of the surrounding boundary values for each unknown
+        Eigen::MatrixXd rightHandSides = Eigen::MatrixXd::Zero(unknowns, electrodes+1);
+        for(long n=0; n<unknowns; n++) {
+            int a = unknownPositions[n] % lengthI;
+            int b = unknownPositions[n] / lengthI;
+            int neighboursA[4] = {a+1, a-1, a, a};
+            int neighboursB[4] = {b, b, b+1, b-1};
+            for(int neighbour=0; neighbour<4; neighbour++) {
+                int neighbourA = neighboursA[neighbour];
+                int neighbourB = neighboursB[neighbour];
+                if(neighbourA<0 || neighbourA>=lengthI || neighbourB<0 || neighbourB>=lengthJ) continue;
+                if(!boundaryConditions(neighbourA+iMin, neighbourB+jMin)) continue;
+                int electrode = unsolvedSystem.getElectrodeIJ(neighbourA+iMin, neighbourB+jMin);
+                if(electrode < 0) rightHandSides(n, electrodes) += fixedSolution(neighbourA, neighbourB);
+                else rightHandSides(n, electrode) += 1;
+            }
+        }
+
+        // Factorize once and solve for every right hand side together
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver;
+        solver.compute(A);
+        Eigen::MatrixXd solutions = solver.solve(rightHandSides);
+
+        for(long n=0; n<unknowns; n++) {
+            int a = unknownPositions[n] % lengthI;
+            int b = unknownPositions[n] / lengthI;
+            for(int electrode=0; electrode<electrodes; electrode++) {
+                electrodeSolutions[electrode](a, b) = solutions(n, electrode);
+            }
+            fixedSolution(a, b) = solutions(n, electrodes);
+        }
+}
+
+
+/* Methods */
+
+int SuperpositionBasis::getElectrodeNumber(std::string name) const {
+    for(unsigned int electrode=0; electrode<electrodeNames.size(); electrode++) {
+        if(electrodeNames[electrode] == name) return electrode;
+    }
+    throw std::invalid_argument("Error: There is no electrode called " + name + "!");
+}
+
+void SuperpositionBasis::combine(const std::vector<double> &voltages,
+        SolvedElectrostaticSystem &solvedSystem) const {
+    if(voltages.size() != electrodeSolutions.size()) {
+        throw std::invalid_argument("There must be one voltage for each electrode!");
+    }
+    if(solvedSystem.getIMin() != iMin || solvedSystem.getIMax() != iMax ||
+            solvedSystem.getJMin() != jMin || solvedSystem.getJMax() != jMax) {
+        throw std::invalid_argument("The dimensions of the solved system must match the basis!");
+    }
+    doubleGrid potentials = fixedSolution;
+    for(unsigned int electrode=0; electrode<voltages.size(); electrode++) {
+        potentials += voltages[electrode] * electrodeSolutions[electrode];
+    }
+    solvedSystem.setPotentials(potentials);
+}
+
+} // namespace electrostatics
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TaskGraph.h"
+
+namespace electrostatics {
+
+int TaskGraph::addTask(std::function<void(std::ostream&)> function, const std::vector<std::string> &reads,
+        const std::vector<std::string> &writes, bool barrier) {
+    int number = tasks.size();
+    Task task;
+    task.function = function;
+
+    if(barrier) {
+        // Waiting for the last barrier and everything since it means waiting for everything
+        for(int earlier=std::max(lastBarrier, 0); earlier<number; earlier++) {
+            task.dependencies.push_back(earlier);
+        }
+        lastBarrier = number;
+        lastWriter.clear();
+        readersSinceWrite.clear();
+    }
+    else {
+        if(lastBarrier >= 0) task.dependencies.push_back(lastBarrier);
+        for(const std::string &resource : reads) {
+            if(lastWriter.count(resource)) task.dependencies.push_back(lastWriter.at(resource));
+        }
+        for(const std::string &resource : writes) {
+            if(lastWriter.count(resource)) task.dependencies.push_back(lastWriter.at(resource));
+            if(readersSinceWrite.count(resource)) {
+                const std::vector<int> &readers = readersSinceWrite.at(resource);
+                task.dependencies.insert(task.dependencies.end(), readers.begin(), readers.end());
+            }
+        }
+        for(const std::string &resource : reads) readersSinceWrite[resource].push_back(number);
+        for(const std::string &resource : writes) {
+            lastWriter[resource] = number;
+            readersSinceWrite[resource].clear();
+        }
+    }
+
+    std::sort(task.dependencies.begin(), task.dependencies.end());
+    task.dependencies.erase(std::unique(task.dependencies.begin(), task.dependencies.end()),
+            task.dependencies.end());
+    tasks.push_back(task);
+    return number;
+}
+
+void TaskGraph::run(int threads, std::ostream &output) {
+    if(threads <= 1 || tasks.size() <= 1) runInOrder(output);
+    else runInParallel(threads, output);
+}
+
+void TaskGraph::runInOrder(std::ostream &output) {
+    for(Task &task : tasks) task.function(output);
+}
+
+/* Each thread repeatedly takes the earliest task that is ready (all the tasks it
+ * waits for have finished) and runs it. Once a task has failed, only tasks before
+ * it are started, as they would have run if the tasks were run in order.
+ */
+void TaskGraph::runInParallel(int threads, std::ostream &output) {
+    int numberOfTasks = tasks.size();
+    std::vector<std::vector<int> > dependents(numberOfTasks);
+    std::vector<int> waitingFor(numberOfTasks);
+    std::set<int> ready;
+    for(int task=0; task<numberOfTasks; task++) {
+        waitingFor[task] = tasks[task].dependencies.size();
+        for(int dependency : tasks[task].dependencies) dependents[dependency].push_back(task);
+        if(waitingFor[task] == 0) ready.insert(task);
+    }
+
+    std::vector<std::ostringstream> outputs(numberOfTasks);
+    std::vector<bool> finished(numberOfTasks, false);
+    int nextToWrite = 0;
+    int running = 0;
+    int failedTask = numberOfTasks;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            while((ready.empty() || *ready.begin() >= failedTask) && running > 0) changed.wait(lock);
+            if(ready.empty() || *ready.begin() >= failedTask) break;
+
+            int task = *ready.begin();
+            ready.erase(ready.begin());
+            running++;
+            lock.unlock();
+            std::exception_ptr taskError;
+            try {
+                tasks[task].function(outputs[task]);
+            }
+            catch(...) {
+                taskError = std::current_exception();
+            }
+            lock.lock();
+            running--;
+            finished[task] = true;
+
+            if(taskError) {
+                if(task < failedTask) {
+                    failedTask = task;
+                    error = taskError;
+                }
+            }
+            else {
+                for(int dependent : dependents[task]) {
+                    if(--waitingFor[dependent] == 0) ready.insert(dependent);
+                }
+            }
+
+            while(nextToWrite < failedTask && finished[nextToWrite]) {
+                output << outputs[nextToWrite].str();
+                outputs[nextToWrite].str("");
+                nextToWrite++;
+            }
+            output.flush();
+            changed.notify_all();
+        }
+        changed.notify_all();
+    };
+
+    std::vector<std::thread> workers;
+    for(int thread=1; thread<std::min(threads, numberOfTasks); thread++) workers.emplace_back(worker);
+    worker();
+    for(std::thread &thread : workers) thread.join();
+
+    if(error) std::rethrow_exception(error);
+}
+
+} // namespace electrostatics
@@ -1,6 +1,9 @@
 #include <Eigen/Dense>
 #include <stdexcept>
+#include <algorithm>
 #include <cmath>
+#include <string>
+#include <vector>
 #include "ElectrostaticSystem.h"
 #include "UnsolvedElectrostaticSystem.h"
 
@@ -12,6 +15,7 @@ UnsolvedElectrostaticSystem::UnsolvedElectrostaticSystem(int iMin, int iMax, int
     ElectrostaticSystem(iMin, iMax, jMin, jMax) {
         boundaryConditionPositions = boolGrid(potentials.rows(), potentials.cols());
         boundaryConditionPositions.fill(false);
+        currentElectrode = -1;
 }
 
 
@@ -23,18 +27,94 @@ bool UnsolvedElectrostaticSystem::isBoundaryConditionIJ(int i, int j) const {
 }
 bool UnsolvedElectrostaticSystem::isBoundaryConditionK(long k) const {
     if(k>kMax || k<0) throw std::out_of_range("Error: Trying to get element out of range!");
-    int* ij = k2ij(k);
-    return boundaryConditionPositions(ij[0]-iMin, ij[1]-jMin);
+    return boundaryConditionPositions.data()[k];
+}
+
+/* Runs are found with std::find, which is much quicker than testing each point
+ * in a loop.
+ */
+RowSpans UnsolvedElectrostaticSystem::interiorSpans() const {
+    int lengthI = getLengthI();
+    int lengthJ = getLengthJ();
+    RowSpans interior;
+    interior.rowStarts.reserve(lengthJ+1);
+    for(int b=0; b<lengthJ; b++) {
+        interior.rowStarts.push_back(interior.spans.size());
+        const bool *row = boundaryConditionPositions.data() + (long)b*lengthI;
+        const bool *point = row;
+        while(point < row+lengthI) {
+            const bool *start = std::find(point, row+lengthI, false);
+            if(start == row+lengthI) break;
+            point = std::find(start, row+lengthI, true);
+            interior.spans.push_back(PointSpan{(int)(start-row), (int)(point-row)});
+        }
+    }
+    interior.rowStarts.push_back(interior.spans.size());
+    return interior;
 }
 
 void UnsolvedElectrostaticSystem::setBoundaryConditionIJ(int i, int j, bool isBoundaryCondition) {
     if(i>iMax || i<iMin || j>jMax || j<jMin) throw std::out_of_range("Error: Trying to set element out of range!");
     boundaryConditionPositions(i-iMin, j-jMin) = isBoundaryCondition;
+    if(electrodeNumbers.size() > 0) {
+        electrodeNumbers(i-iMin, j-jMin) = isBoundaryCondition ? currentElectrode : -1;
+    }
 }
 void UnsolvedElectrostaticSystem::setBoundaryConditionK(long k, bool isBoundaryCondition) {
     if(k>kMax || k<0) throw std::out_of_range("Error: Trying to set element out of range!");
-    int* ij = k2ij(k);
-    boundaryConditionPositions(ij[0]-iMin, ij[1]-jMin) = isBoundaryCondition;
+    int i, j;
+    k2ij(k, i, j);
+    setBoundaryConditionIJ(i, j, isBoundaryCondition);
+}
+
+void UnsolvedElectrostaticSystem::selectElectrode(std::string name) {
+    if(electrodeNumbers.size() == 0) {
+        electrodeNumbers = Eigen::MatrixXi::Constant(potentials.rows(), potentials.cols(), -1);
+    }
+    for(unsigned int electrode=0; electrode<electrodeNames.size(); electrode++) {
+        if(electrodeNames[electrode] == name) {
+            currentElectrode = electrode;
+            return;
+        }
+    }
+    electrodeNames.push_back(name);
+    currentElectrode = electrodeNames.size()-1;
+}
+void UnsolvedElectrostaticSystem::deselectElectrode() {
+    currentElectrode = -1;
+}
+
+int UnsolvedElectrostaticSystem::getElectrodeIJ(int i, int j) const {
+    if(i>iMax || i<iMin || j>jMax || j<jMin) throw std::out_of_range("Error: Trying to get element out of range!");
+    if(electrodeNumbers.size() == 0) return -1;
+    return electrodeNumbers(i-iMin, j-jMin);
+}
+
+doubleGrid UnsolvedElectrostaticSystem::startingPotentials(const ElectrostaticSystem *initialGuess) const {
+    if(initialGuess == nullptr) {
+        return boundaryConditionPositions.select(potentials, 0.0);
+    }
+    if(initialGuess->getIMin() != iMin || initialGuess->getIMax() != iMax ||
+            initialGuess->getJMin() != jMin || initialGuess->getJMax() != jMax) {
+        throw std::invalid_argument("Error: Initial guess has different extents to the system!");
+    }
+    return boundaryConditionPositions.select(potentials, initialGuess->getPotentials());
+}
+
+/* The span is clipped to the grid, then the boundary conditions, potentials and
+ * electrode numbers are filled in along the row, where they are next to each
+ * other in memory.
+ */
+void UnsolvedElectrostaticSystem::setBoundarySpan(int j, int iStart, int iEnd, double potential) {
+    if(j<jMin || j>jMax) return;
+    iStart = std::max(iStart, iMin);
+    iEnd = std::min(iEnd, iMax);
+    if(iStart > iEnd) return;
+    long kStart = (iStart-iMin) + (long)(j-jMin)*getLengthI();
+    long count = iEnd - iStart + 1;
+    std::fill_n(boundaryConditionPositions.data()+kStart, count, true);
+    std::fill_n(potentials.data()+kStart, count, potential);
+    if(electrodeNumbers.size() > 0) std::fill_n(electrodeNumbers.data()+kStart, count, currentElectrode);
 }
 
 void UnsolvedElectrostaticSystem::setBoundaryPoint(int i, int j, double potential) {
@@ -43,6 +123,7 @@ void UnsolvedElectrostaticSystem::setBoundaryPoint(int i, int j, double potentia
     setPotentialIJ(i, j, potential);
 }
 
+/* Points off the grid are left out by setBoundarySpan. */
 void UnsolvedElectrostaticSystem::setBoundaryRing(int centreI, int centreJ, double radius, double potential) {
     int iOffset, jOffset;
     // i offsets from the centre of the ring
@@ -50,38 +131,43 @@ void UnsolvedElectrostaticSystem::setBoundaryRing(int centreI, int centreJ, doub
         // Will only happen for the most extreme i values
         if(iOffset > radius) jOffset = 0;
         else jOffset = round(sqrt( pow(radius,2)-pow(iOffset,2) ));
-        // Try / catch is not the proper way to do this, but it is by far the most convenient
-        try{
-            setBoundaryPoint(centreI+iOffset, centreJ+jOffset, potential);
-            setBoundaryPoint(centreI+iOffset, centreJ-jOffset, potential);
-            setBoundaryPoint(centreI-iOffset, centreJ+jOffset, potential);
-            setBoundaryPoint(centreI-iOffset, centreJ-jOffset, potential);
-        } catch (const std::out_of_range& e) {}
+        setBoundarySpan(centreJ+jOffset, centreI+iOffset, centreI+iOffset, potential);
+        setBoundarySpan(centreJ-jOffset, centreI+iOffset, centreI+iOffset, potential);
+        setBoundarySpan(centreJ+jOffset, centreI-iOffset, centreI-iOffset, potential);
+        setBoundarySpan(centreJ-jOffset, centreI-iOffset, centreI-iOffset, potential);
     }
     // j offsets from the centre of the ring
     for(jOffset=ceil(radius); jOffset>=0; jOffset--) {
         // Will only happen for the most extreme j values
         if(jOffset > radius) iOffset = 0;
         else iOffset = round(sqrt( std::pow(radius,2)-pow(jOffset,2) ));
-        // Try / catch is not the proper way to do this, but it is by far the most convenient
-        try{
-            setBoundaryPoint(centreI+iOffset, centreJ+jOffset, potential);
-            setBoundaryPoint(centreI+iOffset, centreJ-jOffset, potential);
-            setBoundaryPoint(centreI-iOffset, centreJ+jOffset, potential);
-            setBoundaryPoint(centreI-iOffset, centreJ-jOffset, potential);
-        } catch (const std::out_of_range& e) {}
+        setBoundarySpan(centreJ+jOffset, centreI+iOffset, centreI+iOffset, potential);
+        setBoundarySpan(centreJ-jOffset, centreI+iOffset, centreI+iOffset, potential);
+        setBoundarySpan(centreJ+jOffset, centreI-iOffset, centreI-iOffset, potential);
+        setBoundarySpan(centreJ-jOffset, centreI-iOffset, centreI-iOffset, potential);
     }
 }
 
+/* A point is in the circle if its distance from the centre is at most radius. */
+static bool insideCircle(long iOffset, long jOffset, double radius) {
+    return sqrt((double)(iOffset*iOffset + jOffset*jOffset)) <= radius;
+}
+
+/* Each row of the circle is a single span. Its half width is found from
+ * Pythagoras, then adjusted with the same test as for a single point, so rounding
+ * can't change which points are in the circle.
+ */
 void UnsolvedElectrostaticSystem::setBoundaryCircle(int centreI, int centreJ, double radius, double potential) {
-    for(int i=centreI-ceil(radius); i<=centreI+ceil(radius); i++) {
-        for(int j=centreJ-ceil(radius); j<=centreJ+ceil(radius); j++) {
-            // If point is inside the circle and on the grid, set it to potential
-            if((sqrt( pow(i-centreI,2)+pow(j-centreJ,2) ) <= radius) && 
-                    i>=iMin && i<=iMax && j>=jMin && j<=jMax) {
-                setBoundaryPoint(i, j, potential);
-            }
-        }
+    int jStart = std::max(centreJ-(int)ceil(radius), jMin);
+    int jEnd = std::min(centreJ+(int)ceil(radius), jMax);
+    for(int j=jStart; j<=jEnd; j++) {
+        long jOffset = j-centreJ;
+        if(!insideCircle(0, jOffset, radius)) continue;
+        long halfWidth = floor(sqrt(std::max(0.0, radius*radius - (double)(jOffset*jOffset))));
+        while(insideCircle(halfWidth+1, jOffset, radius)) halfWidth++;
+        while(!insideCircle(halfWidth, jOffset, radius)) halfWidth--;
+        setBoundarySpan(j, std::max((long)iMin-1, centreI-halfWidth), std::min((long)iMax+1, centreI+halfWidth),
+                potential);
     }
 }
 
@@ -97,7 +183,7 @@ void UnsolvedElectrostaticSystem::setBoundaryLine(int i1, int j1, int i2, int j2
             j1 = j2;
             j2 = jTemp;
         }
-        for(int j=j1; j<=j2; j++) setBoundaryPoint(i1, j, potential);
+        for(int j=j1; j<=j2; j++) setBoundarySpan(j, i1, i1, potential);
     }
     // Constant y value
     else if((j2-j1) == 0) {
@@ -107,7 +193,7 @@ void UnsolvedElectrostaticSystem::setBoundaryLine(int i1, int j1, int i2, int j2
             i1 = i2;
             i2 = iTemp;
         }
-        for(int i=i1; i<=i2; i++) setBoundaryPoint(i, j1, potential);
+        setBoundarySpan(j1, i1, i2, potential);
     }
     // Any other gradient
     else {
@@ -124,7 +210,7 @@ void UnsolvedElectrostaticSystem::setBoundaryLine(int i1, int j1, int i2, int j2
         double y = j1;
         double gradient = (j2-j1)/(double)(i2-i1);
         while(x<=i2) {
-            setBoundaryPoint(round(x), round(y), potential);
+            setBoundarySpan(round(y), round(x), round(x), potential);
             x += (gradient<=1)?(1):(1/gradient);
             y += (gradient<=1)?(gradient):(1);
         }
@@ -144,8 +230,12 @@ void UnsolvedElectrostaticSystem::setBottomBoundary(double potential) {
     setBoundaryLine(iMin, jMin, iMax, jMin, potential);
 }
 
+/* All four corners are checked first, so nothing is set if any edge is off the grid. */
 void UnsolvedElectrostaticSystem::setBoundaryRectangle(int left, int right,
         int top, int bottom, double potential) {
+    if(left>iMax || left<iMin || right>iMax || right<iMin || top>jMax || top<jMin || bottom>jMax || bottom<jMin) {
+        throw std::out_of_range("Error: Trying to set elements out of range!");
+    }
     setBoundaryLine(left, top, right, top, potential);
     setBoundaryLine(left, bottom, right, bottom, potential);
     setBoundaryLine(left, bottom, left, top, potential);
@@ -1,29 +1,78 @@
 #include "analyticalSolutions.h"
+#include "GridView.h"
 #include <cmath>
 
 namespace electrostatics {
 
+/* The solutions at a point, with everything that is the same for every point
+ * already worked out, for the single point and grid functions to share.
+ */
+static inline double problem1(double radiusSquared, double radiusA, double radiusB, double potentialA,
+        double potentialB, double slope) {
+    double radius = sqrt(radiusSquared);
+    if(radius > radiusA && radius <= radiusB) return potentialA + slope * log(radius/radiusA);
+    return (radius > radiusB) ? potentialB : potentialA;
+}
+
+/* Outside the cylinder the potential is E cos(theta) (R^2/r - r), and as
+ * cos(theta) = i/r this is E i (R^2/r^2 - 1), without needing theta or r.
+ */
+static inline double problem2(double i, double radiusSquared, double cylinderRadius, double uniformField) {
+    double potential = uniformField * i * (cylinderRadius*cylinderRadius / radiusSquared - 1);
+    return (sqrt(radiusSquared) > cylinderRadius) ? potential : 0;
+}
+
 double analyticalProblem1(int i, int j, double radiusA, double radiusB, double potentialA, double potentialB) {
-    double radius = sqrt(pow(i, 2) + pow(j, 2));
-    if(radius > radiusA && radius <= radiusB) {
-        return potentialA + ((potentialB-potentialA) / log(radiusB/radiusA)) * log(radius/radiusA);
-    }
-    else if(radius > radiusB) {
-        return potentialB;
-    }
-    else {
-        return potentialA;
-    }
+    double slope = (potentialB-potentialA) / log(radiusB/radiusA);
+    return problem1((double)i*i + (double)j*j, radiusA, radiusB, potentialA, potentialB, slope);
 }
 
 double analyticalProblem2(int i, int j, double cylinderRadius, double uniformField) {
-    double radius = sqrt(pow(i, 2) + pow(j, 2));
-    if(radius > cylinderRadius) {
-        double theta = (i==0)? M_PI/2 : atan((double)j/i);
-        return ((i>=0)? 1 : -1) * uniformField * cos(theta) * ((pow(cylinderRadius, 2) / radius) - radius);
+    return problem2(i, (double)i*i + (double)j*j, cylinderRadius, uniformField);
+}
+
+/* Only the points between the cylinders need a log, so they are done in a
+ * second pass over the row, after the rest of the row has been vectorised.
+ */
+void analyticalProblem1Grid(GridView<double> potentials, double radiusA, double radiusB, double potentialA,
+        double potentialB) {
+    double slope = (potentialB-potentialA) / log(radiusB/radiusA);
+    int iMin = potentials.getIMin();
+    int lengthI = potentials.getLengthI();
+    #pragma omp parallel for schedule(static)
+    for(int j=potentials.getJMin(); j<=potentials.getJMax(); j++) {
+        double *row = potentials.row(j).begin();
+        double jSquared = (double)j*j;
+        bool between = false;
+        for(int a=0; a<lengthI; a++) {
+            double i = iMin + a;
+            double radius = sqrt(i*i + jSquared);
+            between |= (radius > radiusA && radius <= radiusB);
+            row[a] = (radius > radiusB) ? potentialB : potentialA;
+        }
+        if(!between) continue;
+        for(int a=0; a<lengthI; a++) {
+            double i = iMin + a;
+            double radiusSquared = i*i + jSquared;
+            double radius = sqrt(radiusSquared);
+            if(radius > radiusA && radius <= radiusB) {
+                row[a] = problem1(radiusSquared, radiusA, radiusB, potentialA, potentialB, slope);
+            }
+        }
     }
-    else {
-        return 0;
+}
+
+void analyticalProblem2Grid(GridView<double> potentials, double cylinderRadius, double uniformField) {
+    int iMin = potentials.getIMin();
+    int lengthI = potentials.getLengthI();
+    #pragma omp parallel for schedule(static)
+    for(int j=potentials.getJMin(); j<=potentials.getJMax(); j++) {
+        double *row = potentials.row(j).begin();
+        double jSquared = (double)j*j;
+        for(int a=0; a<lengthI; a++) {
+            double i = iMin + a;
+            row[a] = problem2(i, i*i + jSquared, cylinderRadius, uniformField);
+        }
     }
 }
 
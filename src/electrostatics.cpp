@@ -3,6 +3,16 @@
 #include "UnsolvedElectrostaticSystem.h"
 #include "finiteDiffMatrix.h"
 #include "finiteDiffIterative.h"
+#include "finiteDiffMultigrid.h"
+#include "finiteDiffDecomposed.h"
+#include "finiteDiffQuadtree.h"
+#include "SuperpositionBasis.h"
+#include "solutionFile.h"
+#include "textExport.h"
+#include "TaskGraph.h"
+#include "phaseTimer.h"
+#include "rasterPlot.h"
+#include "equipotentials.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -11,33 +21,112 @@
 #include <unordered_map>
 #include <cstdlib>
 #include <ctime>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+/* The systems etc are shared by commands that can run on different threads (see
+ * TaskGraph), so they are kept in maps that are locked while they are searched or
+ * changed. Elements of an unordered_map never move, so a reference to one stays
+ * valid while others are added.
+ */
+template<typename Value>
+class LockedMap {
+    protected:
+        std::unordered_map<std::string, Value> map;
+        mutable std::mutex mutex;
+
+    public:
+        Value& at(const std::string &name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            return map.at(name);
+        }
+        bool count(const std::string &name) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return map.count(name);
+        }
+        void emplace(const std::string &name, Value &&value) {
+            std::lock_guard<std::mutex> lock(mutex);
+            map.emplace(name, std::move(value));
+        }
+        void erase(const std::string &name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            map.erase(name);
+        }
+};
+
+// Everything the commands in a .cfg file create
+struct ProgramState {
+    // Systems are indexed by names which the user enters
+    LockedMap<electrostatics::UnsolvedElectrostaticSystem> unsolvedSystems;
+    LockedMap<electrostatics::SolvedElectrostaticSystem> solvedSystems;
+    LockedMap<electrostatics::SuperpositionBasis> superpositionBases;
+    LockedMap<std::unique_ptr<electrostatics::MappedSolutionFile>> loadedSolutions;
+    LockedMap<int> fieldSpacings;   // Spacing of the points in each field file saved with one
+    LockedMap<bool> savedEquipotentials;    // Systems with their equipotentials saved
+    std::mutex loadingMutex;    // Held while copying a loaded solution into a solved system
+
+    // Variable to hold times (only used by timer commands, which never run at the same time as others)
+    struct Timer {
+        std::clock_t cpuStart;
+        std::chrono::steady_clock::time_point wallStart;
+    };
+    std::unordered_map<std::string, Timer> timers;
+
+    std::ofstream plotFile;
+};
+
+// A line of a .cfg file
+struct Command {
+    std::vector<std::string> splitLine;
+    std::string currentSystem;   // The (unsolved) system being edited when the line is reached
+};
 
 void processLine(std::string &line, std::vector<std::string> &splitLine);
+void runCommand(const Command &command, ProgramState &state, std::ostream &output);
+void findResources(const Command &command, std::vector<std::string> &reads,
+        std::vector<std::string> &writes, bool &barrier);
+void selectElectrode(electrostatics::UnsolvedElectrostaticSystem &system,
+        const std::vector<std::string> &splitLine, unsigned int numberOfArguments);
+const electrostatics::ElectrostaticSystem* findInitialGuess(std::vector<std::string> &splitLine,
+        LockedMap<electrostatics::UnsolvedElectrostaticSystem> &unsolvedSystems,
+        LockedMap<electrostatics::SolvedElectrostaticSystem> &solvedSystems,
+        std::unique_ptr<electrostatics::SolvedElectrostaticSystem> &coarseGuess);
+electrostatics::SolvedElectrostaticSystem& findSolvedSystem(std::string name, ProgramState &state);
+electrostatics::GridView<const double> findPotentials(std::string name, ProgramState &state);
+const electrostatics::MappedSolutionFile* findSinglePrecision(std::string name, ProgramState &state);
+const electrostatics::SolvedElectrostaticSystem& readSolvedSystem(std::string name, ProgramState &state,
+        std::unique_ptr<electrostatics::SolvedElectrostaticSystem> &temporary);
+template<typename Function>
+void usePotentials(std::string name, ProgramState &state, Function function);
 
-/* Parses a .cfg file
+/* Parses a .cfg file. With -j threads before the file name, commands that don't
+ * depend on each other are run at the same time on up to that many threads.
  */
 int main(int argc, char* argv[]) {
-    std::ofstream plotFile;
+    int threads = 1;
+    int fileArgument = 1;
+    if(argc > 3 && std::string(argv[1]) == "-j") {
+        threads = std::stoi(argv[2]);
+        fileArgument = 3;
+    }
+
     std::ifstream configFile;
-    configFile.open(argv[1]);
+    configFile.open(argv[fileArgument]);
     if(!configFile) {
         std::cerr << "Error opening file...\n";
         return(1);
     }
 
-    // Systems are indexed by names which the user enters
-    std::unordered_map<std::string, electrostatics::UnsolvedElectrostaticSystem> unsolvedSystems;
-    std::unordered_map<std::string, electrostatics::SolvedElectrostaticSystem> solvedSystems;
-    std::string currentSystem;   // The currently selected (unsolved) system - the one being editied
-
-    // Variable to hold times
-    std::unordered_map<std::string, std::clock_t> timers;
-
     // Variables for reading a line
     std::string line;
     std::vector<std::string> splitLine;
+    std::string currentSystem;   // The currently selected (unsolved) system - the one being editied
 
-    // Read in and process lines
+    // Read in and process every line, working out which commands each has to wait for
+    ProgramState state;
+    electrostatics::TaskGraph commands;
     while(!configFile.eof()) {
         // Read a line and process it (split at spaces, convert to lowercase etc)
         std::getline(configFile, line);
@@ -46,209 +135,512 @@ int main(int argc, char* argv[]) {
         splitLine.clear();
         processLine(line, splitLine);
 
-        // For creating a new system
-        if(splitLine[0] == "new") {
-            std::string name = splitLine[1];
-            int iMin = std::stoi(splitLine[2]);
-            int iMax = std::stoi(splitLine[3]);
-            int jMin = std::stoi(splitLine[4]);
-            int jMax = std::stoi(splitLine[5]);
-            unsolvedSystems.emplace(name, electrostatics::UnsolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            currentSystem = name;
-        }
-            
-        // For creating problem 1 analytical solution
-        else if(splitLine[0] == "analytical1") {
-            std::string name = splitLine[1];
-            int iMin = std::stoi(splitLine[2]);
-            int iMax = std::stoi(splitLine[3]);
-            int jMin = std::stoi(splitLine[4]);
-            int jMax = std::stoi(splitLine[5]);
-            solvedSystems.emplace(name, electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            for(int i=iMin; i<= iMax; i++) {
-                for(int j=jMin; j<=jMax; j++) {
-                    double potential = electrostatics::analyticalProblem1(i, j, std::stod(splitLine[6]),
-                            std::stod(splitLine[7]), std::stod(splitLine[8]), std::stod(splitLine[9]));
-                    solvedSystems.at(name).setPotentialIJ(i, j, potential);
-                }
-            }
-        }
-        // For creating problem 2 analytical solution
-        else if(splitLine[0] == "analytical2") {
-            std::string name = splitLine[1];
-            int iMin = std::stoi(splitLine[2]);
-            int iMax = std::stoi(splitLine[3]);
-            int jMin = std::stoi(splitLine[4]);
-            int jMax = std::stoi(splitLine[5]);
-            solvedSystems.emplace(name, electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            double uniformField = electrostatics::uniformField(iMin, iMax, std::stod(splitLine[6]),
-                    std::stod(splitLine[7]));
-            for(int i=iMin; i<= iMax; i++) {
-                for(int j=jMin; j<=jMax; j++) {
-                    double potential = electrostatics::analyticalProblem2(i, j, std::stod(splitLine[8]), 
-                            uniformField);
-                    solvedSystems.at(name).setPotentialIJ(i, j, potential);
-                }
-            }
-        }
+        Command command;
+        command.splitLine = splitLine;
+        command.currentSystem = currentSystem;
+        if(splitLine[0] == "new" && splitLine.size() > 1) currentSystem = splitLine[1];
 
-        // For adding boundary conditions
-        else if(splitLine[0] == "point") {
-            unsolvedSystems.at(currentSystem).setBoundaryPoint(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
-                    std::stod(splitLine[3]));
-        }
-        else if(splitLine[0] == "ring") {
-            unsolvedSystems.at(currentSystem).setBoundaryRing(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
-                    std::stod(splitLine[3]), std::stod(splitLine[4]));
-        }
-        else if(splitLine[0] == "circle") {
-            unsolvedSystems.at(currentSystem).setBoundaryCircle(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
-                    std::stod(splitLine[3]), std::stod(splitLine[4]));
-        }
-        else if(splitLine[0] == "line") {
-            unsolvedSystems.at(currentSystem).setBoundaryLine(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
-                    std::stoi(splitLine[3]), std::stoi(splitLine[4]), std::stod(splitLine[5]));
-        }
-        else if(splitLine[0] == "left") {
-            unsolvedSystems.at(currentSystem).setLeftBoundary(std::stod(splitLine[1]));
-        }
-        else if(splitLine[0] == "right") {
-            unsolvedSystems.at(currentSystem).setRightBoundary(std::stod(splitLine[1]));
-        }
-        else if(splitLine[0] == "top") {
-            unsolvedSystems.at(currentSystem).setTopBoundary(std::stod(splitLine[1]));
-        }
-        else if(splitLine[0] == "bottom") {
-            unsolvedSystems.at(currentSystem).setBottomBoundary(std::stod(splitLine[1]));
-        }
-        else if(splitLine[0] == "rectangle") {
-            unsolvedSystems.at(currentSystem).setBoundaryRectangle(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
-                    std::stoi(splitLine[3]), std::stoi(splitLine[4]), std::stod(splitLine[5]));
-        }
+        std::vector<std::string> reads, writes;
+        bool barrier;
+        findResources(command, reads, writes, barrier);
+        commands.addTask([command, &state](std::ostream &output) { runCommand(command, state, output); },
+                reads, writes, barrier);
+    }
+    configFile.close();
 
-        // For solving with different methods
-        else if(splitLine[0] == "solveviennabicon") {
-            int iMin = unsolvedSystems.at(splitLine[1]).getIMin();
-            int iMax = unsolvedSystems.at(splitLine[1]).getIMax();
-            int jMin = unsolvedSystems.at(splitLine[1]).getJMin();
-            int jMax = unsolvedSystems.at(splitLine[1]).getJMax();
-            solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            electrostatics::finiteDiffMatrix(unsolvedSystems.at(splitLine[1]),
-                    solvedSystems.at(splitLine[2]), "viennabicon");
-        }
-        else if(splitLine[0] == "solveeigenbicon") {
-            int iMin = unsolvedSystems.at(splitLine[1]).getIMin();
-            int iMax = unsolvedSystems.at(splitLine[1]).getIMax();
-            int jMin = unsolvedSystems.at(splitLine[1]).getJMin();
-            int jMax = unsolvedSystems.at(splitLine[1]).getJMax();
-            solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            electrostatics::finiteDiffMatrix(unsolvedSystems.at(splitLine[1]),
-                    solvedSystems.at(splitLine[2]), "eigenbicon");
-        }
-        else if(splitLine[0] == "solveeigensparselu") {
-            int iMin = unsolvedSystems.at(splitLine[1]).getIMin();
-            int iMax = unsolvedSystems.at(splitLine[1]).getIMax();
-            int jMin = unsolvedSystems.at(splitLine[1]).getJMin();
-            int jMax = unsolvedSystems.at(splitLine[1]).getJMax();
-            solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            electrostatics::finiteDiffMatrix(unsolvedSystems.at(splitLine[1]),
-                    solvedSystems.at(splitLine[2]), "eigensparselu");
-        }
-        else if(splitLine[0] == "solveiterative") {
-            int iMin = unsolvedSystems.at(splitLine[1]).getIMin();
-            int iMax = unsolvedSystems.at(splitLine[1]).getIMax();
-            int jMin = unsolvedSystems.at(splitLine[1]).getJMin();
-            int jMax = unsolvedSystems.at(splitLine[1]).getJMax();
-            solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
-            electrostatics::finiteDiffIterative(unsolvedSystems.at(splitLine[1]),
-                    solvedSystems.at(splitLine[2]), std::stoi(splitLine[3]));
+    commands.run(threads, std::cout);
+    if(state.plotFile) state.plotFile.close();
+}
+
+
+/* Run a single command, writing anything it prints to output.
+ */
+void runCommand(const Command &command, ProgramState &state, std::ostream &output) {
+    std::vector<std::string> splitLine = command.splitLine;
+    std::string phaseName = "command: " + splitLine[0];
+    electrostatics::ScopedPhase commandPhase(phaseName.c_str());
+
+    // Initial guess for a solve command, and space for one made from a coarse grid solution
+    std::unique_ptr<electrostatics::SolvedElectrostaticSystem> coarseGuess;
+    // A loaded solution used as an initial guess is copied into a solved system first
+    if(splitLine.size() > 2 && splitLine[splitLine.size()-2] == "guess" &&
+            state.loadedSolutions.count(splitLine.back())) {
+        findSolvedSystem(splitLine.back(), state);
+    }
+    const electrostatics::ElectrostaticSystem *initialGuess = findInitialGuess(splitLine,
+            state.unsolvedSystems, state.solvedSystems, coarseGuess);
+
+    // For creating a new system
+    if(splitLine[0] == "new") {
+        std::string name = splitLine[1];
+        int iMin = std::stoi(splitLine[2]);
+        int iMax = std::stoi(splitLine[3]);
+        int jMin = std::stoi(splitLine[4]);
+        int jMax = std::stoi(splitLine[5]);
+        state.unsolvedSystems.emplace(name, electrostatics::UnsolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+    }
+        
+    // For creating problem 1 analytical solution
+    else if(splitLine[0] == "analytical1") {
+        std::string name = splitLine[1];
+        int iMin = std::stoi(splitLine[2]);
+        int iMax = std::stoi(splitLine[3]);
+        int jMin = std::stoi(splitLine[4]);
+        int jMax = std::stoi(splitLine[5]);
+        state.solvedSystems.emplace(name, electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::analyticalProblem1Grid(state.solvedSystems.at(name).potentialView(), std::stod(splitLine[6]),
+                std::stod(splitLine[7]), std::stod(splitLine[8]), std::stod(splitLine[9]));
+    }
+    // For creating problem 2 analytical solution
+    else if(splitLine[0] == "analytical2") {
+        std::string name = splitLine[1];
+        int iMin = std::stoi(splitLine[2]);
+        int iMax = std::stoi(splitLine[3]);
+        int jMin = std::stoi(splitLine[4]);
+        int jMax = std::stoi(splitLine[5]);
+        state.solvedSystems.emplace(name, electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        double uniformField = electrostatics::uniformField(iMin, iMax, std::stod(splitLine[6]),
+                std::stod(splitLine[7]));
+        electrostatics::analyticalProblem2Grid(state.solvedSystems.at(name).potentialView(), std::stod(splitLine[8]),
+                uniformField);
+    }
+
+    // For adding boundary conditions
+    else if(splitLine[0] == "point") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 3);
+        state.unsolvedSystems.at(command.currentSystem).setBoundaryPoint(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
+                std::stod(splitLine[3]));
+    }
+    else if(splitLine[0] == "ring") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 4);
+        state.unsolvedSystems.at(command.currentSystem).setBoundaryRing(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
+                std::stod(splitLine[3]), std::stod(splitLine[4]));
+    }
+    else if(splitLine[0] == "circle") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 4);
+        state.unsolvedSystems.at(command.currentSystem).setBoundaryCircle(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
+                std::stod(splitLine[3]), std::stod(splitLine[4]));
+    }
+    else if(splitLine[0] == "line") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 5);
+        state.unsolvedSystems.at(command.currentSystem).setBoundaryLine(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
+                std::stoi(splitLine[3]), std::stoi(splitLine[4]), std::stod(splitLine[5]));
+    }
+    else if(splitLine[0] == "left") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 1);
+        state.unsolvedSystems.at(command.currentSystem).setLeftBoundary(std::stod(splitLine[1]));
+    }
+    else if(splitLine[0] == "right") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 1);
+        state.unsolvedSystems.at(command.currentSystem).setRightBoundary(std::stod(splitLine[1]));
+    }
+    else if(splitLine[0] == "top") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 1);
+        state.unsolvedSystems.at(command.currentSystem).setTopBoundary(std::stod(splitLine[1]));
+    }
+    else if(splitLine[0] == "bottom") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 1);
+        state.unsolvedSystems.at(command.currentSystem).setBottomBoundary(std::stod(splitLine[1]));
+    }
+    else if(splitLine[0] == "rectangle") {
+        selectElectrode(state.unsolvedSystems.at(command.currentSystem), splitLine, 5);
+        state.unsolvedSystems.at(command.currentSystem).setBoundaryRectangle(std::stoi(splitLine[1]), std::stoi(splitLine[2]),
+                std::stoi(splitLine[3]), std::stoi(splitLine[4]), std::stod(splitLine[5]));
+    }
+
+    // For solving with different methods
+    else if(splitLine[0] == "solveviennabicon") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "viennabicon", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigenbicon") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigenbicon", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigenbiconmatrixfree") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigenbiconmatrixfree", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigencg") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigencg", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigencgmixed") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigencgmixed", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigenbiconmixed") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigenbiconmixed", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigenldlt") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigenldlt", initialGuess);
+    }
+    else if(splitLine[0] == "solveeigensparselu") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        electrostatics::finiteDiffMatrix(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), "eigensparselu", initialGuess);
+    }
+    else if(splitLine[0] == "solveiterative") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        int sweepsPerPass = (splitLine.size() > 4) ? std::stoi(splitLine[4]) : 0;
+        electrostatics::finiteDiffIterative(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), std::stoi(splitLine[3]), initialGuess, sweepsPerPass);
+    }
+    else if(splitLine[0] == "solvesor") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        double omega = (splitLine.size() > 4) ? std::stod(splitLine[4]) : 0;
+        electrostatics::finiteDiffSOR(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), std::stod(splitLine[3]), omega, 1000000, initialGuess);
+    }
+    else if(splitLine[0] == "solvesormixed") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        double omega = (splitLine.size() > 4) ? std::stod(splitLine[4]) : 0;
+        electrostatics::finiteDiffSORMixed(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), std::stod(splitLine[3]), omega, 1000000, initialGuess);
+    }
+    else if(splitLine[0] == "solvedecomposed") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        bool pinProcesses = (splitLine.back() == "pin");
+        if(pinProcesses) splitLine.pop_back();
+        int processes = (splitLine.size() > 4) ? std::stoi(splitLine[4]) : 0;
+        double omega = (splitLine.size() > 5) ? std::stod(splitLine[5]) : 0;
+        electrostatics::finiteDiffDecomposed(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), processes, std::stod(splitLine[3]), omega, 1000000,
+                initialGuess, pinProcesses);
+    }
+    else if(splitLine[0] == "solvemultigrid") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        double tolerance = (splitLine.size() > 3) ? std::stod(splitLine[3]) : 1e-8;
+        electrostatics::finiteDiffMultigrid(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), tolerance, 100, initialGuess);
+    }
+    else if(splitLine[0] == "solvequadtree") {
+        int iMin = state.unsolvedSystems.at(splitLine[1]).getIMin();
+        int iMax = state.unsolvedSystems.at(splitLine[1]).getIMax();
+        int jMin = state.unsolvedSystems.at(splitLine[1]).getJMin();
+        int jMax = state.unsolvedSystems.at(splitLine[1]).getJMax();
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(iMin, iMax, jMin, jMax));
+        double refinementTolerance = (splitLine.size() > 3) ? std::stod(splitLine[3]) : 0;
+        int maxLevel = (splitLine.size() > 4) ? std::stoi(splitLine[4]) : 5;
+        long unknowns = electrostatics::finiteDiffQuadtree(state.unsolvedSystems.at(splitLine[1]),
+                state.solvedSystems.at(splitLine[2]), refinementTolerance, maxLevel, 10, initialGuess);
+        output << "Quadtree unknowns for " << splitLine[2] << ": " << unknowns << " of " <<
+            (long)(iMax-iMin+1)*(jMax-jMin+1) << " points\n";
+    }
+
+    // For solving each electrode separately and combining the solutions
+    else if(splitLine[0] == "solvebasis") {
+        state.superpositionBases.emplace(splitLine[2],
+                electrostatics::SuperpositionBasis(state.unsolvedSystems.at(splitLine[1])));
+    }
+    else if(splitLine[0] == "superpose") {
+        const electrostatics::SuperpositionBasis &basis = state.superpositionBases.at(splitLine[1]);
+        std::vector<double> voltages = basis.getDefaultVoltages();
+        for(unsigned int argument=3; argument+1<splitLine.size(); argument+=2) {
+            voltages.at(basis.getElectrodeNumber(splitLine[argument])) = std::stod(splitLine[argument+1]);
         }
+        state.solvedSystems.emplace(splitLine[2], electrostatics::SolvedElectrostaticSystem(basis.getIMin(),
+                    basis.getIMax(), basis.getJMin(), basis.getJMax()));
+        basis.combine(voltages, state.solvedSystems.at(splitLine[2]));
+    }
 
-        // For comparisons and outputing results
-        else if(splitLine[0] == "savesolution") {
-            solvedSystems.at(splitLine[1]).saveFile(splitLine[1]);
+    // For comparisons and outputing results
+    else if(splitLine[0] == "savesolution") {
+        bool roundTrip = (splitLine.size() > 2 && splitLine[2] == "exact");
+        // Solutions stored as floats are written straight from the floats
+        const electrostatics::MappedSolutionFile *singlePrecision = findSinglePrecision(splitLine[1], state);
+        if(singlePrecision) {
+            electrostatics::savePotentialsText(singlePrecision->singlePrecisionView(), splitLine[1], roundTrip);
         }
-        // Would be better to implement a method for this with saving directly to a file if there is time
-        else if(splitLine[0] == "savecomparison") {
-            std::string nameA = splitLine[1];
-            std::string nameB = splitLine[2];
-            int iMin = solvedSystems.at(nameA).getIMin();
-            int iMax = solvedSystems.at(nameA).getIMax();
-            int jMin = solvedSystems.at(nameA).getJMin();
-            int jMax = solvedSystems.at(nameA).getJMax();
-            electrostatics::SolvedElectrostaticSystem comparisonResult(iMin, iMax, jMin, jMax);
-            solvedSystems.at(nameA).compareTo(solvedSystems.at(nameB), comparisonResult);
-            comparisonResult.saveFile(splitLine[3]);
+        else findSolvedSystem(splitLine[1], state).saveFile(splitLine[1], roundTrip);
+    }
+    else if(splitLine[0] == "savesolutionbin") {
+        bool singlePrecision = (splitLine.size() > 2 && splitLine[2] == "float");
+        electrostatics::saveSolutionFile(findSolvedSystem(splitLine[1], state),
+                splitLine[1] + ".bin", singlePrecision);
+    }
+    else if(splitLine[0] == "loadsolution") {
+        state.loadedSolutions.erase(splitLine[1]);
+        state.loadedSolutions.emplace(splitLine[1], std::unique_ptr<electrostatics::MappedSolutionFile>(
+                    new electrostatics::MappedSolutionFile(splitLine[2])));
+        state.solvedSystems.erase(splitLine[1]);
+    }
+    // Keep only a single precision copy of a solved system, eg one that is only going to be plotted
+    else if(splitLine[0] == "storefloat") {
+        std::unique_ptr<electrostatics::MappedSolutionFile> stored(new electrostatics::MappedSolutionFile(
+                    findSolvedSystem(splitLine[1], state), true));
+        state.solvedSystems.erase(splitLine[1]);
+        state.loadedSolutions.erase(splitLine[1]);
+        state.loadedSolutions.emplace(splitLine[1], std::move(stored));
+    }
+    // Loaded solutions are compared straight from the file
+    else if(splitLine[0] == "savecomparison") {
+        usePotentials(splitLine[1], state, [&](auto potentialsA) {
+            usePotentials(splitLine[2], state, [&](auto potentialsB) {
+                electrostatics::SolvedElectrostaticSystem comparisonResult(potentialsA.getIMin(),
+                        potentialsA.getIMax(), potentialsA.getJMin(), potentialsA.getJMax());
+                comparisonResult.setDifference(potentialsA, potentialsB);
+                comparisonResult.saveFile(splitLine[3]);
+            });
+        });
+    }
+    // savefield name [spacing [iMin iMax jMin jMax]] [exact]
+    else if(splitLine[0] == "savefield") {
+        bool roundTrip = (splitLine.back() == "exact");
+        if(roundTrip) splitLine.pop_back();
+        std::unique_ptr<electrostatics::SolvedElectrostaticSystem> temporary;
+        const electrostatics::SolvedElectrostaticSystem &solvedSystem = readSolvedSystem(splitLine[1], state,
+                temporary);
+        int spacing = (splitLine.size() > 2) ? std::stoi(splitLine[2]) : 1;
+        int iStart = solvedSystem.getIMin();
+        int iEnd = solvedSystem.getIMax();
+        int jStart = solvedSystem.getJMin();
+        int jEnd = solvedSystem.getJMax();
+        if(splitLine.size() > 3 && splitLine.size() != 7) {
+            throw std::invalid_argument("Error: savefield region needs all of iMin iMax jMin jMax!");
         }
-        else if(splitLine[0] == "savefield") {
-            solvedSystems.at(splitLine[1]).saveFieldGNUPlot(splitLine[1] + "field");
+        if(splitLine.size() == 7) {
+            iStart = std::stoi(splitLine[3]);
+            iEnd = std::stoi(splitLine[4]);
+            jStart = std::stoi(splitLine[5]);
+            jEnd = std::stoi(splitLine[6]);
         }
+        solvedSystem.saveFieldGNUPlot(splitLine[1] + "field", spacing, iStart, iEnd, jStart, jEnd, roundTrip);
+        state.fieldSpacings.erase(splitLine[1]);
+        state.fieldSpacings.emplace(splitLine[1], int(spacing));
+    }
+    else if(splitLine[0] == "saveequipotentials") {
+        bool roundTrip = (splitLine.back() == "exact");
+        if(roundTrip) splitLine.pop_back();
+        std::vector<double> levels;
+        std::vector<electrostatics::Equipotential> equipotentials;
+        usePotentials(splitLine[1], state, [&](auto potentials) {
+            if(splitLine.size() > 2 && splitLine[2] == "at") {
+                for(unsigned int n=3; n<splitLine.size(); n++) levels.push_back(std::stod(splitLine[n]));
+            }
+            else {
+                levels = electrostatics::equipotentialLevels(potentials,
+                        (splitLine.size() > 2) ? std::stoi(splitLine[2]) : 10);
+            }
+            equipotentials = electrostatics::findEquipotentials(potentials, levels);
+        });
+        electrostatics::saveEquipotentials(equipotentials, splitLine[1] + "equipotentials", roundTrip);
+        if(!state.savedEquipotentials.count(splitLine[1])) state.savedEquipotentials.emplace(splitLine[1], true);
+    }
+    else if(splitLine[0] == "maxfield") {
+        std::unique_ptr<electrostatics::SolvedElectrostaticSystem> temporary;
+        output << "Maximum field of " << splitLine[1] << ": " <<
+            readSolvedSystem(splitLine[1], state, temporary).findMaxField() << std::endl;
+    }
 
-        // For timers
-        else if(splitLine[0] == "starttimer") {
-            timers.emplace(splitLine[1], std::clock());
-        }
-        else if(splitLine[0] == "stoptimer") {
-            double timeElapsed = double(clock() - timers.at(splitLine[1])) / CLOCKS_PER_SEC;
-            std::cout << "CPU time elapsed for " << splitLine[1] << ": " << timeElapsed << "s\n";
-        }
+    // Reports how often the sparse LU factorization has been reused
+    else if(splitLine[0] == "cachestats") {
+        output << "Factorization cache hits: " << electrostatics::factorizationCacheHits() <<
+            ", misses: " << electrostatics::factorizationCacheMisses() << "\n";
+    }
 
-        // Setup a new plot file
-        else if(splitLine[0] == "plotfile") {
-            plotFile.open(splitLine[1].c_str());
-            plotFile <<
-                "#!/usr/bin/gnuplot -persist\n"
-                "\n"
-                "set style line 1 lt 1 lc rgb \"red\"\n"
-                "set palette defined ( 0 '#FFFFD9', 1 '#EDF8B1', 2 '#C7E9B4', 3 '#7FCDBB',\\\n"
-                "                      4 '#41B6C4', 5 '#1D91C0', 6 '#225EA8', 7 '#0C2C84' ) \n"
-                "\n"
-                "set size ratio -1\n"
-                "set term postscript color\n"
-                "set pm3d map\n"
-                "set xlabel \"i\"\n"
-                "set ylabel \"j\"\n"
-                "set nokey\n"
-                "\n"
-                "xMin = " << splitLine[2] << "\n"
-                "xMax = " << splitLine[3] << "\n"
-                "yMin = " << splitLine[4] << "\n"
-                "yMax = " << splitLine[5] << "\n"
-                "set xrange [xMin : xMax];\n"
-                "set yrange [yMin : yMax];\n"
-                "\n";
+    // For timers
+    else if(splitLine[0] == "starttimer") {
+        state.timers[splitLine[1]] = ProgramState::Timer{std::clock(), std::chrono::steady_clock::now()};
+    }
+    else if(splitLine[0] == "stoptimer") {
+        const ProgramState::Timer &timer = state.timers.at(splitLine[1]);
+        double timeElapsed = double(clock() - timer.cpuStart) / CLOCKS_PER_SEC;
+        double wallTimeElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                timer.wallStart).count();
+        output << "CPU time elapsed for " << splitLine[1] << ": " << timeElapsed << "s, wall time: " <<
+            wallTimeElapsed << "s\n";
+    }
+    else if(splitLine[0] == "timingreport") {
+        electrostatics::printPhaseReport(output);
+        if(splitLine.size() > 1) electrostatics::savePhaseReportJSON(splitLine[1]);
+    }
+
+    // Setup a new plot file
+    else if(splitLine[0] == "plotfile") {
+        state.plotFile.open(splitLine[1].c_str());
+        state.plotFile <<
+            "#!/usr/bin/gnuplot -persist\n"
+            "\n"
+            "set style line 1 lt 1 lc rgb \"red\"\n"
+            "set palette defined ( 0 '#FFFFD9', 1 '#EDF8B1', 2 '#C7E9B4', 3 '#7FCDBB',\\\n"
+            "                      4 '#41B6C4', 5 '#1D91C0', 6 '#225EA8', 7 '#0C2C84' ) \n"
+            "\n"
+            "set size ratio -1\n"
+            "set term postscript color\n"
+            "set pm3d map\n"
+            "set xlabel \"i\"\n"
+            "set ylabel \"j\"\n"
+            "set nokey\n"
+            "\n"
+            "xMin = " << splitLine[2] << "\n"
+            "xMax = " << splitLine[3] << "\n"
+            "yMin = " << splitLine[4] << "\n"
+            "yMax = " << splitLine[5] << "\n"
+            "set xrange [xMin : xMax];\n"
+            "set yrange [yMin : yMax];\n"
+            "\n";
+    }
+    else if(splitLine[0] == "plot") {
+            state.plotFile <<
+            "set title \"" << splitLine[1] << "\"\n"
+            "set output \"" << splitLine[1] + ".eps" << "\"\n"
+            "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix\n"
+            "\n";
+    }
+    else if(splitLine[0] == "plotbinary") {
+        electrostatics::MappedSolutionFile solutionFile(splitLine[1] + ".bin");
+        state.plotFile <<
+            "set title \"" << splitLine[1] << "\"\n"
+            "set output \"" << splitLine[1] + ".eps" << "\"\n"
+            "splot \"" << splitLine[1] + ".bin" << "\" binary array=(" << solutionFile.getLengthI() <<
+            "," << solutionFile.getLengthJ() << ") skip=" << sizeof(electrostatics::SolutionFileHeader) <<
+            " format=\"" << (solutionFile.isSinglePrecision() ? "%float32" : "%float64") <<
+            "\" origin=(xMin,yMin,0) with pm3d\n"
+            "\n";
+    }
+    /* If the field was saved with a spacing, gnuplot only needs to skip points
+     * to space the arrows further apart than that.
+     */
+    else if(splitLine[0] == "fieldplot") {
+        double arrowSpacing = std::stod(splitLine[2]);
+        int savedSpacing = state.fieldSpacings.count(splitLine[1]) ? state.fieldSpacings.at(splitLine[1]) : 1;
+        std::ostringstream every;
+        if(savedSpacing == 1) every << " every " << arrowSpacing << ":" << arrowSpacing;
+        else if(arrowSpacing >= 2*savedSpacing) {
+            int skip = arrowSpacing / savedSpacing;
+            every << " every " << skip << ":" << skip;
+            arrowSpacing = skip * savedSpacing;
         }
-        else if(splitLine[0] == "plot") {
-                plotFile <<
-                "set title \"" << splitLine[1] << "\"\n"
-                "set output \"" << splitLine[1] + ".eps" << "\"\n"
-                "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix\n"
-                "\n";
+        else arrowSpacing = savedSpacing;
+        double arrowScaling = 0.85 * arrowSpacing;
+        state.plotFile <<
+            "set title \"" << splitLine[1] << "\"\n"
+            "set output \"" << splitLine[1] + "field.eps" << "\"\n"
+            "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix, \\\n"
+            "\"" << splitLine[1] + "field" << "\"" << every.str() <<
+            " using ($1):($2):(0.0):($3*" << arrowScaling << "):($4*" << arrowScaling <<
+            "):(0.0) with vectors\n"
+            "\n";
+    }
+    // Saved equipotentials are plotted as they are, instead of gnuplot finding its own
+    else if(splitLine[0] == "contourplot" && state.savedEquipotentials.count(splitLine[1])) {
+        state.plotFile <<
+            "unset contour\n"
+            "set output \"" << splitLine[1] + "contour.eps" << "\"\n"
+            "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix, \\\n"
+            "\"" << splitLine[1] + "equipotentials" << "\" using 1:2:(0.0) with lines ls 1 lw 3\n"
+            "\n";
+    }
+    else if(splitLine[0] == "contourplot") {
+        state.plotFile <<
+            "set contour base\n"
+            "set cntrparam levels auto\n"
+            "unset clabel\n"
+            "set output \"" << splitLine[1] + "contour.eps" << "\"\n"
+            "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix ls 1 lw 3\n"
+            "\n";
+    }
+
+    // Plots drawn straight to image files, without gnuplot
+    else if(splitLine[0] == "renderplot" || splitLine[0] == "renderfieldplot" ||
+            splitLine[0] == "rendercontourplot") {
+        bool ppm = (splitLine.back() == "ppm");
+        if(ppm) splitLine.pop_back();
+        // The field plot always has an arrow spacing, the contour plot can have a number of levels
+        unsigned int sizeArgument = (splitLine[0] == "renderplot") ? 2 : 3;
+        if(splitLine[0] == "rendercontourplot" && splitLine.size() % 2 == 0) sizeArgument = 2;
+        int maxWidth = 1200, maxHeight = 1200;
+        if(splitLine.size() > sizeArgument+1) {
+            maxWidth = std::stoi(splitLine[sizeArgument]);
+            maxHeight = std::stoi(splitLine[sizeArgument+1]);
         }
-        else if(splitLine[0] == "fieldplot") {
-            double arrowSpacing = std::stod(splitLine[2]);
-            double arrowScaling = 0.85 * arrowSpacing;
-            plotFile <<
-                "set title \"" << splitLine[1] << "\"\n"
-                "set output \"" << splitLine[1] + "field.eps" << "\"\n"
-                "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix, \\\n"
-                "\"" << splitLine[1] + "field" << "\" every " << arrowSpacing << ":" << arrowSpacing << 
-                " using ($1):($2):(0.0):($3*" << arrowScaling << "):($4*" << arrowScaling <<
-                "):(0.0) with vectors\n"
-                "\n";
+
+        std::string fileName = splitLine[1];
+        electrostatics::RasterImage image;
+        if(splitLine[0] == "renderfieldplot") {
+            std::unique_ptr<electrostatics::SolvedElectrostaticSystem> temporary;
+            const electrostatics::SolvedElectrostaticSystem &solvedSystem = readSolvedSystem(splitLine[1], state,
+                    temporary);
+            image = electrostatics::renderPotentials(solvedSystem.potentialView(), maxWidth, maxHeight);
+            electrostatics::drawFieldArrows(image, solvedSystem, std::stoi(splitLine[2]));
+            fileName += "field";
         }
-        else if(splitLine[0] == "contourplot") {
-            plotFile <<
-                "set contour base\n"
-                "set cntrparam levels auto\n"
-                "unset clabel\n"
-                "set output \"" << splitLine[1] + "contour.eps" << "\"\n"
-                "splot \"" << splitLine[1] << "\" using ($1+xMin):($2+yMin):3 matrix ls 1 lw 3\n"
-                "\n";
+        else {
+            usePotentials(splitLine[1], state, [&](auto potentials) {
+                image = electrostatics::renderPotentials(potentials, maxWidth, maxHeight);
+                if(splitLine[0] == "rendercontourplot") {
+                    std::vector<double> levels = electrostatics::equipotentialLevels(potentials,
+                            (sizeArgument == 3) ? std::stoi(splitLine[2]) : 10);
+                    electrostatics::drawEquipotentials(image, electrostatics::findEquipotentials(potentials, levels));
+                }
+            });
         }
+        if(splitLine[0] == "rendercontourplot") fileName += "contour";
+        if(ppm) electrostatics::savePPM(image, fileName + ".ppm");
+        else electrostatics::savePNG(image, fileName + ".png");
     }
-    configFile.close();
-    if(plotFile) plotFile.close();
 }
 
 
@@ -261,3 +653,212 @@ void processLine(std::string &line, std::vector<std::string> &splitLine) {
     std::string word;
     while(std::getline(lineStream, word, ' ')) splitLine.push_back(word);
 }
+
+
+/* If a boundary condition command has an extra argument after its numberOfArguments
+ * arguments, it is the name of the electrode the boundary condition belongs to.
+ */
+void selectElectrode(electrostatics::UnsolvedElectrostaticSystem &system,
+        const std::vector<std::string> &splitLine, unsigned int numberOfArguments) {
+    if(splitLine.size() > numberOfArguments+1) system.selectElectrode(splitLine[numberOfArguments+1]);
+    else system.deselectElectrode();
+}
+
+
+/* Solve commands can end with "guess name" to start solving from the solved system
+ * called name, or from an interpolated solution on a coarser grid if name is "coarse"
+ * (which is stored in coarseGuess). Returns the initial guess (null if there isn't
+ * one) and removes it from splitLine so it isn't mistaken for another argument.
+ */
+const electrostatics::ElectrostaticSystem* findInitialGuess(std::vector<std::string> &splitLine,
+        LockedMap<electrostatics::UnsolvedElectrostaticSystem> &unsolvedSystems,
+        LockedMap<electrostatics::SolvedElectrostaticSystem> &solvedSystems,
+        std::unique_ptr<electrostatics::SolvedElectrostaticSystem> &coarseGuess) {
+    if(splitLine.size() < 4 || splitLine[0].compare(0, 5, "solve") != 0 ||
+            splitLine[splitLine.size()-2] != "guess") return nullptr;
+    std::string name = splitLine.back();
+    splitLine.resize(splitLine.size()-2);
+    if(name != "coarse") return &solvedSystems.at(name);
+
+    const electrostatics::UnsolvedElectrostaticSystem &unsolvedSystem = unsolvedSystems.at(splitLine[1]);
+    coarseGuess.reset(new electrostatics::SolvedElectrostaticSystem(unsolvedSystem.getIMin(),
+                unsolvedSystem.getIMax(), unsolvedSystem.getJMin(), unsolvedSystem.getJMax()));
+    electrostatics::coarseGridGuess(unsolvedSystem, *coarseGuess);
+    return coarseGuess.get();
+}
+
+
+/* Loaded solutions are only copied into a solved system when one is needed. Returns
+ * the solved system called name, copying it from the loaded solution file called
+ * name if there isn't one yet.
+ */
+electrostatics::SolvedElectrostaticSystem& findSolvedSystem(std::string name, ProgramState &state) {
+    std::lock_guard<std::mutex> lock(state.loadingMutex);
+    if(state.solvedSystems.count(name) || !state.loadedSolutions.count(name)) {
+        return state.solvedSystems.at(name);
+    }
+    const electrostatics::MappedSolutionFile &solutionFile = *state.loadedSolutions.at(name);
+    state.solvedSystems.emplace(name, electrostatics::SolvedElectrostaticSystem(solutionFile.getIMin(),
+                solutionFile.getIMax(), solutionFile.getJMin(), solutionFile.getJMax()));
+    solutionFile.copyTo(state.solvedSystems.at(name));
+    return state.solvedSystems.at(name);
+}
+
+
+/* The potentials of the solved system or loaded solution called name. Loaded double
+ * precision solutions are used straight from the file.
+ */
+electrostatics::GridView<const double> findPotentials(std::string name, ProgramState &state) {
+    if(!state.solvedSystems.count(name) && state.loadedSolutions.count(name) &&
+            !state.loadedSolutions.at(name)->isSinglePrecision()) {
+        return state.loadedSolutions.at(name)->potentialView();
+    }
+    const electrostatics::SolvedElectrostaticSystem &solvedSystem = findSolvedSystem(name, state);
+    return solvedSystem.potentialView();
+}
+
+
+/* The solution stored as floats called name (see storefloat), or nullptr if name is a
+ * solved system or a double precision loaded solution.
+ */
+const electrostatics::MappedSolutionFile* findSinglePrecision(std::string name, ProgramState &state) {
+    if(state.solvedSystems.count(name) || !state.loadedSolutions.count(name) ||
+            !state.loadedSolutions.at(name)->isSinglePrecision()) {
+        return nullptr;
+    }
+    return state.loadedSolutions.at(name).get();
+}
+
+
+/* The solved system called name, for commands that only read it. A solution stored
+ * as floats is copied into temporary, which goes when the command finishes, rather
+ * than being kept as a solved system, so it stays single precision.
+ */
+const electrostatics::SolvedElectrostaticSystem& readSolvedSystem(std::string name, ProgramState &state,
+        std::unique_ptr<electrostatics::SolvedElectrostaticSystem> &temporary) {
+    const electrostatics::MappedSolutionFile *singlePrecision = findSinglePrecision(name, state);
+    if(!singlePrecision) return findSolvedSystem(name, state);
+    temporary.reset(new electrostatics::SolvedElectrostaticSystem(singlePrecision->getIMin(),
+                singlePrecision->getIMax(), singlePrecision->getJMin(), singlePrecision->getJMax()));
+    singlePrecision->copyTo(*temporary);
+    return *temporary;
+}
+
+
+/* Calls function with a view of the potentials called name (see findPotentials). A
+ * solution stored as floats is passed as a view of the floats, so plots and
+ * equipotentials are found from it without copying it to doubles.
+ */
+template<typename Function>
+void usePotentials(std::string name, ProgramState &state, Function function) {
+    const electrostatics::MappedSolutionFile *singlePrecision = findSinglePrecision(name, state);
+    if(singlePrecision) function(singlePrecision->singlePrecisionView());
+    else function(findPotentials(name, state));
+}
+
+
+/* Names of the things each command reads and writes, so commands that don't use the
+ * same things can be run at the same time (see TaskGraph). Systems are named by the
+ * type of system, and files by their file name. Commands that use the timers (or
+ * anything else shared by all the systems) are barriers, so run on their own.
+ */
+void findResources(const Command &command, std::vector<std::string> &reads,
+        std::vector<std::string> &writes, bool &barrier) {
+    std::vector<std::string> splitLine = command.splitLine;
+    auto argument = [&](unsigned int number) {
+        return (number < splitLine.size()) ? splitLine[number] : std::string();
+    };
+    barrier = false;
+
+    // Solve commands can use another solution as their initial guess
+    if(splitLine.size() > 3 && splitLine[0].compare(0, 5, "solve") == 0 &&
+            splitLine[splitLine.size()-2] == "guess") {
+        if(splitLine.back() != "coarse") reads.push_back("solved " + splitLine.back());
+        splitLine.resize(splitLine.size()-2);
+    }
+
+    const std::string &name = splitLine[0];
+    if(name == "new") {
+        writes.push_back("unsolved " + argument(1));
+    }
+    else if(name == "analytical1" || name == "analytical2") {
+        writes.push_back("solved " + argument(1));
+    }
+    else if(name == "point" || name == "ring" || name == "circle" || name == "line" ||
+            name == "left" || name == "right" || name == "top" || name == "bottom" ||
+            name == "rectangle") {
+        writes.push_back("unsolved " + command.currentSystem);
+    }
+    else if(name.compare(0, 5, "solve") == 0 && name != "solvebasis") {
+        reads.push_back("unsolved " + argument(1));
+        writes.push_back("solved " + argument(2));
+    }
+    else if(name == "solvebasis") {
+        reads.push_back("unsolved " + argument(1));
+        writes.push_back("basis " + argument(2));
+    }
+    else if(name == "superpose") {
+        reads.push_back("basis " + argument(1));
+        writes.push_back("solved " + argument(2));
+    }
+    else if(name == "savesolution") {
+        reads.push_back("solved " + argument(1));
+        writes.push_back("file " + argument(1));
+    }
+    else if(name == "savesolutionbin") {
+        reads.push_back("solved " + argument(1));
+        writes.push_back("file " + argument(1) + ".bin");
+    }
+    else if(name == "loadsolution") {
+        reads.push_back("file " + argument(2));
+        writes.push_back("solved " + argument(1));
+    }
+    else if(name == "storefloat") {
+        writes.push_back("solved " + argument(1));
+    }
+    else if(name == "savecomparison") {
+        reads.push_back("solved " + argument(1));
+        reads.push_back("solved " + argument(2));
+        writes.push_back("file " + argument(3));
+    }
+    else if(name == "savefield") {
+        reads.push_back("solved " + argument(1));
+        writes.push_back("file " + argument(1) + "field");
+    }
+    else if(name == "maxfield") {
+        reads.push_back("solved " + argument(1));
+    }
+    else if(name == "plotfile") {
+        writes.push_back("plotfile");
+        writes.push_back("file " + argument(1));
+    }
+    else if(name == "plotbinary") {
+        reads.push_back("file " + argument(1) + ".bin");
+        writes.push_back("plotfile");
+    }
+    // The spacing of the field file is needed for fieldplot
+    else if(name == "fieldplot") {
+        reads.push_back("file " + argument(1) + "field");
+        writes.push_back("plotfile");
+    }
+    else if(name == "saveequipotentials") {
+        reads.push_back("solved " + argument(1));
+        writes.push_back("file " + argument(1) + "equipotentials");
+    }
+    // Whether the equipotentials have been saved is needed for contourplot
+    else if(name == "contourplot") {
+        reads.push_back("file " + argument(1) + "equipotentials");
+        writes.push_back("plotfile");
+    }
+    else if(name == "plot") {
+        writes.push_back("plotfile");
+    }
+    else if(name == "renderplot" || name == "renderfieldplot" || name == "rendercontourplot") {
+        std::string suffix = (name == "renderfieldplot") ? "field" : (name == "rendercontourplot") ? "contour" : "";
+        reads.push_back("solved " + argument(1));
+        writes.push_back("file " + argument(1) + suffix + ((splitLine.back() == "ppm") ? ".ppm" : ".png"));
+    }
+    else if(name == "starttimer" || name == "stoptimer" || name == "cachestats" || name == "timingreport") {
+        barrier = true;
+    }
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "equipotentials.h"
+#include "GridView.h"
+#include "textExport.h"
+#include "phaseTimer.h"
+
+namespace electrostatics {
+
+/* Lines are found as the edges of the grid they cross, so they can be joined
+ * exactly. The edge from point k to point k+1 is number 2k, and the edge from
+ * point k to point k+lengthI is number 2k+1.
+ */
+typedef std::vector<long> Chain;
+typedef std::array<long, 2> Segment;
+
+/* The segments through the cells from (aStart, bStart) up to but not including
+ * (aEnd, bEnd), where cell (a, b) has the point (a, b) as its bottom left corner.
+ */
+template<typename Scalar>
+static std::vector<Segment> findSegments(GridView<const Scalar> potentials, double level,
+        int aStart, int aEnd, int bStart, int bEnd) {
+    int lengthI = potentials.getLengthI();
+    const Scalar *data = potentials.getData();
+    std::vector<Segment> segments;
+    for(int b=bStart; b<bEnd; b++) {
+        for(int a=aStart; a<aEnd; a++) {
+            long k = a + (long)b*lengthI;
+            // Anticlockwise from the bottom left, with edge n between corners n and n+1
+            double corners[4] = {data[k], data[k+1], data[k+1+lengthI], data[k+lengthI]};
+            long edges[4] = {2*k, 2*(k+1) + 1, 2*(k+lengthI), 2*k + 1};
+            long crossed[4];
+            int numberCrossed = 0;
+            for(int n=0; n<4; n++) {
+                if((corners[n] >= level) != (corners[(n+1)%4] >= level)) crossed[numberCrossed++] = edges[n];
+            }
+            if(numberCrossed == 2) segments.push_back(Segment{crossed[0], crossed[1]});
+            else if(numberCrossed == 4) {
+                // Cut off the corners that are on the other side of the level to the centre
+                bool centreAbove = (corners[0] + corners[1] + corners[2] + corners[3]) / 4 >= level;
+                if(centreAbove == (corners[0] >= level)) {
+                    segments.push_back(Segment{edges[0], edges[1]});
+                    segments.push_back(Segment{edges[2], edges[3]});
+                }
+                else {
+                    segments.push_back(Segment{edges[3], edges[0]});
+                    segments.push_back(Segment{edges[1], edges[2]});
+                }
+            }
+        }
+    }
+    return segments;
+}
+
+/* Join pieces (segments or chains) that end at the same edge into chains. No
+ * more than two pieces can end at an edge, as it is only in two cells. Lines with
+ * ends are started from an end, and the pieces left over are loops, which end at
+ * the edge they start at.
+ */
+template<typename Piece>
+static std::vector<Chain> joinPieces(const std::vector<Piece> &pieces) {
+    std::unordered_map<long, std::array<int, 2>> ends;
+    ends.reserve(2 * pieces.size());
+    for(int n=0; n<(int)pieces.size(); n++) {
+        if(pieces[n].front() == pieces[n].back()) continue;
+        for(long edge : {pieces[n].front(), pieces[n].back()}) {
+            auto found = ends.emplace(edge, std::array<int, 2>{n, -1});
+            if(!found.second) found.first->second[1] = n;
+        }
+    }
+
+    std::vector<bool> used(pieces.size(), false);
+    auto extend = [&](Chain &chain, int piece) {
+        while(chain.back() != chain.front()) {
+            const std::array<int, 2> &atEnd = ends.at(chain.back());
+            int next = (atEnd[0] == piece) ? atEnd[1] : atEnd[0];
+            if(next < 0 || used[next]) break;
+            used[next] = true;
+            if(pieces[next].front() == chain.back()) {
+                chain.insert(chain.end(), pieces[next].begin()+1, pieces[next].end());
+            }
+            else chain.insert(chain.end(), pieces[next].rbegin()+1, pieces[next].rend());
+            piece = next;
+        }
+    };
+
+    std::vector<Chain> chains;
+    for(int n=0; n<(int)pieces.size(); n++) {
+        if(pieces[n].front() == pieces[n].back()) continue;
+        bool frontFree = ends.at(pieces[n].front())[1] < 0;
+        bool backFree = ends.at(pieces[n].back())[1] < 0;
+        if(used[n] || !(frontFree || backFree)) continue;
+        used[n] = true;
+        Chain chain = frontFree ? Chain(pieces[n].begin(), pieces[n].end()) :
+            Chain(pieces[n].rbegin(), pieces[n].rend());
+        extend(chain, n);
+        chains.push_back(std::move(chain));
+    }
+    for(int n=0; n<(int)pieces.size(); n++) {
+        if(used[n]) continue;
+        used[n] = true;
+        Chain chain(pieces[n].begin(), pieces[n].end());
+        extend(chain, n);
+        chains.push_back(std::move(chain));
+    }
+    return chains;
+}
+
+template<typename Scalar>
+std::vector<double> equipotentialLevels(GridView<const Scalar> potentials, int numberOfLevels) {
+    if(numberOfLevels < 1) throw std::invalid_argument("Error: There must be at least 1 equipotential level!");
+    double minPotential = INFINITY;
+    double maxPotential = -INFINITY;
+    #pragma omp parallel for schedule(static) reduction(min:minPotential) reduction(max:maxPotential)
+    for(long k=0; k<=potentials.getKMax(); k++) {
+        minPotential = std::min(minPotential, (double)potentials.atK(k));
+        maxPotential = std::max(maxPotential, (double)potentials.atK(k));
+    }
+    std::vector<double> levels;
+    for(int n=1; n<=numberOfLevels; n++) {
+        levels.push_back(minPotential + n * (maxPotential - minPotential) / (numberOfLevels + 1));
+    }
+    return levels;
+}
+
+template std::vector<double> equipotentialLevels<double>(GridView<const double>, int);
+template std::vector<double> equipotentialLevels<float>(GridView<const float>, int);
+
+/* Every tile of every level is done at the same time, then the lines of each
+ * level are joined across the tiles, and the edges turned into positions.
+ */
+template<typename Scalar>
+std::vector<Equipotential> findEquipotentials(GridView<const Scalar> potentials, const std::vector<double> &levels,
+        int tileSize) {
+    if(tileSize < 1) throw std::invalid_argument("Error: The tile size must be at least 1!");
+    ScopedPhase contourPhase("equipotentials: find");
+    int lengthI = potentials.getLengthI();
+    int cellsI = lengthI - 1;
+    int cellsJ = potentials.getLengthJ() - 1;
+    if(cellsI < 1 || cellsJ < 1) return std::vector<Equipotential>();
+    int tilesI = (cellsI + tileSize - 1) / tileSize;
+    int tilesJ = (cellsJ + tileSize - 1) / tileSize;
+    int numberOfLevels = levels.size();
+    long tilesPerLevel = (long)tilesI * tilesJ;
+
+    std::vector<std::vector<Chain>> tileChains(numberOfLevels * tilesPerLevel);
+    #pragma omp parallel for schedule(dynamic)
+    for(long tile=0; tile<numberOfLevels*tilesPerLevel; tile++) {
+        int level = tile / tilesPerLevel;
+        int tileI = (tile % tilesPerLevel) % tilesI;
+        int tileJ = (tile % tilesPerLevel) / tilesI;
+        int aStart = tileI * tileSize;
+        int bStart = tileJ * tileSize;
+        tileChains[tile] = joinPieces(findSegments(potentials, levels[level], aStart,
+                    std::min(aStart + tileSize, cellsI), bStart, std::min(bStart + tileSize, cellsJ)));
+    }
+
+    std::vector<std::vector<Equipotential>> levelLines(numberOfLevels);
+    const Scalar *data = potentials.getData();
+    #pragma omp parallel for schedule(dynamic)
+    for(int level=0; level<numberOfLevels; level++) {
+        std::vector<Chain> pieces;
+        for(long tile=level*tilesPerLevel; tile<(level+1)*tilesPerLevel; tile++) {
+            for(Chain &chain : tileChains[tile]) pieces.push_back(std::move(chain));
+        }
+        for(const Chain &chain : joinPieces(pieces)) {
+            Equipotential line;
+            line.potential = levels[level];
+            line.closed = (chain.size() > 2 && chain.front() == chain.back());
+            line.points.reserve(chain.size());
+            for(long edge : chain) {
+                long k = edge / 2;
+                bool vertical = edge % 2;
+                long other = vertical ? k + lengthI : k + 1;
+                double fraction = (levels[level] - data[k]) / ((double)data[other] - data[k]);
+                int a = k % lengthI;
+                int b = k / lengthI;
+                line.points.push_back(vertical ?
+                        ContourPoint{(double)potentials.getIMin() + a, potentials.getJMin() + b + fraction} :
+                        ContourPoint{potentials.getIMin() + a + fraction, (double)potentials.getJMin() + b});
+            }
+            levelLines[level].push_back(std::move(line));
+        }
+    }
+
+    std::vector<Equipotential> equipotentials;
+    for(std::vector<Equipotential> &lines : levelLines) {
+        for(Equipotential &line : lines) equipotentials.push_back(std::move(line));
+    }
+    return equipotentials;
+}
+
+template std::vector<Equipotential> findEquipotentials<double>(GridView<const double>, const std::vector<double> &,
+        int);
+template std::vector<Equipotential> findEquipotentials<float>(GridView<const float>, const std::vector<double> &,
+        int);
+
+/* Each line has a row for its comment and a row for each point. */
+void saveEquipotentials(const std::vector<Equipotential> &equipotentials, std::string fileName, bool roundTrip) {
+    ScopedPhase exportPhase("export: text");
+    std::vector<long> firstRows(equipotentials.size() + 1, 0);
+    for(size_t n=0; n<equipotentials.size(); n++) {
+        firstRows[n+1] = firstRows[n] + 1 + equipotentials[n].points.size();
+    }
+    long maxRowCharacters = 2*maxDoubleCharacters + 32;
+    writeTextRows(fileName, firstRows.back(), maxRowCharacters, [&](long row, char *out) {
+        long line = std::upper_bound(firstRows.begin(), firstRows.end(), row) - firstRows.begin() - 1;
+        const Equipotential &equipotential = equipotentials[line];
+        if(row == firstRows[line]) {
+            std::string comment = std::string(line ? "\n" : "") + "# potential ";
+            out = std::copy(comment.begin(), comment.end(), out);
+            out = formatDouble(out, equipotential.potential, roundTrip);
+            std::string ending = equipotential.closed ? " closed\n" : " open\n";
+            return std::copy(ending.begin(), ending.end(), out);
+        }
+        const ContourPoint &point = equipotential.points[row - firstRows[line] - 1];
+        out = formatDouble(out, point.i, roundTrip);
+        *out++ = ' ';
+        out = formatDouble(out, point.j, roundTrip);
+        *out++ = '\n';
+        return out;
+    });
+}
+
+} // namespace electrostatics
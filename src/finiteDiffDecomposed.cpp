@@ -0,0 +1,253 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "finiteDiffDecomposed.h"
+#include "finiteDiffIterative.h"
+#include "ElectrostaticSystem.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* A barrier for the processes, in the shared mapping. Unlike a pthread barrier it
+ * can be aborted, so that the processes don't wait forever for one that has died.
+ * The atomics are lock free, so they work between processes.
+ */
+struct SharedBarrier {
+    std::atomic<int> waiting;
+    std::atomic<int> generation;
+    std::atomic<bool> aborted;
+};
+
+/* Everything a worker process needs. The pointers to unshared memory (the
+ * interior spans, starting potentials and workers) are still valid in the forked
+ * processes, which get a copy of the parent's memory.
+ */
+struct DecomposedSetup {
+    int lengthI, lengthJ;
+    int processes;
+    double tolerance, omega;
+    int maxIterations;
+    bool pinProcesses;
+    const RowSpans *interior;
+    const double *startingPotentials;
+
+    // Only used by process 0, which watches the workers while it waits
+    std::vector<pid_t> *workers;
+    std::vector<int> *workerStatuses;
+
+    // In the shared mapping
+    SharedBarrier *barrier;
+    double *maxChanges;     // One per process, a cache line apart
+    double *potentials;
+};
+
+static const int cacheLineDoubles = 8;
+
+/* Checks (without waiting) whether any worker has exited, storing the status of
+ * the ones that have and setting their pid to 0.
+ */
+static bool workerExited(std::vector<pid_t> &workers, std::vector<int> &workerStatuses) {
+    bool exited = false;
+    for(size_t n=0; n<workers.size(); n++) {
+        if(workers[n] > 0 && waitpid(workers[n], &workerStatuses[n], WNOHANG) == workers[n]) {
+            workers[n] = 0;
+            exited = true;
+        }
+    }
+    return exited;
+}
+
+/* Waits until every process has reached the barrier, spinning for a while first
+ * (as the processes normally arrive close together), then yielding to other
+ * processes and then sleeping between checks. Returns false if the barrier was aborted instead. Process 0 aborts it
+ * if a worker exits while it is waiting, and the workers give up if process 0
+ * has gone.
+ */
+static bool barrierWait(const DecomposedSetup &setup, int process) {
+    SharedBarrier &barrier = *setup.barrier;
+    int generation = barrier.generation.load(std::memory_order_acquire);
+    if(barrier.waiting.fetch_add(1, std::memory_order_acq_rel) == setup.processes-1) {
+        barrier.waiting.store(0, std::memory_order_relaxed);
+        barrier.generation.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    pid_t parent = getppid();
+    for(long checks=0; barrier.generation.load(std::memory_order_acquire) == generation; checks++) {
+        if(barrier.aborted.load(std::memory_order_relaxed)) return false;
+        if(checks < 100) continue;
+        if(checks % 100 == 0) {
+            if(process == 0) {
+                // A worker that exits normally has already passed this barrier
+                if(workerExited(*setup.workers, *setup.workerStatuses) &&
+                        barrier.generation.load(std::memory_order_acquire) == generation) {
+                    barrier.aborted.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            else if(getppid() != parent) return false;
+        }
+        if(checks < 10000) sched_yield();
+        else {
+            timespec pause = {0, 50000};
+            nanosleep(&pause, nullptr);
+        }
+    }
+    return true;
+}
+
+/* Pin the calling process to the nth CPU it is allowed to run on. */
+static void pinToCPU(int n) {
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    int count = CPU_COUNT(&allowed);
+    if(count == 0) return;
+    n %= count;
+    for(int cpu=0; cpu<CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &allowed) && n-- == 0) {
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            sched_setaffinity(0, sizeof(pinned), &pinned);
+            return;
+        }
+    }
+}
+
+/* The part of the solve done by one process, on rows bStart to bEnd-1. This runs
+ * in forked processes of a possibly multi-threaded program, so it mustn't
+ * allocate memory or take locks. Returns -1 if the barrier was aborted.
+ */
+static int decomposedWorker(const DecomposedSetup &setup, int process) {
+    int lengthI = setup.lengthI;
+    int lengthJ = setup.lengthJ;
+    int bStart = (long)lengthJ * process / setup.processes;
+    int bEnd = (long)lengthJ * (process+1) / setup.processes;
+    const RowSpans &interior = *setup.interior;
+    double *potentials = setup.potentials;
+    if(setup.pinProcesses) pinToCPU(process);
+
+    // First touch of the rows this process owns, so they are stored close to it
+    std::copy(setup.startingPotentials + (long)bStart*lengthI, setup.startingPotentials + (long)bEnd*lengthI,
+            potentials + (long)bStart*lengthI);
+    if(!barrierWait(setup, process)) return -1;
+
+    int iter = 0;
+    double maxChange = setup.tolerance + 1;
+    while(maxChange >= setup.tolerance && iter < setup.maxIterations) {
+        double localMaxChange = 0;
+        for(int colour=0; colour<2; colour++) {
+            localMaxChange = std::max(localMaxChange, sorSweep<double>(potentials, lengthI, lengthJ, interior,
+                        nullptr, setup.omega, colour, bStart, bEnd));
+            // The halo rows of the other colour are up to date after this
+            if(!barrierWait(setup, process)) return -1;
+        }
+
+        /* Every process finds the same largest change, so they all stop together.
+         * A process can't write its next change until every process has passed
+         * both colour barriers of the next iteration, so after they have all read
+         * this one.
+         */
+        setup.maxChanges[process*cacheLineDoubles] = localMaxChange;
+        if(!barrierWait(setup, process)) return -1;
+        maxChange = 0;
+        for(int other=0; other<setup.processes; other++) {
+            maxChange = std::max(maxChange, setup.maxChanges[other*cacheLineDoubles]);
+        }
+        iter++;
+    }
+    return iter;
+}
+
+int finiteDiffDecomposed(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, int processes, double tolerance, double omega,
+        int maxIterations, const ElectrostaticSystem *initialGuess, bool pinProcesses) {
+
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+
+    if(omega <= 0 || omega >= 2) omega = optimalOmega(lengthI, lengthJ);
+    if(processes <= 0) processes = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    processes = std::min(processes, lengthJ);
+
+    doubleGrid startingPotentials = unsolvedSystem.startingPotentials(initialGuess);
+    RowSpans interior = unsolvedSystem.interiorSpans();
+
+    // Barrier, then the largest changes, then the potentials, each starting on a new cache line
+    long barrierBytes = (sizeof(SharedBarrier) + 63) / 64 * 64;
+    long changesBytes = (long)processes * cacheLineDoubles * sizeof(double);
+    long potentialsBytes = (long)lengthI * lengthJ * sizeof(double);
+    long mappingBytes = barrierBytes + changesBytes + potentialsBytes;
+    void *mapping = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED) throw std::runtime_error("Error: Could not make shared memory for the subdomains!");
+
+    std::vector<pid_t> workers;
+    std::vector<int> workerStatuses(processes-1, 0);
+    DecomposedSetup setup;
+    setup.lengthI = lengthI;
+    setup.lengthJ = lengthJ;
+    setup.processes = processes;
+    setup.tolerance = tolerance;
+    setup.omega = omega;
+    setup.maxIterations = maxIterations;
+    setup.pinProcesses = pinProcesses;
+    setup.interior = &interior;
+    setup.startingPotentials = startingPotentials.data();
+    setup.workers = &workers;
+    setup.workerStatuses = &workerStatuses;
+    setup.barrier = new(mapping) SharedBarrier();
+    setup.maxChanges = (double*)((char*)mapping + barrierBytes);
+    setup.potentials = (double*)((char*)mapping + barrierBytes + changesBytes);
+
+    // This process is process 0 - its affinity is put back afterwards
+    cpu_set_t originalAffinity;
+    bool restoreAffinity = pinProcesses && sched_getaffinity(0, sizeof(originalAffinity), &originalAffinity) == 0;
+
+    for(int process=1; process<processes; process++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            _exit(decomposedWorker(setup, process) < 0 ? 1 : 0);
+        }
+        if(pid < 0) break;
+        workers.push_back(pid);
+    }
+
+    // If a process couldn't be started the others would wait at the barrier forever
+    int iterations = -1;
+    if((int)workers.size() == processes-1) iterations = decomposedWorker(setup, 0);
+
+    bool failed = (iterations < 0);
+    for(size_t n=0; n<workers.size(); n++) {
+        if(workers[n] <= 0) continue;
+        if(failed) kill(workers[n], SIGKILL);
+        if(waitpid(workers[n], &workerStatuses[n], 0) != workers[n]) failed = true;
+    }
+    for(int status : workerStatuses) {
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = true;
+    }
+    if(restoreAffinity) sched_setaffinity(0, sizeof(originalAffinity), &originalAffinity);
+
+    if(!failed) {
+        std::copy(setup.potentials, setup.potentials + (long)lengthI*lengthJ, startingPotentials.data());
+    }
+    munmap(mapping, mappingBytes);
+    if((int)workers.size() < processes-1) throw std::runtime_error("Error: Could not start a process for a subdomain!");
+    if(failed) throw std::runtime_error("Error: A subdomain process failed!");
+
+    // Copy the result into the solved system
+    solvedSystem.setPotentials(startingPotentials);
+    return iterations;
+}
+
+} // namespace electrostatics
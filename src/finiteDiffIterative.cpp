@@ -1,7 +1,11 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 #include "finiteDiffIterative.h"
+#include "phaseTimer.h"
+#include "stencilEngine.h"
 #include "SolvedElectrostaticSystem.h"
 #include "UnsolvedElectrostaticSystem.h"
 
@@ -9,95 +13,222 @@ namespace electrostatics {
 
 /* Iterative finite difference method.
  *
- * Copies back and forth from solvedSystemA to solvedSystemB for each iteration.
+ * Copies back and forth from gridA to gridB for each iteration, using a
+ * StencilEngine to update the points that aren't boundary conditions.
  */
 void finiteDiffIterative(const UnsolvedElectrostaticSystem &unsolvedSystem,
-        SolvedElectrostaticSystem &solvedSystemA, int maxIterations) {
+        SolvedElectrostaticSystem &solvedSystem, int maxIterations,
+        const ElectrostaticSystem *initialGuess, int sweepsPerPass) {
 
-    int iMin = unsolvedSystem.getIMin();
-    int iMax = unsolvedSystem.getIMax();
-    int jMin = unsolvedSystem.getJMin();
-    int jMax = unsolvedSystem.getJMax();
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+    ScopedPhase setupPhase("iterative: setup");
+    StencilEngine engine(unsolvedSystem);
 
-    electrostatics::SolvedElectrostaticSystem solvedSystemB(iMin, iMax, jMin, jMax);
+    // Copy boundary conditions (and the initial guess) over to gridA and gridB
+    doubleGrid potentials = unsolvedSystem.startingPotentials(initialGuess);
+    PaddedGrid gridA(lengthI, lengthJ);
+    PaddedGrid gridB(lengthI, lengthJ);
+    gridA.load(potentials);
+    gridB.load(potentials);
 
-    // Copy boundary conditions over to solvedSystemA and solvedSystemB
-    for(int i=iMin; i<=iMax; i++) {
-        for(int j=jMin; j<=jMax; j++) {
-            solvedSystemA.setPotentialIJ(i, j, unsolvedSystem.getPotentialIJ(i, j));
-            solvedSystemB.setPotentialIJ(i, j, unsolvedSystem.getPotentialIJ(i, j));
-        }
-    }
+    setupPhase.stop();
 
-    // Loop for the required number of iterations
-    for(int iter=1; iter<=maxIterations; iter++) {
-        // Loop over all the points in the system
-        for(int i=iMin; i<=iMax; i++) {
-            for(int j=jMin; j<=jMax; j++) {
+    // On odd iterations go from A to B, and on even iterations from B to A
+    ScopedPhase solvePhase("iterative: solve");
+    engine.jacobiIterations(gridA, gridB, maxIterations, sweepsPerPass);
+    solvePhase.stop();
 
-                // If the point is a boundary condition, leave it alone
-                if(unsolvedSystem.isBoundaryConditionIJ(i, j)) {
-                    continue;
-                }
+    // If doing an odd number of iterations, result ends up in B
+    ScopedPhase copyPhase("iterative: copy back");
+    if(maxIterations%2 == 1) gridB.store(potentials);
+    else gridA.store(potentials);
+    solvedSystem.setPotentials(potentials);
+}
 
-                int surroundingPoints = 0;  // Number of points surrounding (i, j)
-                double sum = 0;             // Sum of potentials around (i, j)
-
-                // If on an odd iteration, go from A to B
-                if(iter%2 == 1) {
-                    if(i<iMax) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemA.getPotentialIJ(i+1, j);
-                    }
-                    if(i>iMin) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemA.getPotentialIJ(i-1, j);
-                    }
-                    if(j<jMax) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemA.getPotentialIJ(i, j+1);
-                    }
-                    if(j>jMin) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemA.getPotentialIJ(i, j-1);
-                    }
-                    solvedSystemB.setPotentialIJ(i, j, sum/surroundingPoints);
-                }
 
-                // Otherwise for even iteration, go from B to A
-                else {
-                    if(i<iMax) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemB.getPotentialIJ(i+1, j);
-                    }
-                    if(i>iMin) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemB.getPotentialIJ(i-1, j);
-                    }
-                    if(j<jMax) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemB.getPotentialIJ(i, j+1);
-                    }
-                    if(j>jMin) {
-                        surroundingPoints += 1;
-                        sum += solvedSystemB.getPotentialIJ(i, j-1);
-                    }
-                    solvedSystemA.setPotentialIJ(i, j, sum/surroundingPoints);
+/* Red-black successive over-relaxation.
+ *
+ * Points with (i+j) even (red) are updated first, then points with (i+j) odd
+ * (black). Each point only has neighbours of the other colour, so all points of
+ * one colour can be updated at once (and in any order), in place.
+ *
+ * The optimal omega is found from the spectral radius of the Jacobi method for
+ * a rectangle with fixed edges:
+ * rho = (cos(pi/lengthI) + cos(pi/lengthJ)) / 2
+ * omega = 2 / (1 + sqrt(1 - rho^2))
+ */
+double optimalOmega(int lengthI, int lengthJ) {
+    double rho = (cos(M_PI/lengthI) + cos(M_PI/lengthJ)) / 2;
+    return 2 / (1 + sqrt(1 - rho*rho));
+}
+
+/* Points are found by their position k = a + b*lengthI in potentials, so the
+ * sweep works on an Eigen matrix or a grid in shared memory alike.
+ */
+template<typename Scalar>
+Scalar sorSweep(Scalar *potentials, int lengthI, int lengthJ, const RowSpans &interior,
+        const Scalar *sources, Scalar omega, int colour, int bStart, int bEnd) {
+    Scalar maxChange = 0;
+    for(int b=bStart; b<bEnd; b++) {
+        for(long span=interior.rowStarts[b]; span<interior.rowStarts[b+1]; span++) {
+            int start = interior.spans[span].start;
+            for(int a=start+(start+b+colour)%2; a<interior.spans[span].end; a+=2) {
+                long k = a + (long)b*lengthI;
+                int surroundingPoints = 0;
+                Scalar sum = 0;
+                if(a<lengthI-1) {
+                    surroundingPoints += 1;
+                    sum += potentials[k+1];
                 }
-            }   
+                if(a>0) {
+                    surroundingPoints += 1;
+                    sum += potentials[k-1];
+                }
+                if(b<lengthJ-1) {
+                    surroundingPoints += 1;
+                    sum += potentials[k+lengthI];
+                }
+                if(b>0) {
+                    surroundingPoints += 1;
+                    sum += potentials[k-lengthI];
+                }
+                if(sources) sum += sources[k];
+                Scalar change = omega * (sum/surroundingPoints - potentials[k]);
+                potentials[k] += change;
+                maxChange = std::max(maxChange, std::abs(change));
+            }
         }
     }
+    return maxChange;
+}
 
-    // If doing an odd number of iterations, result ends up in B, so copy it into A
-    if(maxIterations%2 == 1) {
-        for(int i=iMin; i<=iMax; i++) {
-            for(int j=jMin; j<=jMax; j++) {
-                solvedSystemA.setPotentialIJ(i, j, solvedSystemB.getPotentialIJ(i, j));
+template double sorSweep<double>(double*, int, int, const RowSpans&, const double*, double, int, int, int);
+template float sorSweep<float>(float*, int, int, const RowSpans&, const float*, float, int, int, int);
+
+/* Red-black SOR iterations on potentials, in the precision of Scalar, until the
+ * largest change is less than tolerance or maxIterations have been done. The
+ * rows of each colour are split between threads. If sources is given, each point
+ * solves
+ * (surroundingPoints * potential) - (sum of the neighbours) = source
+ * instead of Laplace's equation. Returns the number of iterations done.
+ */
+template<typename Scalar>
+static int sorIterations(Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &potentials,
+        const RowSpans &interior, const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *sources,
+        Scalar omega, Scalar tolerance, int maxIterations) {
+    int lengthI = potentials.rows();
+    int lengthJ = potentials.cols();
+    const Scalar *sourceData = sources ? sources->data() : nullptr;
+    int iter = 0;
+    Scalar maxChange = tolerance + 1;
+    while(maxChange >= tolerance && iter < maxIterations) {
+        maxChange = 0;
+        for(int colour=0; colour<2; colour++) {
+            #pragma omp parallel for reduction(max:maxChange) schedule(static)
+            for(int b=0; b<lengthJ; b++) {
+                maxChange = std::max(maxChange, sorSweep<Scalar>(potentials.data(), lengthI, lengthJ, interior,
+                            sourceData, omega, colour, b, b+1));
             }
         }
+        iter++;
     }
+    return iter;
+}
+
+int finiteDiffSOR(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double tolerance, double omega, int maxIterations,
+        const ElectrostaticSystem *initialGuess) {
+
+    if(omega <= 0 || omega >= 2) omega = optimalOmega(unsolvedSystem.getLengthI(), unsolvedSystem.getLengthJ());
+
+    // Work on a local copy of the potentials
+    ScopedPhase setupPhase("sor: setup");
+    doubleGrid potentials = unsolvedSystem.startingPotentials(initialGuess);
+    RowSpans interior = unsolvedSystem.interiorSpans();
+
+    setupPhase.stop();
+
+    ScopedPhase solvePhase("sor: solve");
+    int iter = sorIterations<double>(potentials, interior, nullptr, omega, tolerance, maxIterations);
+    solvePhase.stop();
+
+    // Copy the result into the solved system
+    ScopedPhase copyPhase("sor: copy back");
+    solvedSystem.setPotentials(potentials);
+    return iter;
 }
 
 
+/* Mixed precision SOR with iterative refinement.
+ *
+ * The system is first solved in single precision. Then, until the correction
+ * is smaller than tolerance, the residual of the (double precision) solution is
+ * found:
+ * residual = (sum of the neighbours) - (surroundingPoints * potential)
+ * and the equations for the correction to the solution,
+ * (surroundingPoints * correction) - (sum of the neighbours' corrections) = residual
+ * with zero at the boundary conditions, are solved in single precision.
+ *
+ * Single precision only resolves changes of about 1e-7 of the largest value, so
+ * each solve only reduces the changes to 1e-4 of the size of the solution (or
+ * of the last correction), or to tolerance if that is larger.
+ */
+int finiteDiffSORMixed(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double tolerance, double omega, int maxIterations,
+        const ElectrostaticSystem *initialGuess) {
+
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+    const double refinementReduction = 1e-4;
+
+    if(omega <= 0 || omega >= 2) omega = optimalOmega(lengthI, lengthJ);
+
+    ScopedPhase setupPhase("sor: setup");
+    doubleGrid potentials = unsolvedSystem.startingPotentials(initialGuess);
+    const boolGrid &boundaryConditions = unsolvedSystem.getBoundaryConditionPositions();
+    RowSpans interior = unsolvedSystem.interiorSpans();
+    Eigen::MatrixXf singlePotentials = potentials.cast<float>();
+    Eigen::MatrixXf residuals(lengthI, lengthJ);
+    double scale = potentials.cwiseAbs().maxCoeff();
+    setupPhase.stop();
+
+    ScopedPhase solvePhase("sor: solve");
+    int iter = sorIterations<float>(singlePotentials, interior, nullptr, omega,
+            std::max(tolerance, refinementReduction*scale), maxIterations);
+    for(int b=0; b<lengthJ; b++) {
+        for(int a=0; a<lengthI; a++) {
+            if(!boundaryConditions(a, b)) potentials(a, b) = singlePotentials(a, b);
+        }
+    }
+
+    while(scale >= tolerance && iter < maxIterations) {
+        #pragma omp parallel for schedule(static)
+        for(int b=0; b<lengthJ; b++) {
+            for(int a=0; a<lengthI; a++) {
+                double residual = 0;
+                if(!boundaryConditions(a, b)) {
+                    if(a<lengthI-1) residual += potentials(a+1, b) - potentials(a, b);
+                    if(a>0) residual += potentials(a-1, b) - potentials(a, b);
+                    if(b<lengthJ-1) residual += potentials(a, b+1) - potentials(a, b);
+                    if(b>0) residual += potentials(a, b-1) - potentials(a, b);
+                }
+                residuals(a, b) = residual;
+            }
+        }
+
+        Eigen::MatrixXf &corrections = singlePotentials;
+        corrections.setZero();
+        iter += sorIterations<float>(corrections, interior, &residuals, omega,
+                std::max(tolerance, refinementReduction*scale), maxIterations-iter);
+        potentials += corrections.cast<double>();
+        scale = corrections.cwiseAbs().maxCoeff();
+    }
+    solvePhase.stop();
+
+    ScopedPhase copyPhase("sor: copy back");
+    solvedSystem.setPotentials(potentials);
+    return iter;
+}
 
 } // namespace electrostatics
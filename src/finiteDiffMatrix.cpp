@@ -6,13 +6,326 @@
 #include <viennacl/vector.hpp>
 #include <viennacl/matrix.hpp>
 #include <viennacl/compressed_matrix.hpp>
+#include <stdexcept>
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
 #include "finiteDiffMatrix.h"
+#include "phaseTimer.h"
+#include "stencilOperator.h"
+#include "GridView.h"
 #include "SolvedElectrostaticSystem.h"
 #include "UnsolvedElectrostaticSystem.h"
 
 namespace electrostatics {
 
+/* Cache of the most recent SparseLU factorization.
+ *
+ * A only depends on the size of the grid and the positions of the boundary
+ * conditions, so a system with the same extents and boundary condition
+ * positions (but any boundary potentials) can reuse the factorization.
+ */
+struct SparseLUCache {
+    bool valid;
+    int iMin, iMax, jMin, jMax;
+    boolGrid boundaryConditionPositions;
+    std::unique_ptr<Eigen::SparseLU<Eigen::SparseMatrix<double, Eigen::ColMajor> > > solver;
+    long hits, misses;
+
+    SparseLUCache() : valid(false), hits(0), misses(0) {}
+
+    bool matches(const UnsolvedElectrostaticSystem &unsolvedSystem) const {
+        return valid && iMin == unsolvedSystem.getIMin() && iMax == unsolvedSystem.getIMax() &&
+            jMin == unsolvedSystem.getJMin() && jMax == unsolvedSystem.getJMax() &&
+            boundaryConditionPositions == unsolvedSystem.getBoundaryConditionPositions();
+    }
+};
+static SparseLUCache sparseLUCache;
+static std::mutex sparseLUCacheMutex;  // Held by sparse LU solves, which may be on different threads
+
+long factorizationCacheHits() {
+    std::lock_guard<std::mutex> lock(sparseLUCacheMutex);
+    return sparseLUCache.hits;
+}
+long factorizationCacheMisses() {
+    std::lock_guard<std::mutex> lock(sparseLUCacheMutex);
+    return sparseLUCache.misses;
+}
+
+void clearFactorizationCache() {
+    std::lock_guard<std::mutex> lock(sparseLUCacheMutex);
+    sparseLUCache.valid = false;
+    sparseLUCache.boundaryConditionPositions.resize(0, 0);
+    sparseLUCache.solver.reset();
+}
+
+/* Solves the same system of equations as finiteDiffMatrix without forming A,
+ * by using a StencilOperator with eigen's BiCGSTAB method. Starts from guess
+ * unless it is empty.
+ */
+static int finiteDiffMatrixFree(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, const Eigen::VectorXd &guess) {
+
+    // Boundary values vector
+    Eigen::VectorXd b = unsolvedSystem.startingPotentials(nullptr).reshaped();
+
+    ScopedPhase solvePhase("matrix: solve");
+    StencilOperator A(unsolvedSystem);
+    Eigen::BiCGSTAB<StencilOperator, StencilDiagonalPreconditioner> solver;
+    solver.compute(A);
+    Eigen::VectorXd solution;
+    if(guess.size() > 0) solution = solver.solveWithGuess(b, guess);
+    else solution = solver.solve(b);
+    solvePhase.stop();
+
+    // Set the potentials in the solved system to the ones just calculated
+    ScopedPhase copyPhase("matrix: copy back");
+    solvedSystem.setPotentials(solution.reshaped(unsolvedSystem.getLengthI(), unsolvedSystem.getLengthJ()));
+    return solver.iterations();
+}
+
+/* Fills the compressed arrays of A from the number of entries of each row (or
+ * column), countEntries(outer), and fillEntries(outer, innerIndices, values),
+ * which writes them in order and returns how many it wrote. A is never built
+ * up by inserting coefficients: the start of each row is found from the counts
+ * first, then the rows are filled straight into A's own arrays, in parallel
+ * over blocks of rows (when compiled with openmp), as each only writes its own
+ * part of the arrays.
+ */
+template<int Options, typename CountEntries, typename FillEntries>
+static void fillCompressed(Eigen::SparseMatrix<double, Options> &A, long size, CountEntries countEntries,
+        FillEntries fillEntries) {
+    A.resize(size, size);
+    int *outerIndex = A.outerIndexPtr();
+    outerIndex[0] = 0;
+    #pragma omp parallel for schedule(static)
+    for(long outer=0; outer<size; outer++) outerIndex[outer+1] = countEntries(outer);
+    for(long outer=0; outer<size; outer++) outerIndex[outer+1] += outerIndex[outer];
+
+    A.resizeNonZeros(outerIndex[size]);
+    int *innerIndex = A.innerIndexPtr();
+    double *values = A.valuePtr();
+    #pragma omp parallel for schedule(static)
+    for(long outer=0; outer<size; outer++) {
+        fillEntries(outer, innerIndex + outerIndex[outer], values + outerIndex[outer]);
+    }
+}
+
+/* The entries of A for the full system of equations (see finiteDiffMatrix). Row k
+ * of A is 1 at k for a boundary condition, otherwise -surroundingPoints at k and
+ * 1 at each of the surrounding points. Column k has the diagonal and 1 for each
+ * surrounding point that isn't a boundary condition. Either way the entries are
+ * in order of k: below, left, the point itself, right, above.
+ */
+template<int Options>
+static void assembleFullSystem(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        Eigen::SparseMatrix<double, Options> &A, Eigen::VectorXd &b, bool fillA) {
+
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+    long size = unsolvedSystem.getKMax() + 1;
+    const bool *boundaryConditions = unsolvedSystem.getBoundaryConditionPositions().data();
+    const double *potentials = unsolvedSystem.getPotentials().data();
+    const bool columnMajor = !(Options & Eigen::RowMajor);
+
+    b.resize(size);
+    #pragma omp parallel for schedule(static)
+    for(long k=0; k<size; k++) b(k) = boundaryConditions[k] ? potentials[k] : 0;
+    if(!fillA) return;
+
+    // Calls entry(inner, value) for each entry of row or column k, in order
+    auto forEachEntry = [=](long k, auto entry) {
+        long i = k % lengthI;   // Counting from 0
+        long j = k / lengthI;
+        long neighbours[4] = {k-lengthI, k-1, k+1, k+lengthI};
+        bool onGrid[4] = {j>0, i>0, i<lengthI-1, j<lengthJ-1};
+        int surroundingPoints = onGrid[0] + onGrid[1] + onGrid[2] + onGrid[3];
+        for(int neighbour=0; neighbour<4; neighbour++) {
+            if(neighbour == 2) entry(k, boundaryConditions[k] ? 1.0 : -surroundingPoints);
+            if(!onGrid[neighbour]) continue;
+            // A row only has neighbours if it isn't a boundary condition, a column only those that aren't
+            if(!boundaryConditions[columnMajor ? neighbours[neighbour] : k]) entry(neighbours[neighbour], 1.0);
+        }
+    };
+
+    fillCompressed(A, size,
+        [&](long k) {
+            int entries = 0;
+            forEachEntry(k, [&](long, double) { entries++; });
+            return entries;
+        },
+        [&](long k, int *innerIndex, double *values) {
+            forEachEntry(k, [&](long inner, double value) {
+                *innerIndex++ = inner;
+                *values++ = value;
+            });
+        });
+}
+
+/* Forms the reduced system of equations, numbering only the points that are not
+ * boundary conditions (in order of k). For unknown n at (i, j):
+ * surroundingPoints*P(i, j) - (sum of surrounding unknown P) = sum of surrounding boundary values
+ */
+void reducedSystem(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        Eigen::SparseMatrix<double> &A, Eigen::VectorXd &b, std::vector<long> &unknownPositions) {
+
+    long kMax = unsolvedSystem.getKMax();
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+    const bool *boundaryConditions = unsolvedSystem.getBoundaryConditionPositions().data();
+    const double *potentials = unsolvedSystem.getPotentials().data();
+
+    // Number the unknowns, -1 for boundary conditions
+    std::vector<long> unknownNumbers(kMax+1, -1);
+    unknownPositions.clear();
+    for(long k=0; k<=kMax; k++) {
+        if(!boundaryConditions[k]) {
+            unknownNumbers[k] = unknownPositions.size();
+            unknownPositions.push_back(k);
+        }
+    }
+    long unknowns = unknownPositions.size();
+    b.resize(unknowns);
+
+    /* A is symmetric, so each column is filled the same as the row would be, in
+     * order of increasing k. The boundary values are added to b at the same time.
+     */
+    auto forEachEntry = [&](long n, auto entry) {
+        long k = unknownPositions[n];
+        long i = k % lengthI;   // Counting from 0
+        long j = k / lengthI;
+        long neighbours[4] = {k-lengthI, k-1, k+1, k+lengthI};
+        bool onGrid[4] = {j>0, i>0, i<lengthI-1, j<lengthJ-1};
+        int surroundingPoints = onGrid[0] + onGrid[1] + onGrid[2] + onGrid[3];
+        double boundaryValues = 0;
+        for(int neighbour=0; neighbour<4; neighbour++) {
+            if(neighbour == 2) entry(n, surroundingPoints);
+            if(!onGrid[neighbour]) continue;
+            long neighbourK = neighbours[neighbour];
+            if(unknownNumbers[neighbourK] < 0) boundaryValues += potentials[neighbourK];
+            else entry(unknownNumbers[neighbourK], -1.0);
+        }
+        return boundaryValues;
+    };
+
+    fillCompressed(A, unknowns,
+        [&](long n) {
+            int entries = 0;
+            forEachEntry(n, [&](long, double) { entries++; });
+            return entries;
+        },
+        [&](long n, int *innerIndex, double *values) {
+            b(n) = forEachEntry(n, [&](long inner, double value) {
+                *innerIndex++ = inner;
+                *values++ = value;
+            });
+        });
+}
+
+/* Mixed precision iterative refinement: the equations are solved in single
+ * precision, which halves the memory (and memory bandwidth) needed by the matrix,
+ * preconditioner and vectors of the solver, then the residual of the solution
+ * is found in double precision and the equations are solved again (in single
+ * precision) for the correction, until the residual is as small as a double
+ * precision solve would give. Each single precision solve only has to reduce the
+ * residual by about 1e-5, so only a few are needed. solution is the starting
+ * guess. Returns the total number of iterations of the single precision solver.
+ */
+template<typename SinglePrecisionSolver>
+static int mixedPrecisionSolve(const Eigen::SparseMatrix<double> &A, const Eigen::VectorXd &b,
+        Eigen::VectorXd &solution) {
+    const int maxRefinements = 20;
+    const double tolerance = 1e-12;
+
+    SinglePrecisionSolver solver;
+    solver.setTolerance(1e-5f);
+    ScopedPhase factorizePhase("matrix: factorize");
+    Eigen::SparseMatrix<float> singleA = A.cast<float>();
+    solver.compute(singleA);
+    factorizePhase.stop();
+
+    ScopedPhase solvePhase("matrix: solve");
+    int iterations = 0;
+    double bNorm = b.norm();
+    for(int refinement=0; refinement<maxRefinements; refinement++) {
+        Eigen::VectorXd residual = b - A*solution;
+        if(residual.norm() <= tolerance * bNorm) break;
+        Eigen::VectorXf correction = solver.solve(residual.cast<float>());
+        iterations += solver.iterations();
+        solution += correction.cast<double>();
+    }
+    return iterations;
+}
+
+/* Solves the reduced system of equations (see reducedSystem) with a symmetric
+ * positive definite solver from eigen, or in mixed precision. The iterative
+ * methods start from guess unless it is empty.
+ */
+static int finiteDiffReduced(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, std::string method, const Eigen::VectorXd &guess) {
+
+    Eigen::SparseMatrix<double> A;
+    Eigen::VectorXd b;
+    std::vector<long> unknownPositions;
+    ScopedPhase assemblyPhase("matrix: assembly");
+    reducedSystem(unsolvedSystem, A, b, unknownPositions);
+    assemblyPhase.stop();
+
+    Eigen::VectorXd solution;
+    int iterations = 0;
+    if(method == "eigencgmixed" || method == "eigenbiconmixed") {
+        solution = Eigen::VectorXd::Zero(unknownPositions.size());
+        if(guess.size() > 0) {
+            for(long n=0; n<(long)unknownPositions.size(); n++) solution(n) = guess(unknownPositions[n]);
+        }
+        if(method == "eigencgmixed") {
+            iterations = mixedPrecisionSolve<Eigen::ConjugateGradient<Eigen::SparseMatrix<float>,
+                Eigen::Lower|Eigen::Upper, Eigen::IncompleteCholesky<float, Eigen::Lower,
+                Eigen::NaturalOrdering<int> > > >(A, b, solution);
+        }
+        else {
+            iterations = mixedPrecisionSolve<Eigen::BiCGSTAB<Eigen::SparseMatrix<float> > >(A, b, solution);
+        }
+    }
+    else if(method == "eigencg") {
+        // Unknowns are already numbered along the grid, so reordering only slows it down
+        Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower|Eigen::Upper,
+            Eigen::IncompleteCholesky<double, Eigen::Lower, Eigen::NaturalOrdering<int> > > solver;
+        ScopedPhase factorizePhase("matrix: factorize");
+        solver.compute(A);
+        factorizePhase.stop();
+        ScopedPhase solvePhase("matrix: solve");
+        if(guess.size() > 0) {
+            Eigen::VectorXd reducedGuess(unknownPositions.size());
+            for(long n=0; n<(long)unknownPositions.size(); n++) reducedGuess(n) = guess(unknownPositions[n]);
+            solution = solver.solveWithGuess(b, reducedGuess);
+        }
+        else solution = solver.solve(b);
+        iterations = solver.iterations();
+    }
+    else if(method == "eigenldlt") {
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver;
+        ScopedPhase analyzePhase("matrix: analyze");
+        solver.analyzePattern(A);
+        analyzePhase.stop();
+        ScopedPhase factorizePhase("matrix: factorize");
+        solver.factorize(A);
+        factorizePhase.stop();
+        ScopedPhase solvePhase("matrix: solve");
+        solution = solver.solve(b);
+    }
+
+    // Boundary conditions are copied over, the rest come from the solution
+    ScopedPhase copyPhase("matrix: copy back");
+    solvedSystem.setPotentials(unsolvedSystem.startingPotentials(nullptr));
+    GridView<double> potentials = solvedSystem.potentialView();
+    for(long n=0; n<(long)unknownPositions.size(); n++) {
+        potentials.atK(unknownPositions[n]) = solution(n);
+    }
+    return iterations;
+}
+
 /* Takes an UnsolvedElectrostaticSystem and and empty SolvedElectrostaticSystem,
  * solves the unsolved system and saves the result in the solved system.
  *
@@ -35,99 +348,117 @@ namespace electrostatics {
  * and A is the coefficents matrix, the Eigen or ViennaCL library is then
  * used to solve the system as specified by the function call.
  */
-void finiteDiffMatrix(const UnsolvedElectrostaticSystem &unsolvedSystem,
-        SolvedElectrostaticSystem &solvedSystem, std::string method) {
+int finiteDiffMatrix(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, std::string method,
+        const ElectrostaticSystem *initialGuess) {
 
     long kMax = unsolvedSystem.getKMax();
-    Eigen::SparseMatrix<double> A;
 
-    // Dimension kMax+1 as k counts from zero
-    // Sparse Lu solve method needs column major storage, others need row major
-    if(method == "eigensparselu") {
-        A = Eigen::SparseMatrix<double, Eigen::ColMajor>(kMax+1, kMax+1);
-    } else {
-        A = Eigen::SparseMatrix<double, Eigen::RowMajor>(kMax+1, kMax+1);
+    // Starting potentials for the iterative methods, indexed by k (empty if there is no guess)
+    Eigen::VectorXd guess;
+    if(initialGuess != nullptr) {
+        guess = unsolvedSystem.startingPotentials(initialGuess).reshaped();
     }
 
-    Eigen::VectorXd b(kMax+1);  // Boundary values vector
+    // The matrix free method doesn't need A, so is done separately
+    if(method == "eigenbiconmatrixfree") {
+        return finiteDiffMatrixFree(unsolvedSystem, solvedSystem, guess);
+    }
 
-    // Allocate space for A - it wont have more than 5 elements per row
-    A.reserve(Eigen::VectorXi::Constant(kMax+1, 5));
+    // As are the methods that use the reduced system of equations
+    if(method == "eigencg" || method == "eigenldlt" || method == "eigencgmixed" || method == "eigenbiconmixed") {
+        return finiteDiffReduced(unsolvedSystem, solvedSystem, method, guess);
+    }
 
-    // Fill the matrix A and boundary values vector b
-    for(int j=unsolvedSystem.getJMin(); j<=unsolvedSystem.getJMax(); j++) {
-        for(int i=unsolvedSystem.getIMin(); i<=unsolvedSystem.getIMax(); i++) {
-            int k = unsolvedSystem.ij2k(i, j);
+    // If the SparseLU factorization can be reused, A doesn't need to be filled
+    std::unique_lock<std::mutex> cacheLock(sparseLUCacheMutex, std::defer_lock);
+    if(method == "eigensparselu") cacheLock.lock();
+    bool cachedFactorization = (method == "eigensparselu") && sparseLUCache.matches(unsolvedSystem);
 
-            /* If (i, j) is a boundary condition, add the corresponding boundary
-             * to A and the bounday values vector:
-             * (i, j) = boundary value
-             */
-            if(unsolvedSystem.isBoundaryConditionIJ(i, j)) {
-                A.insert(k, k) = 1;
-                b(k) = unsolvedSystem.getPotentialIJ(i, j);
-            }
-
-            /* If (i,j) is not a boundary condition, add finite difference equation 
-             * for (i, j) to A:
-             * (i, j+1) + (i, j-1) + (i+1, j) + (i-1, j) - 4(i, j) = 0
-             * If (i, j) is on the edge of the system, ignore points that would
-             * end up outside and adjust the coefficent for that point (the 
-             * 4 in the above equation) accordingly.
-             */
-            else {
-                int surroundingPoints = 0;
-                if(i<unsolvedSystem.getIMax()) {
-                    A.insert(k, k+1) = 1;
-                    surroundingPoints += 1;
-                }
-                if(i>unsolvedSystem.getIMin()) {
-                    A.insert(k, k-1) = 1;
-                    surroundingPoints += 1;
-                }
-                if(j<unsolvedSystem.getJMax()) {
-                    A.insert(k, k+unsolvedSystem.getLengthI()) = 1;
-                    surroundingPoints += 1;
-                }
-                if(j>unsolvedSystem.getJMin()) {
-                    A.insert(k, k-unsolvedSystem.getLengthI()) = 1;
-                    surroundingPoints += 1;
-                }
-                A.insert(k, k) = -surroundingPoints;
-            }
-        }
+    // Sparse LU solve method needs column major storage, others need row major
+    ScopedPhase assemblyPhase("matrix: assembly");
+    Eigen::SparseMatrix<double, Eigen::ColMajor> columnMajorA;
+    Eigen::SparseMatrix<double, Eigen::RowMajor> rowMajorA;
+    Eigen::VectorXd b;  // Boundary values vector
+    if(method == "eigensparselu") {
+        assembleFullSystem(unsolvedSystem, columnMajorA, b, !cachedFactorization);
+    }
+    else {
+        assembleFullSystem(unsolvedSystem, rowMajorA, b, true);
     }
-    A.makeCompressed();
+    assemblyPhase.stop();
+    int lengthI = unsolvedSystem.getLengthI();
 
     Eigen::VectorXd solution(kMax+1); // Eigen vector to hold the solution
+    int iterations = 0;
     if(method == "eigenbicon") {
         Eigen::BiCGSTAB<Eigen::SparseMatrix<double, Eigen::RowMajor> > solver;
-        solver.compute(A);
-        solution = solver.solve(b);
+        ScopedPhase factorizePhase("matrix: factorize");
+        solver.compute(rowMajorA);
+        factorizePhase.stop();
+        ScopedPhase solvePhase("matrix: solve");
+        if(guess.size() > 0) solution = solver.solveWithGuess(b, guess);
+        else solution = solver.solve(b);
+        iterations = solver.iterations();
     }
     else if(method == "eigensparselu") {
-        Eigen::SparseLU<Eigen::SparseMatrix<double, Eigen::ColMajor> > solver;
-        solver.analyzePattern(A);
-        solver.factorize(A);
-        solution = solver.solve(b);
+        if(cachedFactorization) {
+            sparseLUCache.hits += 1;
+        }
+        else {
+            sparseLUCache.misses += 1;
+            sparseLUCache.valid = false;
+            sparseLUCache.solver.reset(new Eigen::SparseLU<Eigen::SparseMatrix<double, Eigen::ColMajor> >());
+            ScopedPhase analyzePhase("matrix: analyze");
+            sparseLUCache.solver->analyzePattern(columnMajorA);
+            analyzePhase.stop();
+            ScopedPhase factorizePhase("matrix: factorize");
+            sparseLUCache.solver->factorize(columnMajorA);
+            factorizePhase.stop();
+            sparseLUCache.iMin = unsolvedSystem.getIMin();
+            sparseLUCache.iMax = unsolvedSystem.getIMax();
+            sparseLUCache.jMin = unsolvedSystem.getJMin();
+            sparseLUCache.jMax = unsolvedSystem.getJMax();
+            sparseLUCache.boundaryConditionPositions = unsolvedSystem.getBoundaryConditionPositions();
+            sparseLUCache.valid = sparseLUCache.solver->info() == Eigen::Success;
+            if(!sparseLUCache.valid) {
+                throw std::runtime_error("Error: Sparse LU factorization failed: " +
+                        sparseLUCache.solver->lastErrorMessage());
+            }
+        }
+        ScopedPhase solvePhase("matrix: solve");
+        solution = sparseLUCache.solver->solve(b);
     }
     else if(method == "viennabicon") {
+        /* ViennaCL's bicgstab always starts from zero, so with a guess it solves for
+         * the correction to the guess instead, A(solution - guess) = b - A*guess,
+         * with the tolerance scaled so it stops at the same residual as without one.
+         */
+        Eigen::VectorXd rhs = b;
+        double tolerance = 1e-8;
+        if(guess.size() > 0) {
+            rhs = b - rowMajorA*guess;
+            if(rhs.norm() > 0) tolerance *= b.norm() / rhs.norm();
+        }
         // Make variables for viennacl and copy data to them
+        ScopedPhase solvePhase("matrix: solve");
         viennacl::vector<double> vcl_b(kMax+1);
         viennacl::compressed_matrix<double> vcl_A(kMax+1, kMax+1);
-        viennacl::copy(b, vcl_b);
-        viennacl::copy(A, vcl_A);
+        viennacl::copy(rhs, vcl_b);
+        viennacl::copy(rowMajorA, vcl_A);
         // Make ViennaCL vector variable for the solution
         viennacl::vector<double> vcl_solution(kMax+1);
         // Solve the system using viennacl's bicgstab method and copy back to eigen vector
-        vcl_solution = viennacl::linalg::solve(vcl_A, vcl_b, viennacl::linalg::bicgstab_tag());
+        vcl_solution = viennacl::linalg::solve(vcl_A, vcl_b, viennacl::linalg::bicgstab_tag(tolerance));
         viennacl::copy(vcl_solution, solution);
+        if(guess.size() > 0) solution += guess;
+        iterations = -1;    // Not reported by viennacl's solve
     }
 
     // Set the potentials in the solved system to the ones just calculated
-    for(int k=0; k<=kMax; k++) {
-        solvedSystem.setPotentialK(k, solution(k));
-    }
+    ScopedPhase copyPhase("matrix: copy back");
+    solvedSystem.setPotentials(solution.reshaped(lengthI, unsolvedSystem.getLengthJ()));
+    return iterations;
 }
 
 } // namespace electrostatics
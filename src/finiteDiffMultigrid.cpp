@@ -0,0 +1,356 @@
+#include <Eigen/Dense>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "finiteDiffMultigrid.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* One level of the multigrid hierarchy.
+ *
+ * Grids are indexed (a, b) from zero, the same way as the potentials of an
+ * ElectrostaticSystem, so a = i-iMin and b = j-jMin on the finest level.
+ * Point (a, b) on a coarse level is at the same position as point (2a, 2b)
+ * on the level above it.
+ *
+ * On each level the equation solved at every point that is not fixed is
+ * (sum of surrounding potentials - number of surrounding points * P) / spacing^2 = rhs
+ * which on the finest level (spacing 1, rhs 0) is the same equation used by
+ * finiteDiffMatrix and finiteDiffIterative. On the coarser levels the unknowns
+ * are corrections to the level above, so fixed points hold a correction of 0.
+ */
+struct MultigridLevel {
+    int lengthI, lengthJ;
+    double spacingSquared;
+    doubleGrid potentials;
+    doubleGrid rhs;
+    doubleGrid residuals;
+    boolGrid fixed;
+};
+
+/* Number of points surrounding (a, b) that are inside the grid. */
+static inline int surroundingPoints(const MultigridLevel &level, int a, int b) {
+    return (a>0) + (a<level.lengthI-1) + (b>0) + (b<level.lengthJ-1);
+}
+
+/* Sum of the potentials of the points surrounding (a, b) that are inside the grid. */
+static inline double surroundingSum(const MultigridLevel &level, int a, int b) {
+    double sum = 0;
+    if(a<level.lengthI-1) sum += level.potentials(a+1, b);
+    if(a>0) sum += level.potentials(a-1, b);
+    if(b<level.lengthJ-1) sum += level.potentials(a, b+1);
+    if(b>0) sum += level.potentials(a, b-1);
+    return sum;
+}
+
+/* Red-black Gauss-Seidel smoothing. Points with (a+b) even (red) and with (a+b)
+ * odd (black) are updated in turn, so each half only uses values from the other.
+ * Pre-smoothing does red then black and post-smoothing does black then red, so
+ * a V-cycle is symmetric and can be used as a preconditioner for the conjugate
+ * gradient method.
+ */
+static void smooth(MultigridLevel &level, int sweeps, bool redFirst) {
+    for(int sweep=0; sweep<sweeps; sweep++) {
+        for(int half=0; half<2; half++) {
+            int colour = (half==0) == redFirst ? 0 : 1;
+            for(int b=0; b<level.lengthJ; b++) {
+                for(int a=(b+colour)%2; a<level.lengthI; a+=2) {
+                    if(level.fixed(a, b)) continue;
+                    level.potentials(a, b) = (surroundingSum(level, a, b) -
+                            level.spacingSquared*level.rhs(a, b)) / surroundingPoints(level, a, b);
+                }
+            }
+        }
+    }
+}
+
+/* Calculates the residuals for a level. */
+static void findResiduals(MultigridLevel &level) {
+    for(int b=0; b<level.lengthJ; b++) {
+        for(int a=0; a<level.lengthI; a++) {
+            if(level.fixed(a, b)) {
+                level.residuals(a, b) = 0;
+                continue;
+            }
+            level.residuals(a, b) = level.rhs(a, b) - (surroundingSum(level, a, b) -
+                    surroundingPoints(level, a, b)*level.potentials(a, b)) / level.spacingSquared;
+        }
+    }
+}
+
+/* Makes a coarse level from a fine level. A coarse point is fixed if any of the
+ * fine points around it are fixed, so that corrections can't leak through thin
+ * boundaries (eg rings) that would otherwise fall between the coarse points.
+ */
+static MultigridLevel coarsen(const MultigridLevel &fine) {
+    MultigridLevel coarse;
+    coarse.lengthI = (fine.lengthI+1)/2;
+    coarse.lengthJ = (fine.lengthJ+1)/2;
+    coarse.spacingSquared = 4*fine.spacingSquared;
+    coarse.potentials = doubleGrid::Zero(coarse.lengthI, coarse.lengthJ);
+    coarse.rhs = doubleGrid::Zero(coarse.lengthI, coarse.lengthJ);
+    coarse.residuals = doubleGrid::Zero(coarse.lengthI, coarse.lengthJ);
+    coarse.fixed = boolGrid(coarse.lengthI, coarse.lengthJ);
+    for(int b=0; b<coarse.lengthJ; b++) {
+        for(int a=0; a<coarse.lengthI; a++) {
+            bool isFixed = false;
+            for(int fineB=std::max(2*b-1, 0); fineB<=std::min(2*b+1, fine.lengthJ-1); fineB++) {
+                for(int fineA=std::max(2*a-1, 0); fineA<=std::min(2*a+1, fine.lengthI-1); fineA++) {
+                    if(fine.fixed(fineA, fineB)) isFixed = true;
+                }
+            }
+            coarse.fixed(a, b) = isFixed;
+        }
+    }
+    return coarse;
+}
+
+/* The coarse points (a1, a2) that fine point a is interpolated from. They are
+ * the same point if a is at the same position as a coarse point, or is past
+ * the last one.
+ */
+static inline void coarseNeighbours(int a, int coarseLength, int &a1, int &a2) {
+    a1 = a/2;
+    a2 = (a%2 == 1 && a1+1 < coarseLength) ? a1+1 : a1;
+}
+
+/* Full weighting restriction of the fine residuals to the coarse rhs. This is
+ * the transpose of prolongateCorrection (scaled by 1/4) so that the V-cycle is
+ * symmetric.
+ */
+static void restrictResiduals(const MultigridLevel &fine, MultigridLevel &coarse) {
+    coarse.rhs.setZero();
+    for(int b=0; b<fine.lengthJ; b++) {
+        int coarseB1, coarseB2;
+        coarseNeighbours(b, coarse.lengthJ, coarseB1, coarseB2);
+        for(int a=0; a<fine.lengthI; a++) {
+            if(fine.fixed(a, b)) continue;
+            int coarseA1, coarseA2;
+            coarseNeighbours(a, coarse.lengthI, coarseA1, coarseA2);
+            double share = fine.residuals(a, b) / 16;
+            coarse.rhs(coarseA1, coarseB1) += share;
+            coarse.rhs(coarseA2, coarseB1) += share;
+            coarse.rhs(coarseA1, coarseB2) += share;
+            coarse.rhs(coarseA2, coarseB2) += share;
+        }
+    }
+    for(int b=0; b<coarse.lengthJ; b++) {
+        for(int a=0; a<coarse.lengthI; a++) {
+            if(coarse.fixed(a, b)) coarse.rhs(a, b) = 0;
+        }
+    }
+}
+
+/* Bilinear interpolation of the coarse corrections, added to the fine potentials. */
+static void prolongateCorrection(const MultigridLevel &coarse, MultigridLevel &fine) {
+    for(int b=0; b<fine.lengthJ; b++) {
+        int coarseB1, coarseB2;
+        coarseNeighbours(b, coarse.lengthJ, coarseB1, coarseB2);
+        for(int a=0; a<fine.lengthI; a++) {
+            if(fine.fixed(a, b)) continue;
+            int coarseA1, coarseA2;
+            coarseNeighbours(a, coarse.lengthI, coarseA1, coarseA2);
+            fine.potentials(a, b) += 0.25 * (coarse.potentials(coarseA1, coarseB1) +
+                    coarse.potentials(coarseA2, coarseB1) + coarse.potentials(coarseA1, coarseB2) +
+                    coarse.potentials(coarseA2, coarseB2));
+        }
+    }
+}
+
+/* A V-cycle starting from level number levelNumber. */
+static void vCycle(std::vector<MultigridLevel> &levels, unsigned int levelNumber) {
+    MultigridLevel &level = levels[levelNumber];
+    if(levelNumber == levels.size()-1) {
+        // Coarsest level is small enough that smoothing alone solves it
+        int sweeps = 2*(level.lengthI+level.lengthJ);
+        smooth(level, sweeps, true);
+        smooth(level, sweeps, false);
+        return;
+    }
+    MultigridLevel &coarse = levels[levelNumber+1];
+    smooth(level, 2, true);
+    findResiduals(level);
+    restrictResiduals(level, coarse);
+    coarse.potentials.setZero();
+    vCycle(levels, levelNumber+1);
+    prolongateCorrection(coarse, level);
+    smooth(level, 2, false);
+}
+
+/* Applies the (symmetric positive definite) finite difference operator for the
+ * points that are not fixed to x, treating fixed points as zero:
+ * result(i, j) = surroundingPoints * x(i, j) - sum of surrounding x
+ */
+static void applyOperator(const MultigridLevel &level, const doubleGrid &x, doubleGrid &result) {
+    for(int b=0; b<level.lengthJ; b++) {
+        for(int a=0; a<level.lengthI; a++) {
+            if(level.fixed(a, b)) {
+                result(a, b) = 0;
+                continue;
+            }
+            double sum = 0;
+            if(a<level.lengthI-1) sum += x(a+1, b);
+            if(a>0) sum += x(a-1, b);
+            if(b<level.lengthJ-1) sum += x(a, b+1);
+            if(b>0) sum += x(a, b-1);
+            result(a, b) = surroundingPoints(level, a, b)*x(a, b) - sum;
+        }
+    }
+}
+
+/* Multigrid preconditioned conjugate gradient method.
+ *
+ * Levels are added until the coarsest has no more than 4 points in either
+ * direction, or every point on it is fixed. Each iteration applies one V-cycle
+ * to the residual, with the finest level used to hold the correction.
+ */
+int finiteDiffMultigrid(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double tolerance, int maxCycles,
+        const ElectrostaticSystem *initialGuess) {
+
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+
+    // Set up the finest level and the solution from the unsolved system
+    doubleGrid solution = unsolvedSystem.startingPotentials(initialGuess);
+    std::vector<MultigridLevel> levels(1);
+    levels[0].lengthI = lengthI;
+    levels[0].lengthJ = lengthJ;
+    levels[0].spacingSquared = 1;
+    levels[0].potentials = doubleGrid::Zero(lengthI, lengthJ);
+    levels[0].rhs = doubleGrid::Zero(lengthI, lengthJ);
+    levels[0].residuals = doubleGrid::Zero(lengthI, lengthJ);
+    levels[0].fixed = unsolvedSystem.getBoundaryConditionPositions();
+
+    // Coarsen the grid
+    while(std::max(levels.back().lengthI, levels.back().lengthJ) > 4 && !levels.back().fixed.all()) {
+        levels.push_back(coarsen(levels.back()));
+    }
+    MultigridLevel &finest = levels[0];
+
+    /* Residual of the finite difference equations for the initial solution. The
+     * tolerance is relative to the residual with every unknown at zero, so that
+     * it doesn't depend on how good the initial guess is.
+     */
+    doubleGrid residual(lengthI, lengthJ);
+    finest.potentials = unsolvedSystem.startingPotentials(nullptr);
+    findResiduals(finest);
+    double initialNorm = finest.residuals.norm();
+    finest.potentials = solution;
+    findResiduals(finest);
+    residual = -finest.residuals;
+
+    // Conjugate gradient iterations, preconditioned with a V-cycle
+    doubleGrid direction(lengthI, lengthJ);
+    doubleGrid operatorDirection(lengthI, lengthJ);
+    double residualDotPreconditioned = 0;
+    int cycles = 0;
+    while(initialNorm > 0 && cycles < maxCycles && residual.norm() > tolerance*initialNorm) {
+        // Solve for the correction to the residual with a V-cycle
+        finest.potentials.setZero();
+        finest.rhs = -residual;
+        vCycle(levels, 0);
+        double newResidualDotPreconditioned = residual.cwiseProduct(finest.potentials).sum();
+        if(cycles == 0) direction = finest.potentials;
+        else direction = finest.potentials +
+            (newResidualDotPreconditioned/residualDotPreconditioned) * direction;
+        residualDotPreconditioned = newResidualDotPreconditioned;
+
+        applyOperator(finest, direction, operatorDirection);
+        double stepLength = residualDotPreconditioned / direction.cwiseProduct(operatorDirection).sum();
+        solution += stepLength * direction;
+        residual -= stepLength * operatorDirection;
+        cycles++;
+    }
+
+    // Copy the result into the solved system
+    solvedSystem.setPotentials(solution);
+    return cycles;
+}
+
+/* The full grid point at the same position as coarse point a. The last coarse
+ * point is always at the last full grid point, so that boundary conditions on
+ * the far edges are kept when the length of the full grid is even.
+ */
+static inline int finePosition(int a, int fineLength) {
+    return std::min(2*a, fineLength-1);
+}
+
+/* The coarse point nearest to full grid point a (odd points go to the one above). */
+static inline int coarsePosition(int a, int coarseLength) {
+    return std::min((a+1)/2, coarseLength-1);
+}
+
+/* The coarse grid has the points (2a, 2b) of the full grid, plus the last row and
+ * column. A coarse point is a boundary condition if any of the full grid points
+ * nearest to it is, so boundaries only one point thick aren't lost between the
+ * coarse points. It has the potential of the full grid point at the same position
+ * if that is a boundary condition, or the mean of the boundary conditions nearest
+ * to it if not. The coarse solution is then interpolated between the two coarse
+ * points on either side of each full grid point (in each direction).
+ */
+void coarseGridGuess(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &guess, double tolerance) {
+
+    int lengthI = unsolvedSystem.getLengthI();
+    int lengthJ = unsolvedSystem.getLengthJ();
+    int coarseLengthI = lengthI/2 + 1;
+    int coarseLengthJ = lengthJ/2 + 1;
+    const boolGrid &fixed = unsolvedSystem.getBoundaryConditionPositions();
+    const doubleGrid &potentials = unsolvedSystem.getPotentials();
+
+    // Restrict the boundary conditions, OR-ing the positions over each block of points
+    doubleGrid potentialSums = doubleGrid::Zero(coarseLengthI, coarseLengthJ);
+    Eigen::ArrayXXi numbersFixed = Eigen::ArrayXXi::Zero(coarseLengthI, coarseLengthJ);
+    for(int b=0; b<lengthJ; b++) {
+        for(int a=0; a<lengthI; a++) {
+            if(!fixed(a, b)) continue;
+            potentialSums(coarsePosition(a, coarseLengthI), coarsePosition(b, coarseLengthJ)) += potentials(a, b);
+            numbersFixed(coarsePosition(a, coarseLengthI), coarsePosition(b, coarseLengthJ)) += 1;
+        }
+    }
+    UnsolvedElectrostaticSystem coarseSystem(0, coarseLengthI-1, 0, coarseLengthJ-1);
+    for(int b=0; b<coarseLengthJ; b++) {
+        int fineB = finePosition(b, lengthJ);
+        for(int a=0; a<coarseLengthI; a++) {
+            int fineA = finePosition(a, lengthI);
+            if(fixed(fineA, fineB)) coarseSystem.setBoundaryPoint(a, b, potentials(fineA, fineB));
+            else if(numbersFixed(a, b) > 0) {
+                coarseSystem.setBoundaryPoint(a, b, potentialSums(a, b) / numbersFixed(a, b));
+            }
+        }
+    }
+
+    SolvedElectrostaticSystem coarseSolution(0, coarseLengthI-1, 0, coarseLengthJ-1);
+    finiteDiffMultigrid(coarseSystem, coarseSolution, tolerance);
+
+    // Linear interpolation in each direction, keeping the boundary conditions
+    const doubleGrid &coarsePotentials = coarseSolution.getPotentials();
+    doubleGrid guessPotentials(lengthI, lengthJ);
+    for(int b=0; b<lengthJ; b++) {
+        int coarseB1 = b/2;
+        int coarseB2 = std::min(coarseB1+1, coarseLengthJ-1);
+        double weightB = double(b - finePosition(coarseB1, lengthJ)) /
+            std::max(finePosition(coarseB2, lengthJ) - finePosition(coarseB1, lengthJ), 1);
+        for(int a=0; a<lengthI; a++) {
+            if(fixed(a, b)) {
+                guessPotentials(a, b) = potentials(a, b);
+                continue;
+            }
+            int coarseA1 = a/2;
+            int coarseA2 = std::min(coarseA1+1, coarseLengthI-1);
+            double weightA = double(a - finePosition(coarseA1, lengthI)) /
+                std::max(finePosition(coarseA2, lengthI) - finePosition(coarseA1, lengthI), 1);
+            guessPotentials(a, b) =
+                (1-weightB) * ((1-weightA)*coarsePotentials(coarseA1, coarseB1) +
+                        weightA*coarsePotentials(coarseA2, coarseB1)) +
+                weightB * ((1-weightA)*coarsePotentials(coarseA1, coarseB2) +
+                        weightA*coarsePotentials(coarseA2, coarseB2));
+        }
+    }
+    guess.setPotentials(guessPotentials);
+}
+
+} // namespace electrostatics
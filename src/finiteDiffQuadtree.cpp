@@ -0,0 +1,29 @@
+#include <Eigen/Dense>
+#include <cmath>
+#include "finiteDiffQuadtree.h"
+#include "QuadtreeGrid.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+long finiteDiffQuadtree(const UnsolvedElectrostaticSystem &unsolvedSystem,
+        SolvedElectrostaticSystem &solvedSystem, double refinementTolerance, int maxLevel,
+        int maxPasses, const ElectrostaticSystem *initialGuess) {
+
+    if(refinementTolerance <= 0) {
+        double maxPotential = unsolvedSystem.startingPotentials(nullptr).cwiseAbs().maxCoeff();
+        refinementTolerance = (maxPotential > 0) ? 5e-5 * maxPotential : 5e-5;
+    }
+
+    QuadtreeGrid grid(unsolvedSystem, maxLevel, 2, initialGuess);
+    grid.solve();
+    for(int pass=0; pass<maxPasses && grid.adapt(refinementTolerance); pass++) {
+        grid.solve();
+    }
+
+    grid.resample(solvedSystem);
+    return grid.getNumberOfUnknowns();
+}
+
+} // namespace electrostatics
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <ios>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "phaseTimer.h"
+
+namespace electrostatics {
+
+/* Timings are found by name in phaseNumbers, and kept in the order they were
+ * first recorded in timings.
+ */
+static std::mutex phaseMutex;
+static std::unordered_map<std::string, int> phaseNumbers;
+static std::vector<PhaseTiming> timings;
+
+void ScopedPhase::stop() {
+    if(stopped) return;
+    stopped = true;
+    recordPhase(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void recordPhase(const char *name, double seconds) {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    auto found = phaseNumbers.find(name);
+    if(found == phaseNumbers.end()) {
+        found = phaseNumbers.emplace(name, timings.size()).first;
+        timings.push_back(PhaseTiming{name, 0, 0, 0});
+    }
+    PhaseTiming &timing = timings[found->second];
+    timing.calls += 1;
+    timing.totalSeconds += seconds;
+    if(seconds > timing.maxSeconds) timing.maxSeconds = seconds;
+}
+
+std::vector<PhaseTiming> phaseTimings() {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    return timings;
+}
+
+void resetPhaseTimings() {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    phaseNumbers.clear();
+    timings.clear();
+}
+
+/* The columns are padded with setw, so long phase names (eg commands from a .cfg
+ * file) widen the name column rather than being cut off.
+ */
+void printPhaseReport(std::ostream &output) {
+    std::vector<PhaseTiming> report = phaseTimings();
+    size_t nameWidth = 5;
+    for(const PhaseTiming &timing : report) nameWidth = std::max(nameWidth, timing.name.size());
+
+    std::ios::fmtflags flags = output.flags();
+    std::streamsize precision = output.precision();
+    output << std::left << std::setw(nameWidth) << "Phase" << std::right << " " << std::setw(8) << "Calls" << " "
+        << std::setw(12) << "Total (s)" << " " << std::setw(12) << "Mean (s)" << " " << std::setw(12) << "Max (s)"
+        << "\n";
+    output << std::fixed << std::setprecision(6);
+    for(const PhaseTiming &timing : report) {
+        output << std::left << std::setw(nameWidth) << timing.name << std::right << " " << std::setw(8)
+            << timing.calls << " " << std::setw(12) << timing.totalSeconds << " " << std::setw(12)
+            << timing.totalSeconds / timing.calls << " " << std::setw(12) << timing.maxSeconds << "\n";
+    }
+    output.flags(flags);
+    output.precision(precision);
+}
+
+/* Phase names can come from a .cfg file, so quotes, backslashes and control
+ * characters are escaped.
+ */
+static std::string jsonString(const std::string &text) {
+    std::string quoted = "\"";
+    for(unsigned char character : text) {
+        if(character == '"' || character == '\\') {
+            quoted += '\\';
+            quoted += character;
+        }
+        else if(character < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+            quoted += escaped;
+        }
+        else quoted += character;
+    }
+    return quoted + "\"";
+}
+
+void savePhaseReportJSON(std::string fileName) {
+    std::ofstream file(fileName);
+    if(!file) throw std::runtime_error("Error: Could not open " + fileName + " for writing!");
+
+    std::vector<PhaseTiming> report = phaseTimings();
+    file.precision(9);
+    file << "{\n  \"phases\": [";
+    for(int n=0; n<(int)report.size(); n++) {
+        file << (n ? ",\n" : "\n") << "    {\"name\": " << jsonString(report[n].name) << ", \"calls\": "
+            << report[n].calls << ", \"totalSeconds\": " << report[n].totalSeconds << ", \"maxSeconds\": "
+            << report[n].maxSeconds << "}";
+    }
+    file << "\n  ]\n}\n";
+    if(!file) throw std::runtime_error("Error: Could not write " + fileName + "!");
+}
+
+} // namespace electrostatics
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "rasterPlot.h"
+#include "equipotentials.h"
+#include "GridView.h"
+#include "SolvedElectrostaticSystem.h"
+#include "phaseTimer.h"
+
+namespace electrostatics {
+
+/* The palette of the plot files, from the smallest potential (0) to the largest (7). */
+static const unsigned char palette[8][3] = {
+    {0xFF, 0xFF, 0xD9}, {0xED, 0xF8, 0xB1}, {0xC7, 0xE9, 0xB4}, {0x7F, 0xCD, 0xBB},
+    {0x41, 0xB6, 0xC4}, {0x1D, 0x91, 0xC0}, {0x22, 0x5E, 0xA8}, {0x0C, 0x2C, 0x84}
+};
+static const unsigned char arrowColour[3] = {0, 0, 0};
+static const unsigned char contourColour[3] = {0xFF, 0, 0};   // Line style 1 of the plot files
+
+/* Colours between the ones in the palette are interpolated, as gnuplot does. */
+static void paletteColour(double fraction, unsigned char *rgb) {
+    double position = std::min(std::max(fraction, 0.0), 1.0) * 7;
+    int lower = std::min((int)position, 6);
+    double weight = position - lower;
+    for(int channel=0; channel<3; channel++) {
+        rgb[channel] = std::lround(palette[lower][channel]*(1-weight) + palette[lower+1][channel]*weight);
+    }
+}
+
+/* Each output row is averaged and coloured on its own, so the rows are split
+ * between threads.
+ */
+template<typename Scalar>
+RasterImage renderPotentials(GridView<const Scalar> potentials, int maxWidth, int maxHeight) {
+    if(maxWidth < 1 || maxHeight < 1) throw std::invalid_argument("Error: The image must be at least 1 pixel!");
+    ScopedPhase renderPhase("render: potentials");
+    int lengthI = potentials.getLengthI();
+    int lengthJ = potentials.getLengthJ();
+
+    RasterImage image;
+    image.pointsPerPixel = std::max((lengthI + maxWidth - 1) / maxWidth, (lengthJ + maxHeight - 1) / maxHeight);
+    int pointsPerPixel = image.pointsPerPixel;
+    image.width = (lengthI + pointsPerPixel - 1) / pointsPerPixel;
+    image.height = (lengthJ + pointsPerPixel - 1) / pointsPerPixel;
+    image.iMin = potentials.getIMin();
+    image.jMax = potentials.getJMax();
+    image.potentials.assign((long)image.width * image.height, 0);
+    image.rgb.resize((long)image.width * image.height * 3);
+
+    double minPotential = INFINITY;
+    double maxPotential = -INFINITY;
+    #pragma omp parallel for schedule(dynamic, 16) reduction(min:minPotential) reduction(max:maxPotential)
+    for(int y=0; y<image.height; y++) {
+        double *pixels = image.potentials.data() + (long)y*image.width;
+        int jTop = image.jMax - y*pointsPerPixel;
+        int jBottom = std::max(jTop - pointsPerPixel + 1, potentials.getJMin());
+        for(int j=jBottom; j<=jTop; j++) {
+            const Scalar *row = &potentials(image.iMin, j);
+            for(int a=0; a<lengthI; a++) {
+                pixels[a / pointsPerPixel] += row[a];
+                minPotential = std::min(minPotential, (double)row[a]);
+                maxPotential = std::max(maxPotential, (double)row[a]);
+            }
+        }
+        for(int x=0; x<image.width; x++) {
+            int blockWidth = std::min(pointsPerPixel, lengthI - x*pointsPerPixel);
+            pixels[x] /= blockWidth * (jTop - jBottom + 1);
+        }
+    }
+    image.minPotential = minPotential;
+    image.maxPotential = maxPotential;
+
+    double range = maxPotential - minPotential;
+    #pragma omp parallel for schedule(static)
+    for(long pixel=0; pixel<(long)image.width*image.height; pixel++) {
+        double fraction = (range > 0) ? (image.potentials[pixel] - minPotential) / range : 0;
+        paletteColour(fraction, &image.rgb[pixel*3]);
+    }
+    return image;
+}
+
+template RasterImage renderPotentials<double>(GridView<const double>, int, int);
+template RasterImage renderPotentials<float>(GridView<const float>, int, int);
+
+static void setPixel(RasterImage &image, int x, int y, const unsigned char *colour) {
+    if(x<0 || x>=image.width || y<0 || y>=image.height) return;
+    std::copy(colour, colour+3, &image.rgb[((long)y*image.width + x) * 3]);
+}
+
+/* Bresenham's line algorithm, between pixel centres. */
+static void drawLine(RasterImage &image, int x0, int y0, int x1, int y1, const unsigned char *colour) {
+    int dx = std::abs(x1-x0);
+    int dy = -std::abs(y1-y0);
+    int stepX = (x0 < x1) ? 1 : -1;
+    int stepY = (y0 < y1) ? 1 : -1;
+    int error = dx + dy;
+    while(true) {
+        setPixel(image, x0, y0, colour);
+        if(x0 == x1 && y0 == y1) break;
+        int twiceError = 2*error;
+        if(twiceError >= dy) {
+            error += dy;
+            x0 += stepX;
+        }
+        if(twiceError <= dx) {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+/* The arrows are the same length as in fieldplot, 0.85 of the spacing, with the
+ * head made of two lines at 150 degrees to the arrow.
+ */
+void drawFieldArrows(RasterImage &image, const SolvedElectrostaticSystem &system, int spacing) {
+    if(spacing < 1) throw std::invalid_argument("Error: The arrow spacing must be at least 1!");
+    ScopedPhase renderPhase("render: field arrows");
+    double length = 0.85 * spacing / image.pointsPerPixel;
+    double headLength = std::max(2.0, 0.3*length);
+    for(int j=system.getJMin(); j<=system.getJMax(); j+=spacing) {
+        for(int i=system.getIMin(); i<=system.getIMax(); i+=spacing) {
+            double fieldX, fieldY;
+            system.getFieldIJ(i, j, fieldX, fieldY);
+            double magnitude = sqrt(fieldX*fieldX + fieldY*fieldY);
+            if(!(magnitude > 0)) continue;
+            // Pixel positions, with y going down the image
+            double startX = (i - image.iMin + 0.5) / image.pointsPerPixel;
+            double startY = (image.jMax - j + 0.5) / image.pointsPerPixel;
+            double directionX = fieldX / magnitude;
+            double directionY = -fieldY / magnitude;
+            double endX = startX + length*directionX;
+            double endY = startY + length*directionY;
+            drawLine(image, startX, startY, endX, endY, arrowColour);
+            for(int side : {-1, 1}) {
+                double angle = side * 5*M_PI/6;
+                double headX = directionX*cos(angle) - directionY*sin(angle);
+                double headY = directionX*sin(angle) + directionY*cos(angle);
+                drawLine(image, endX, endY, endX + headLength*headX, endY + headLength*headY, arrowColour);
+            }
+        }
+    }
+}
+
+void drawEquipotentials(RasterImage &image, const std::vector<Equipotential> &equipotentials) {
+    ScopedPhase renderPhase("render: equipotentials");
+    for(const Equipotential &equipotential : equipotentials) {
+        for(size_t n=1; n<equipotential.points.size(); n++) {
+            const ContourPoint &start = equipotential.points[n-1];
+            const ContourPoint &end = equipotential.points[n];
+            drawLine(image, (start.i - image.iMin + 0.5) / image.pointsPerPixel,
+                    (image.jMax - start.j + 0.5) / image.pointsPerPixel, (end.i - image.iMin + 0.5) / image.pointsPerPixel,
+                    (image.jMax - end.j + 0.5) / image.pointsPerPixel, contourColour);
+        }
+    }
+}
+
+
+/* Writing image files */
+
+static void writeFile(const std::string &fileName, const std::vector<unsigned char> &data) {
+    FILE *outputFile = std::fopen(fileName.c_str(), "wb");
+    if(!outputFile) throw std::runtime_error("Error: Could not open " + fileName + " for writing!");
+    bool written = std::fwrite(data.data(), 1, data.size(), outputFile) == data.size();
+    written = (std::fclose(outputFile) == 0) && written;
+    if(!written) throw std::runtime_error("Error: Could not write " + fileName + "!");
+}
+
+void savePPM(const RasterImage &image, std::string fileName) {
+    ScopedPhase exportPhase("export: image");
+    std::string header = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+    std::vector<unsigned char> data(header.begin(), header.end());
+    data.insert(data.end(), image.rgb.begin(), image.rgb.end());
+    writeFile(fileName, data);
+}
+
+static uint32_t crc32(const unsigned char *data, size_t length, uint32_t crc) {
+    static uint32_t table[256];
+    static bool tableMade = [] {
+        for(uint32_t n=0; n<256; n++) {
+            uint32_t value = n;
+            for(int bit=0; bit<8; bit++) value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            table[n] = value;
+        }
+        return true;
+    }();
+    (void)tableMade;
+    crc = ~crc;
+    for(size_t n=0; n<length; n++) crc = table[(crc ^ data[n]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendBigEndian(std::vector<unsigned char> &data, uint32_t value) {
+    for(int shift=24; shift>=0; shift-=8) data.push_back(value >> shift);
+}
+
+static void appendChunk(std::vector<unsigned char> &png, const char *type, const std::vector<unsigned char> &data) {
+    appendBigEndian(png, data.size());
+    size_t start = png.size();
+    png.insert(png.end(), type, type+4);
+    png.insert(png.end(), data.begin(), data.end());
+    appendBigEndian(png, crc32(&png[start], png.size()-start, 0));
+}
+
+/* The image data is put in a zlib stream of stored (uncompressed) deflate
+ * blocks, so it doesn't need zlib. The files are the same size as a PPM file, but
+ * can be opened by anything.
+ */
+void savePNG(const RasterImage &image, std::string fileName) {
+    ScopedPhase exportPhase("export: image");
+    // Each row starts with its filter type, none
+    long rowBytes = (long)image.width*3 + 1;
+    std::vector<unsigned char> raw(rowBytes * image.height);
+    for(int y=0; y<image.height; y++) {
+        raw[y*rowBytes] = 0;
+        std::copy(&image.rgb[(long)y*image.width*3], &image.rgb[(long)(y+1)*image.width*3], &raw[y*rowBytes + 1]);
+    }
+
+    const long maxBlock = 65535;
+    std::vector<unsigned char> compressed = {0x78, 0x01};
+    for(long start=0; start<(long)raw.size() || start==0; start+=maxBlock) {
+        long length = std::min(maxBlock, (long)raw.size()-start);
+        bool last = start + length >= (long)raw.size();
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back(length & 0xFF);
+        compressed.push_back(length >> 8);
+        compressed.push_back(~length & 0xFF);
+        compressed.push_back((~length >> 8) & 0xFF);
+        compressed.insert(compressed.end(), raw.begin()+start, raw.begin()+start+length);
+        if(last) break;
+    }
+    uint32_t a = 1, b = 0;
+    for(unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(compressed, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, image.width);
+    appendBigEndian(header, image.height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});    // 8 bit RGB, no interlacing
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", compressed);
+    appendChunk(png, "IEND", {});
+    writeFile(fileName, png);
+}
+
+} // namespace electrostatics
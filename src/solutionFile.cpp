@@ -0,0 +1,163 @@
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "solutionFile.h"
+#include "ElectrostaticSystem.h"
+#include "phaseTimer.h"
+
+namespace electrostatics {
+
+static const char solutionFileMagic[8] = {'E', 'S', 'S', 'O', 'L', 'N', 0, 0};
+static const uint32_t solutionFileVersion = 1;
+
+static_assert(sizeof(SolutionFileHeader) == 64, "Solution file header must be 64 bytes");
+
+
+/* The header for system, with the rest of its bytes zero. */
+static void fillHeader(SolutionFileHeader &header, const ElectrostaticSystem &system, bool singlePrecision) {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, solutionFileMagic, sizeof(header.magic));
+    header.version = solutionFileVersion;
+    header.bytesPerValue = singlePrecision ? sizeof(float) : sizeof(double);
+    header.iMin = system.getIMin();
+    header.iMax = system.getIMax();
+    header.jMin = system.getJMin();
+    header.jMax = system.getJMax();
+}
+
+/* The potentials are written straight from the system in one go. Floats are
+ * converted a block at a time so the whole grid isn't copied.
+ */
+void saveSolutionFile(const ElectrostaticSystem &system, std::string fileName, bool singlePrecision) {
+    ScopedPhase exportPhase("export: binary");
+    SolutionFileHeader header;
+    fillHeader(header, system, singlePrecision);
+
+    FILE *outputFile = std::fopen(fileName.c_str(), "wb");
+    if(!outputFile) throw std::runtime_error("Error: Could not open " + fileName + " for writing!");
+
+    bool written = std::fwrite(&header, sizeof(header), 1, outputFile) == 1;
+    const double *potentials = system.getPotentials().data();
+    long numberOfValues = system.getKMax() + 1;
+    if(!singlePrecision) {
+        written = written && std::fwrite(potentials, sizeof(double), numberOfValues, outputFile) ==
+            (size_t)numberOfValues;
+    }
+    else {
+        const long blockSize = 1 << 16;
+        std::vector<float> block(std::min(blockSize, numberOfValues));
+        for(long start=0; start<numberOfValues && written; start+=blockSize) {
+            long count = std::min(blockSize, numberOfValues-start);
+            std::copy(potentials+start, potentials+start+count, block.begin());
+            written = std::fwrite(block.data(), sizeof(float), count, outputFile) == (size_t)count;
+        }
+    }
+    written = (std::fclose(outputFile) == 0) && written;
+    if(!written) throw std::runtime_error("Error: Could not write " + fileName + "!");
+}
+
+
+/* MappedSolutionFile */
+
+MappedSolutionFile::MappedSolutionFile(std::string fileName) : mapping(nullptr), mappingSize(0) {
+    int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+    if(fileDescriptor < 0) throw std::runtime_error("Error: Could not open " + fileName + "!");
+    struct stat fileStatus;
+    if(fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size < (off_t)sizeof(SolutionFileHeader)) {
+        close(fileDescriptor);
+        throw std::runtime_error("Error: " + fileName + " is not a solution file!");
+    }
+    mappingSize = fileStatus.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);  // The mapping stays valid after the file is closed
+    if(mapping == MAP_FAILED) throw std::runtime_error("Error: Could not map " + fileName + "!");
+
+    header = static_cast<const SolutionFileHeader*>(mapping);
+    values = static_cast<const char*>(mapping) + sizeof(SolutionFileHeader);
+
+    // Check the header describes the rest of the file
+    bool valid = std::memcmp(header->magic, solutionFileMagic, sizeof(header->magic)) == 0 &&
+        header->version == solutionFileVersion &&
+        (header->bytesPerValue == sizeof(double) || header->bytesPerValue == sizeof(float)) &&
+        header->iMax >= header->iMin && header->jMax >= header->jMin &&
+        mappingSize == sizeof(SolutionFileHeader) +
+            (size_t)getLengthI() * getLengthJ() * header->bytesPerValue;
+    if(!valid) {
+        munmap(mapping, mappingSize);
+        throw std::runtime_error("Error: " + fileName + " is not a valid solution file!");
+    }
+
+    // The potentials are usually read from start to end
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+}
+
+/* An anonymous mapping is used so the file in memory is unmapped the same way
+ * as one read from disk.
+ */
+MappedSolutionFile::MappedSolutionFile(const ElectrostaticSystem &system, bool singlePrecision) :
+        mapping(nullptr), mappingSize(0) {
+    long numberOfValues = system.getKMax() + 1;
+    mappingSize = sizeof(SolutionFileHeader) + numberOfValues * (singlePrecision ? sizeof(float) : sizeof(double));
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED) throw std::runtime_error("Error: Could not make memory for the solution!");
+
+    SolutionFileHeader *newHeader = static_cast<SolutionFileHeader*>(mapping);
+    fillHeader(*newHeader, system, singlePrecision);
+    header = newHeader;
+    char *newValues = static_cast<char*>(mapping) + sizeof(SolutionFileHeader);
+    values = newValues;
+    const double *potentials = system.getPotentials().data();
+    if(singlePrecision) std::copy(potentials, potentials+numberOfValues, reinterpret_cast<float*>(newValues));
+    else std::copy(potentials, potentials+numberOfValues, reinterpret_cast<double*>(newValues));
+    mprotect(mapping, mappingSize, PROT_READ);
+}
+
+MappedSolutionFile::~MappedSolutionFile() {
+    munmap(mapping, mappingSize);
+}
+
+double MappedSolutionFile::getPotentialIJ(int i, int j) const {
+    if(i>getIMax() || i<getIMin() || j>getJMax() || j<getJMin()) throw std::out_of_range(
+            "Error: Trying to get element out of range!");
+    long k = (i-getIMin()) + (long)(j-getJMin())*getLengthI();
+    if(isSinglePrecision()) return static_cast<const float*>(values)[k];
+    return static_cast<const double*>(values)[k];
+}
+
+GridView<const double> MappedSolutionFile::potentialView() const {
+    if(isSinglePrecision()) throw std::logic_error("Error: The potentials are stored as floats!");
+    return GridView<const double>(static_cast<const double*>(values), getIMin(), getJMin(),
+            getLengthI(), getLengthJ());
+}
+
+GridView<const float> MappedSolutionFile::singlePrecisionView() const {
+    if(!isSinglePrecision()) throw std::logic_error("Error: The potentials are stored as doubles!");
+    return GridView<const float>(static_cast<const float*>(values), getIMin(), getJMin(),
+            getLengthI(), getLengthJ());
+}
+
+void MappedSolutionFile::copyTo(ElectrostaticSystem &system) const {
+    if(system.getIMin() != getIMin() || system.getIMax() != getIMax() ||
+            system.getJMin() != getJMin() || system.getJMax() != getJMax()) {
+        throw std::invalid_argument("The dimensions of the system must match the file!");
+    }
+    GridView<double> potentials = system.potentialView();
+    long numberOfValues = potentials.getKMax() + 1;
+    if(isSinglePrecision()) {
+        const float *first = static_cast<const float*>(values);
+        std::copy(first, first+numberOfValues, potentials.getData());
+    }
+    else {
+        const double *first = static_cast<const double*>(values);
+        std::copy(first, first+numberOfValues, potentials.getData());
+    }
+}
+
+} // namespace electrostatics
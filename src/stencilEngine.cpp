@@ -0,0 +1,250 @@
+#include <Eigen/Dense>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include "stencilEngine.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+// The vectorised kernels need x86 intrinsics and gcc/clang target attributes
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STENCIL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace electrostatics {
+
+/* PaddedGrid */
+
+PaddedGrid::PaddedGrid(int lengthI, int lengthJ) :
+    lengthI(lengthI), lengthJ(lengthJ), stride(lengthI+2),
+    values((long)(lengthI+2)*(lengthJ+2), 0.0) {}
+
+void PaddedGrid::load(const doubleGrid &potentials) {
+    if(potentials.rows() != lengthI || potentials.cols() != lengthJ) {
+        throw std::invalid_argument("The dimensions of the potentials must match the grid!");
+    }
+    for(int b=0; b<lengthJ; b++) {
+        const double *column = potentials.data() + (long)b*lengthI;
+        std::copy(column, column+lengthI, row(b));
+    }
+}
+
+void PaddedGrid::store(doubleGrid &potentials) const {
+    potentials.resize(lengthI, lengthJ);
+    for(int b=0; b<lengthJ; b++) {
+        std::copy(row(b), row(b)+lengthI, potentials.data() + (long)b*lengthI);
+    }
+}
+
+
+/* Kernels
+ *
+ * The surrounding potentials are always added in the same order (right, left,
+ * above, below) as finiteDiffIterative originally did, so every kernel gives
+ * exactly the same result. Multiplying by 0.25 is exact, so is the same as
+ * dividing by 4.
+ */
+
+static void jacobiInteriorScalar(const double *from, double *to, long stride, int count) {
+    for(int n=0; n<count; n++) {
+        double sum = from[n+1] + from[n-1];
+        sum += from[n+stride];
+        sum += from[n-stride];
+        to[n] = sum * 0.25;
+    }
+}
+
+#ifdef STENCIL_X86
+__attribute__((target("avx2")))
+static void jacobiInteriorAVX2(const double *from, double *to, long stride, int count) {
+    const __m256d quarter = _mm256_set1_pd(0.25);
+    int n = 0;
+    for(; n+4<=count; n+=4) {
+        __m256d sum = _mm256_add_pd(_mm256_loadu_pd(from+n+1), _mm256_loadu_pd(from+n-1));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(from+n+stride));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(from+n-stride));
+        _mm256_storeu_pd(to+n, _mm256_mul_pd(sum, quarter));
+    }
+    jacobiInteriorScalar(from+n, to+n, stride, count-n);
+}
+
+__attribute__((target("avx512f")))
+static void jacobiInteriorAVX512(const double *from, double *to, long stride, int count) {
+    const __m512d quarter = _mm512_set1_pd(0.25);
+    int n = 0;
+    for(; n+8<=count; n+=8) {
+        __m512d sum = _mm512_add_pd(_mm512_loadu_pd(from+n+1), _mm512_loadu_pd(from+n-1));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(from+n+stride));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(from+n-stride));
+        _mm512_storeu_pd(to+n, _mm512_mul_pd(sum, quarter));
+    }
+    jacobiInteriorScalar(from+n, to+n, stride, count-n);
+}
+#endif
+
+typedef void (*InteriorKernelFunction)(const double*, double*, long, int);
+
+bool stencilInstructionSetSupported(std::string instructionSet) {
+    if(instructionSet == "scalar") return true;
+#ifdef STENCIL_X86
+    __builtin_cpu_init();
+    if(instructionSet == "avx2") return __builtin_cpu_supports("avx2");
+    if(instructionSet == "avx512") return __builtin_cpu_supports("avx512f");
+#endif
+    return false;
+}
+
+static InteriorKernelFunction interiorKernelFor(std::string instructionSet) {
+#ifdef STENCIL_X86
+    if(instructionSet == "avx512") return jacobiInteriorAVX512;
+    if(instructionSet == "avx2") return jacobiInteriorAVX2;
+#endif
+    return jacobiInteriorScalar;
+}
+
+static std::string bestInstructionSet() {
+    if(stencilInstructionSetSupported("avx512")) return "avx512";
+    if(stencilInstructionSetSupported("avx2")) return "avx2";
+    return "scalar";
+}
+
+// Chosen once when the program starts
+static std::string currentInstructionSet = bestInstructionSet();
+static InteriorKernelFunction interiorKernel = interiorKernelFor(currentInstructionSet);
+
+std::string stencilInstructionSet() { return currentInstructionSet; }
+
+void useStencilInstructionSet(std::string instructionSet) {
+    if(!stencilInstructionSetSupported(instructionSet)) {
+        throw std::invalid_argument("Error: Instruction set " + instructionSet + " is not supported!");
+    }
+    currentInstructionSet = instructionSet;
+    interiorKernel = interiorKernelFor(instructionSet);
+}
+
+void JacobiKernel<interiorRegion>::apply(const double *from, double *to, long stride, int count) {
+    interiorKernel(from, to, stride, count);
+}
+
+void JacobiKernel<edgeRegion>::apply(const double *from, double *to, long stride, int count,
+        int a, int b, int lengthI, int lengthJ) {
+    int verticalPoints = (b>0) + (b<lengthJ-1);
+    for(int n=0; n<count; n++, a++) {
+        double sum = from[n+1] + from[n-1];
+        sum += from[n+stride];
+        sum += from[n-stride];
+        to[n] = sum / ((a>0) + (a<lengthI-1) + verticalPoints);
+    }
+}
+
+
+/* StencilEngine */
+
+StencilEngine::StencilEngine(const UnsolvedElectrostaticSystem &unsolvedSystem) :
+    lengthI(unsolvedSystem.getLengthI()), lengthJ(unsolvedSystem.getLengthJ()) {
+        const boolGrid &boundaryConditions = unsolvedSystem.getBoundaryConditionPositions();
+        for(int b=0; b<lengthJ; b++) {
+            rowStarts.push_back(runs.size());
+            int a = 0;
+            while(a < lengthI) {
+                if(boundaryConditions(a, b)) {
+                    a++;
+                    continue;
+                }
+                StencilRun run;
+                run.b = b;
+                run.start = a;
+                while(a < lengthI && !boundaryConditions(a, b)) a++;
+                run.end = a;
+                runs.push_back(run);
+            }
+        }
+        rowStarts.push_back(runs.size());
+}
+
+void StencilEngine::updateRun(const StencilRun &run, const PaddedGrid &from, PaddedGrid &to) const {
+    long stride = from.getStride();
+    const double *fromRow = from.row(run.b);
+    double *toRow = to.row(run.b);
+
+    // Top and bottom rows are all edge points
+    if(run.b == 0 || run.b == lengthJ-1) {
+        JacobiKernel<edgeRegion>::apply(fromRow+run.start, toRow+run.start, stride,
+                run.end-run.start, run.start, run.b, lengthI, lengthJ);
+        return;
+    }
+
+    // Otherwise only the first and last points of the row are
+    int start = run.start;
+    int end = run.end;
+    if(start == 0) {
+        JacobiKernel<edgeRegion>::apply(fromRow, toRow, stride, 1, 0, run.b, lengthI, lengthJ);
+        start = 1;
+    }
+    bool lastPoint = (end == lengthI);
+    if(lastPoint) end = lengthI-1;
+    if(end > start) {
+        JacobiKernel<interiorRegion>::apply(fromRow+start, toRow+start, stride, end-start);
+    }
+    if(lastPoint && lengthI-1 >= start) {
+        JacobiKernel<edgeRegion>::apply(fromRow+lengthI-1, toRow+lengthI-1, stride, 1,
+                lengthI-1, run.b, lengthI, lengthJ);
+    }
+}
+
+void StencilEngine::updateRow(int b, const PaddedGrid &from, PaddedGrid &to) const {
+    for(long runNumber=rowStarts[b]; runNumber<rowStarts[b+1]; runNumber++) {
+        updateRun(runs[runNumber], from, to);
+    }
+}
+
+void StencilEngine::jacobiSweep(const PaddedGrid &from, PaddedGrid &to) const {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(long runNumber=0; runNumber<(long)runs.size(); runNumber++) {
+        updateRun(runs[runNumber], from, to);
+    }
+}
+
+/* Iteration t of row b needs iteration t-1 of rows b-1, b and b+1, and
+ * overwrites iteration t-2 of row b, which iteration t-1 of rows b-1, b and b+1
+ * need. Doing iteration t of row b at step b + 2t means both have always been
+ * done at an earlier step. The rows done at the same step don't depend on each
+ * other, so can be done at the same time.
+ */
+void StencilEngine::jacobiIterations(PaddedGrid &gridA, PaddedGrid &gridB, int iterations,
+        int sweepsPerPass) const {
+    if(sweepsPerPass <= 0) sweepsPerPass = autoSweepsPerPass();
+
+    for(int done=0; done<iterations; done+=sweepsPerPass) {
+        int sweeps = std::min(sweepsPerPass, iterations-done);
+        if(sweeps == 1) {
+            if((done+1)%2 == 1) jacobiSweep(gridA, gridB);
+            else jacobiSweep(gridB, gridA);
+            continue;
+        }
+        for(int step=0; step<lengthJ+2*(sweeps-1); step++) {
+            #pragma omp parallel for schedule(static)
+            for(int sweep=0; sweep<sweeps; sweep++) {
+                int b = step - 2*sweep;
+                if(b < 0 || b >= lengthJ) continue;
+                if((done+sweep+1)%2 == 1) updateRow(b, gridA, gridB);
+                else updateRow(b, gridB, gridA);
+            }
+        }
+    }
+}
+
+/* About 2*sweepsPerPass+2 rows of each grid are needed at once. Half the cache
+ * is left for everything else.
+ */
+int StencilEngine::autoSweepsPerPass() const {
+    long cacheSize = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if(cacheSize <= 0) cacheSize = 1 << 20;
+    long rowSize = (lengthI+2) * (long)sizeof(double);
+    long rows = cacheSize / 2 / (2*rowSize);
+    return std::max(1L, std::min(32L, (rows-2)/2));
+}
+
+} // namespace electrostatics
@@ -0,0 +1,44 @@
+#include <Eigen/Dense>
+#include <stdexcept>
+#include "stencilOperator.h"
+#include "ElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+
+namespace electrostatics {
+
+/* Constructor */
+
+StencilOperator::StencilOperator(const UnsolvedElectrostaticSystem &unsolvedSystem) :
+    lengthI(unsolvedSystem.getLengthI()), lengthJ(unsolvedSystem.getLengthJ()),
+    kMax(unsolvedSystem.getKMax()),
+    boundaryConditionPositions(unsolvedSystem.getBoundaryConditionPositions()) {}
+
+
+/* Methods */
+
+Eigen::VectorXd StencilOperator::inverseDiagonal() const {
+    Eigen::VectorXd result(kMax+1);
+    for(int b=0; b<lengthJ; b++) {
+        for(int a=0; a<lengthI; a++) {
+            long k = a + (long)b*lengthI;
+            if(boundaryConditionPositions(a, b)) result(k) = 1;
+            else result(k) = -1.0 / ((a>0) + (a<lengthI-1) + (b>0) + (b<lengthJ-1));
+        }
+    }
+    return result;
+}
+
+double relativeResidual(const UnsolvedElectrostaticSystem &unsolvedSystem, const ElectrostaticSystem &solvedSystem) {
+    if(solvedSystem.getIMin() != unsolvedSystem.getIMin() || solvedSystem.getIMax() != unsolvedSystem.getIMax() ||
+            solvedSystem.getJMin() != unsolvedSystem.getJMin() || solvedSystem.getJMax() != unsolvedSystem.getJMax()) {
+        throw std::invalid_argument("The dimensions of the solved system must match the unsolved system!");
+    }
+    StencilOperator A(unsolvedSystem);
+    Eigen::VectorXd b = unsolvedSystem.startingPotentials(nullptr).reshaped();
+    Eigen::VectorXd v = solvedSystem.getPotentials().reshaped();
+    double initialResidual = (b - A*b).norm();
+    double residual = (b - A*v).norm();
+    return (initialResidual > 0) ? residual / initialResidual : residual;
+}
+
+} // namespace electrostatics
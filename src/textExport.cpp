@@ -0,0 +1,80 @@
+#include <stdexcept>
+#include <string>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include "textExport.h"
+#include "GridView.h"
+#include "phaseTimer.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace electrostatics {
+
+char* formatDouble(char *out, double value, bool roundTrip) {
+    if(roundTrip) return std::to_chars(out, out+maxDoubleCharacters, value).ptr;
+    // std::ostream uses printf's %g with a precision of 6
+    return std::to_chars(out, out+maxDoubleCharacters, value, std::chars_format::general, 6).ptr;
+}
+
+char* formatInt(char *out, int value) {
+    return std::to_chars(out, out+maxIntCharacters, value).ptr;
+}
+
+/* Each block has a buffer of about 4MB per thread, which is formatted and then
+ * written before the next block is started.
+ */
+void writeTextRows(std::string fileName, long numberOfRows, long maxRowCharacters,
+        std::function<char*(long row, char *out)> formatRow) {
+    FILE *outputFile = std::fopen(fileName.c_str(), "wb");
+    if(!outputFile) throw std::runtime_error("Error: Could not open " + fileName + " for writing!");
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    long rowsPerThread = std::max(1L, (4L << 20) / maxRowCharacters);
+    std::vector<std::vector<char>> buffers(threads, std::vector<char>(rowsPerThread * maxRowCharacters));
+    std::vector<long> bufferLengths(threads, 0);
+
+    bool written = true;
+    for(long blockStart=0; blockStart<numberOfRows && written; blockStart+=rowsPerThread*threads) {
+        #pragma omp parallel for schedule(static, 1) num_threads(threads)
+        for(int thread=0; thread<threads; thread++) {
+            long firstRow = std::min(blockStart + thread*rowsPerThread, numberOfRows);
+            long endRow = std::min(firstRow + rowsPerThread, numberOfRows);
+            char *out = buffers[thread].data();
+            for(long row=firstRow; row<endRow; row++) out = formatRow(row, out);
+            bufferLengths[thread] = out - buffers[thread].data();
+        }
+        for(int thread=0; thread<threads && written; thread++) {
+            written = std::fwrite(buffers[thread].data(), 1, bufferLengths[thread], outputFile) ==
+                (size_t)bufferLengths[thread];
+        }
+    }
+    written = (std::fclose(outputFile) == 0) && written;
+    if(!written) throw std::runtime_error("Error: Could not write " + fileName + "!");
+}
+
+template<typename Scalar>
+void savePotentialsText(GridView<const Scalar> potentials, std::string fileName, bool roundTrip) {
+    ScopedPhase exportPhase("export: text");
+    long maxRowCharacters = (long)potentials.getLengthI() * (maxDoubleCharacters+1) + 1;
+    writeTextRows(fileName, potentials.getLengthJ(), maxRowCharacters, [&](long row, char *out) {
+        for(Scalar potential : potentials.row(potentials.getJMin() + row)) {
+            out = formatDouble(out, potential, roundTrip);
+            *out++ = ' ';
+        }
+        *out++ = '\n';
+        return out;
+    });
+}
+
+template void savePotentialsText<double>(GridView<const double>, std::string, bool);
+template void savePotentialsText<float>(GridView<const float>, std::string, bool);
+
+} // namespace electrostatics
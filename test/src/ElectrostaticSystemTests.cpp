@@ -68,3 +68,23 @@ TEST_F(ElectrostaticSystemTest, SetAndGetPotential2) {
     system->setPotentialK(16, potential);
     ASSERT_EQ(potential, system->getPotentialIJ(ij[0], ij[1]));
 }
+
+TEST_F(ElectrostaticSystemTest, K2ijReferences) {
+    int i, j;
+    system->k2ij(22, i, j);
+    ASSERT_EQ(-17, i);
+    ASSERT_EQ(-7, j);
+    ASSERT_THROW(system->k2ij(system->getKMax()+1, i, j), std::out_of_range);
+}
+
+TEST_F(ElectrostaticSystemTest, CompareTo) {
+    electrostatics::ElectrostaticSystem other(-18, 2, -8, 6);
+    electrostatics::ElectrostaticSystem comparison(-18, 2, -8, 6);
+    system->setPotentialIJ(-3, 6, 2.5);
+    other.setPotentialIJ(-3, 6, -1);
+    other.setPotentialIJ(2, -8, 4);
+    system->compareTo(other, comparison);
+    ASSERT_EQ(3.5, comparison.getPotentialIJ(-3, 6));
+    ASSERT_EQ(4, comparison.getPotentialIJ(2, -8));
+    ASSERT_EQ(0, comparison.getPotentialIJ(0, 0));
+}
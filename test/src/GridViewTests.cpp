@@ -0,0 +1,74 @@
+#include "GridView.h"
+#include "ElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <gtest/gtest.h>
+
+class GridViewTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-6, 4, -3, 5);
+            for(int j=-3; j<=5; j++) {
+                for(int i=-6; i<=4; i++) {
+                    system->setPotentialIJ(i, j, 100*i + j);
+                }
+            }
+            system->setBoundaryPoint(2, -1, 7);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(GridViewTest, MatchesCheckedAccess) {
+    electrostatics::GridView<const double> potentials = system->potentialView();
+    electrostatics::GridView<const bool> boundaryConditions = system->boundaryConditionView();
+    ASSERT_EQ(-6, potentials.getIMin());
+    ASSERT_EQ(4, potentials.getIMax());
+    ASSERT_EQ(-3, potentials.getJMin());
+    ASSERT_EQ(5, potentials.getJMax());
+    ASSERT_EQ(system->getKMax(), potentials.getKMax());
+    for(int j=-3; j<=5; j++) {
+        for(int i=-6; i<=4; i++) {
+            ASSERT_EQ(system->getPotentialIJ(i, j), potentials(i, j));
+            ASSERT_EQ(system->getPotentialIJ(i, j), potentials.atK(system->ij2k(i, j)));
+            ASSERT_EQ(system->isBoundaryConditionIJ(i, j), boundaryConditions(i, j));
+        }
+    }
+}
+
+TEST_F(GridViewTest, Write) {
+    electrostatics::GridView<double> potentials = system->potentialView();
+    potentials(-5, 4) = 1.5;
+    potentials.atK(3) = -2.5;
+    ASSERT_EQ(1.5, system->getPotentialIJ(-5, 4));
+    ASSERT_EQ(-2.5, system->getPotentialK(3));
+}
+
+TEST_F(GridViewTest, RowSpan) {
+    electrostatics::GridView<double> potentials = system->potentialView();
+    electrostatics::RowSpan<double> row = potentials.row(2);
+    ASSERT_EQ(11, row.size());
+    ASSERT_EQ(-398, row[-4]);
+    int i = -6;
+    for(double &potential : row) {
+        ASSERT_EQ(system->getPotentialIJ(i, 2), potential);
+        potential = 0;
+        i++;
+    }
+    ASSERT_EQ(5, i);
+    ASSERT_EQ(0, system->getPotentialIJ(4, 2));
+    ASSERT_EQ(403, system->getPotentialIJ(4, 3));
+}
+
+TEST_F(GridViewTest, ForEachIJ) {
+    long points = 0;
+    system->potentialView().forEachIJ([&](int i, int j, const double &potential) {
+        if(i == 2 && j == -1) ASSERT_EQ(7, potential);
+        else ASSERT_EQ(100*i + j, potential);
+        points++;
+    });
+    ASSERT_EQ(system->getKMax()+1, points);
+}
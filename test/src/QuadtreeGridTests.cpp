@@ -0,0 +1,118 @@
+#include "QuadtreeGrid.h"
+#include "finiteDiffQuadtree.h"
+#include "finiteDiffMatrix.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+class QuadtreeGridTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+        electrostatics::SolvedElectrostaticSystem* sparseLU;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-100, 100, -80, 80);
+            system->setBoundaryCircle(-30, 0, 4, 100);
+            system->setBoundaryCircle(40, 10, 3, -50);
+            system->setLeftBoundary(0);
+            sparseLU = new electrostatics::SolvedElectrostaticSystem(-100, 100, -80, 80);
+            electrostatics::finiteDiffMatrix(*system, *sparseLU, "eigensparselu");
+        }
+
+        virtual void TearDown() {
+            delete system;
+            delete sparseLU;
+        }
+};
+
+TEST_F(QuadtreeGridTest, SinglePointLeavesMatchSparseLU) {
+    electrostatics::QuadtreeGrid grid(*system, 0);
+    ASSERT_EQ(201*161, grid.getNumberOfLeaves());
+    grid.solve(1e-12);
+    electrostatics::SolvedElectrostaticSystem quadtree(-100, 100, -80, 80);
+    grid.resample(quadtree);
+    for(int i=-100; i<=100; i++) {
+        for(int j=-80; j<=80; j++) {
+            ASSERT_NEAR(sparseLU->getPotentialIJ(i, j), quadtree.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+}
+
+TEST_F(QuadtreeGridTest, FewerUnknownsSimilarResult) {
+    electrostatics::SolvedElectrostaticSystem quadtree(-100, 100, -80, 80);
+    long unknowns = electrostatics::finiteDiffQuadtree(*system, quadtree);
+    ASSERT_LT(unknowns, 201*161/2);
+    for(int i=-100; i<=100; i++) {
+        for(int j=-80; j<=80; j++) {
+            ASSERT_NEAR(sparseLU->getPotentialIJ(i, j), quadtree.getPotentialIJ(i, j), 0.2);
+        }
+    }
+    ASSERT_EQ(100, quadtree.getPotentialIJ(-30, 0));
+    ASSERT_EQ(0, quadtree.getPotentialIJ(-100, 50));
+}
+
+TEST_F(QuadtreeGridTest, Problem3) {
+    // Leaves next to the plates and between the cylinders can be big
+    electrostatics::UnsolvedElectrostaticSystem plates(-300, 300, -100, 100);
+    plates.setTopBoundary(-100);
+    plates.setBottomBoundary(-100);
+    for(int centre=-200; centre<=200; centre+=100) plates.setBoundaryCircle(centre, 0, 5, 0);
+    electrostatics::SolvedElectrostaticSystem platesLU(-300, 300, -100, 100);
+    electrostatics::finiteDiffMatrix(plates, platesLU, "eigensparselu");
+
+    electrostatics::SolvedElectrostaticSystem quadtree(-300, 300, -100, 100);
+    long unknowns = electrostatics::finiteDiffQuadtree(plates, quadtree);
+    ASSERT_LT(unknowns, 601*201/9);
+    for(int i=-300; i<=300; i++) {
+        for(int j=-100; j<=100; j++) {
+            ASSERT_NEAR(platesLU.getPotentialIJ(i, j), quadtree.getPotentialIJ(i, j), 0.1);
+        }
+    }
+}
+
+TEST_F(QuadtreeGridTest, InitialGuess) {
+    electrostatics::QuadtreeGrid grid(*system);
+    int iterations = grid.solve();
+    electrostatics::SolvedElectrostaticSystem solution(-100, 100, -80, 80);
+    grid.resample(solution);
+    electrostatics::QuadtreeGrid guessed(*system, 5, 2, &solution);
+    ASSERT_LT(guessed.solve(), iterations);
+    electrostatics::SolvedElectrostaticSystem wrongSize(-100, 100, -80, 79);
+    ASSERT_THROW(electrostatics::QuadtreeGrid(*system, 5, 2, &wrongSize), std::invalid_argument);
+}
+
+TEST_F(QuadtreeGridTest, BoundaryConditionsAreSinglePoints) {
+    electrostatics::QuadtreeGrid grid(*system);
+    for(const electrostatics::QuadtreeLeaf &leaf : grid.getLeaves()) {
+        if(leaf.boundaryCondition) {
+            ASSERT_EQ(0, leaf.level);
+        }
+    }
+    const electrostatics::QuadtreeLeaf &leaf = grid.getLeaves()[grid.findLeaf(40, 10)];
+    ASSERT_TRUE(leaf.boundaryCondition);
+}
+
+TEST_F(QuadtreeGridTest, NeighboursWithinOneLevel) {
+    electrostatics::QuadtreeGrid grid(*system);
+    grid.solve();
+    grid.adapt(0.05);
+    grid.solve();
+    grid.adapt(0.05);
+    for(int i=-100; i<100; i++) {
+        for(int j=-80; j<80; j++) {
+            int level = grid.getLeaves()[grid.findLeaf(i, j)].level;
+            ASSERT_LE(std::abs(level - grid.getLeaves()[grid.findLeaf(i+1, j)].level), 1);
+            ASSERT_LE(std::abs(level - grid.getLeaves()[grid.findLeaf(i, j+1)].level), 1);
+        }
+    }
+}
+
+TEST_F(QuadtreeGridTest, Exceptions) {
+    electrostatics::QuadtreeGrid grid(*system);
+    ASSERT_THROW(grid.findLeaf(101, 0), std::out_of_range);
+    ASSERT_THROW(grid.findLeaf(0, -81), std::out_of_range);
+    electrostatics::SolvedElectrostaticSystem wrongSize(-100, 100, -80, 79);
+    ASSERT_THROW(grid.resample(wrongSize), std::invalid_argument);
+}
@@ -0,0 +1,108 @@
+#include "SolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+class SolvedElectrostaticSystemTest : public ::testing::Test {
+    protected:
+        electrostatics::SolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::SolvedElectrostaticSystem(-18, 2, -8, 6);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(SolvedElectrostaticSystemTest, UniformField) {
+    // The differences are exact for a linear potential, including at the edges
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) system->setPotentialIJ(i, j, 2*i - 3*j);
+    }
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) {
+            double fieldX, fieldY;
+            system->getFieldIJ(i, j, fieldX, fieldY);
+            ASSERT_EQ(-2, fieldX);
+            ASSERT_EQ(3, fieldY);
+        }
+    }
+    ASSERT_EQ(sqrt(13.0), system->findMaxField());
+}
+
+TEST_F(SolvedElectrostaticSystemTest, RowsMatchPoints) {
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) system->setPotentialIJ(i, j, i*i*0.5 + sin(j) - i*j);
+    }
+    std::vector<double> fieldX(21), fieldY(21);
+    double maxField = 0;
+    for(int j=-8; j<=6; j++) {
+        system->findFieldRow(j, fieldX.data(), fieldY.data());
+        for(int i=-18; i<=2; i++) {
+            double pointX, pointY;
+            system->getFieldIJ(i, j, pointX, pointY);
+            ASSERT_EQ(pointX, fieldX[i+18]);
+            ASSERT_EQ(pointY, fieldY[i+18]);
+            maxField = std::max(maxField, sqrt(pointX*pointX + pointY*pointY));
+        }
+    }
+    // Central difference along the top row (j=6), -dV/di = j - i
+    ASSERT_DOUBLE_EQ(11, fieldX[13]);
+    ASSERT_DOUBLE_EQ(maxField, system->findMaxField());
+}
+
+TEST_F(SolvedElectrostaticSystemTest, FieldOutOfRange) {
+    double fieldX, fieldY;
+    std::vector<double> row(21);
+    ASSERT_THROW(system->getFieldIJ(3, 0, fieldX, fieldY), std::out_of_range);
+    ASSERT_THROW(system->findFieldRow(-9, row.data(), row.data()), std::out_of_range);
+
+    // A grid one point wide only has a field along it
+    electrostatics::SolvedElectrostaticSystem line(0, 0, 0, 4);
+    for(int j=0; j<=4; j++) line.setPotentialIJ(0, j, j);
+    line.getFieldIJ(0, 2, fieldX, fieldY);
+    ASSERT_EQ(0, fieldX);
+    ASSERT_EQ(-1, fieldY);
+}
+
+TEST_F(SolvedElectrostaticSystemTest, DecimatedFieldFile) {
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) system->setPotentialIJ(i, j, i*i*0.5 + sin(j) - i*j);
+    }
+    std::string fullName = ::testing::TempDir() + "solvedSystemTestField";
+    std::string decimatedName = ::testing::TempDir() + "solvedSystemTestFieldDecimated";
+    system->saveFieldGNUPlot(fullName);
+    system->saveFieldGNUPlot(decimatedName, 3, -16, 2, -8, 0);
+
+    // The decimated file has the same lines as the full file for the sampled points
+    std::ifstream fullFile(fullName);
+    std::ostringstream expected;
+    std::string line;
+    while(std::getline(fullFile, line)) {
+        if(line.empty()) continue;
+        std::istringstream point(line);
+        int i, j;
+        point >> i >> j;
+        if(i >= -16 && (i+16) % 3 == 0 && j <= 0 && (j+8) % 3 == 0) {
+            expected << line << "\n";
+            if(j == -2) expected << "\n";
+        }
+    }
+    std::ifstream decimatedFile(decimatedName);
+    std::ostringstream decimated;
+    decimated << decimatedFile.rdbuf();
+    ASSERT_EQ(expected.str(), decimated.str());
+    std::remove(fullName.c_str());
+    std::remove(decimatedName.c_str());
+
+    ASSERT_THROW(system->saveFieldGNUPlot(decimatedName, 2, -19, 2, -8, 6), std::out_of_range);
+    ASSERT_THROW(system->saveFieldGNUPlot(decimatedName, 0, -18, 2, -8, 6), std::invalid_argument);
+    ASSERT_THROW(system->saveFieldGNUPlot(decimatedName, 2, 0, -1, -8, 6), std::invalid_argument);
+}
@@ -0,0 +1,76 @@
+#include "SuperpositionBasis.h"
+#include "finiteDiffMatrix.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+
+class SuperpositionBasisTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-20, 20, -12, 12);
+            system->selectElectrode("core");
+            system->setBoundaryCircle(0, 0, 4, 0);
+            system->selectElectrode("left");
+            system->setLeftBoundary(50);
+            system->deselectElectrode();
+            system->setRightBoundary(-50);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(SuperpositionBasisTest, DefaultVoltages) {
+    electrostatics::SuperpositionBasis basis(*system);
+    ASSERT_EQ(0, basis.getElectrodeNumber("core"));
+    ASSERT_EQ(1, basis.getElectrodeNumber("left"));
+    ASSERT_THROW(basis.getElectrodeNumber("right"), std::invalid_argument);
+
+    electrostatics::SolvedElectrostaticSystem superposed(-20, 20, -12, 12);
+    electrostatics::SolvedElectrostaticSystem direct(-20, 20, -12, 12);
+    basis.combine(basis.getDefaultVoltages(), superposed);
+    electrostatics::finiteDiffMatrix(*system, direct, "eigensparselu");
+    for(int i=-20; i<=20; i++) {
+        for(int j=-12; j<=12; j++) {
+            ASSERT_NEAR(direct.getPotentialIJ(i, j), superposed.getPotentialIJ(i, j), 1e-8);
+        }
+    }
+}
+
+TEST_F(SuperpositionBasisTest, NewVoltages) {
+    electrostatics::SuperpositionBasis basis(*system);
+    std::vector<double> voltages(2);
+    voltages[0] = 7.5;
+    voltages[1] = -20;
+    electrostatics::SolvedElectrostaticSystem superposed(-20, 20, -12, 12);
+    basis.combine(voltages, superposed);
+
+    electrostatics::UnsolvedElectrostaticSystem changed(-20, 20, -12, 12);
+    changed.setBoundaryCircle(0, 0, 4, 7.5);
+    changed.setLeftBoundary(-20);
+    changed.setRightBoundary(-50);
+    electrostatics::SolvedElectrostaticSystem direct(-20, 20, -12, 12);
+    electrostatics::finiteDiffMatrix(changed, direct, "eigensparselu");
+    for(int i=-20; i<=20; i++) {
+        for(int j=-12; j<=12; j++) {
+            ASSERT_NEAR(direct.getPotentialIJ(i, j), superposed.getPotentialIJ(i, j), 1e-8);
+        }
+    }
+}
+
+TEST_F(SuperpositionBasisTest, WrongNumberOfVoltages) {
+    electrostatics::SuperpositionBasis basis(*system);
+    electrostatics::SolvedElectrostaticSystem superposed(-20, 20, -12, 12);
+    ASSERT_THROW(basis.combine(std::vector<double>(3, 0), superposed), std::invalid_argument);
+}
+
+TEST_F(SuperpositionBasisTest, ElectrodeWithTwoVoltages) {
+    system->selectElectrode("core");
+    system->setBoundaryPoint(10, 0, 3);
+    ASSERT_THROW(electrostatics::SuperpositionBasis basis(*system), std::invalid_argument);
+}
@@ -0,0 +1,116 @@
+#include "TaskGraph.h"
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+
+// A task that prints its name
+static std::function<void(std::ostream&)> printTask(std::string name) {
+    return [name](std::ostream &output) { output << name << "\n"; };
+}
+
+TEST(TaskGraphTest, Dependencies) {
+    electrostatics::TaskGraph graph;
+    graph.addTask(printTask("new a"), {}, {"a"});
+    graph.addTask(printTask("new b"), {}, {"b"});
+    graph.addTask(printTask("solve a"), {"a"}, {"solved a"});
+    graph.addTask(printTask("solve b"), {"b"}, {"solved b"});
+    graph.addTask(printTask("save a"), {"solved a"}, {});
+    graph.addTask(printTask("change a"), {}, {"solved a"});
+
+    ASSERT_EQ(std::vector<int>(), graph.getDependencies(1));      // Independent
+    ASSERT_EQ(std::vector<int>({0}), graph.getDependencies(2));   // Read after write
+    ASSERT_EQ(std::vector<int>({1}), graph.getDependencies(3));
+    ASSERT_EQ(std::vector<int>({2}), graph.getDependencies(4));
+    ASSERT_EQ(std::vector<int>({2, 4}), graph.getDependencies(5)); // Write after read and write
+}
+
+TEST(TaskGraphTest, Barriers) {
+    electrostatics::TaskGraph graph;
+    graph.addTask(printTask("a"), {}, {"a"});
+    graph.addTask(printTask("b"), {}, {"b"});
+    graph.addTask(printTask("timer"), {}, {}, true);
+    graph.addTask(printTask("c"), {}, {"c"});
+    graph.addTask(printTask("timer"), {}, {}, true);
+    graph.addTask(printTask("a again"), {"a"}, {});
+
+    ASSERT_EQ(std::vector<int>({0, 1}), graph.getDependencies(2));
+    ASSERT_EQ(std::vector<int>({2}), graph.getDependencies(3));
+    ASSERT_EQ(std::vector<int>({2, 3}), graph.getDependencies(4));
+    ASSERT_EQ(std::vector<int>({4}), graph.getDependencies(5));
+}
+
+TEST(TaskGraphTest, OutputInOrder) {
+    for(int threads : {1, 2, 4, 16}) {
+        electrostatics::TaskGraph graph;
+        std::string expected;
+        for(int task=0; task<200; task++) {
+            std::string name = "task" + std::to_string(task);
+            // Later tasks finish first if they run at the same time
+            graph.addTask([name, task](std::ostream &output) {
+                std::this_thread::sleep_for(std::chrono::microseconds((200-task) % 7 * 50));
+                output << name << "\n";
+            }, {}, {name}, task%50 == 49);
+            expected += name + "\n";
+        }
+        std::ostringstream output;
+        graph.run(threads, output);
+        ASSERT_EQ(expected, output.str());
+    }
+}
+
+TEST(TaskGraphTest, RunsAtSameTime) {
+    // Each task waits for the other to start, which only works if they run at once
+    std::atomic<int> started(0);
+    std::atomic<bool> overlapped(false);
+    auto task = [&](std::ostream &output) {
+        started++;
+        for(int wait=0; wait<2000 && started < 2; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if(started == 2) overlapped = true;
+    };
+    electrostatics::TaskGraph graph;
+    graph.addTask(task, {}, {"a"});
+    graph.addTask(task, {}, {"b"});
+    std::ostringstream output;
+    graph.run(2, output);
+    ASSERT_TRUE(overlapped);
+}
+
+TEST(TaskGraphTest, ReadersWaitForWriter) {
+    std::atomic<bool> written(false);
+    std::atomic<int> readsBeforeWrite(0);
+    electrostatics::TaskGraph graph;
+    graph.addTask([&](std::ostream &output) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        written = true;
+    }, {}, {"system"});
+    for(int reader=0; reader<8; reader++) {
+        graph.addTask([&](std::ostream &output) { if(!written) readsBeforeWrite++; }, {"system"}, {});
+    }
+    std::ostringstream output;
+    graph.run(4, output);
+    ASSERT_EQ(0, readsBeforeWrite);
+}
+
+TEST(TaskGraphTest, Exceptions) {
+    for(int threads : {1, 4}) {
+        std::atomic<bool> laterTaskRan(false);
+        electrostatics::TaskGraph graph;
+        graph.addTask(printTask("first"), {}, {"a"});
+        graph.addTask([](std::ostream &output) {
+            output << "failed\n";
+            throw std::out_of_range("Error");
+        }, {}, {"b"});
+        graph.addTask([&](std::ostream &output) { laterTaskRan = true; }, {"b"}, {});
+        std::ostringstream output;
+        ASSERT_THROW(graph.run(threads, output), std::out_of_range);
+        ASSERT_FALSE(laterTaskRan);
+        ASSERT_EQ(0u, output.str().find("first\n"));
+    }
+}
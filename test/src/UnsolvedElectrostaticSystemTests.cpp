@@ -1,5 +1,7 @@
 #include "UnsolvedElectrostaticSystem.h"
 #include <stdexcept>
+#include <cmath>
+#include <vector>
 #include <gtest/gtest.h>
 #include <Eigen/Dense>
 
@@ -40,3 +42,101 @@ TEST_F(UnsolvedElectrostaticSystemTest, IsAndSetBoundary2) {
     ASSERT_EQ(true, system->isBoundaryConditionIJ(ij[0], ij[1]));
     ASSERT_EQ(false, system->isBoundaryConditionK(10));
 }
+
+TEST_F(UnsolvedElectrostaticSystemTest, Electrodes) {
+    ASSERT_EQ(-1, system->getElectrodeIJ(0, 0));
+    system->selectElectrode("plate");
+    system->setLeftBoundary(10);
+    system->selectElectrode("core");
+    system->setBoundaryPoint(0, 0, 3);
+    system->deselectElectrode();
+    system->setBoundaryPoint(1, 1, 4);
+    system->selectElectrode("plate");
+    system->setBoundaryPoint(2, 2, 10);
+
+    ASSERT_EQ(2u, system->getElectrodeNames().size());
+    ASSERT_EQ("plate", system->getElectrodeNames()[0]);
+    ASSERT_EQ(0, system->getElectrodeIJ(-18, 4));
+    ASSERT_EQ(0, system->getElectrodeIJ(2, 2));
+    ASSERT_EQ(1, system->getElectrodeIJ(0, 0));
+    ASSERT_EQ(-1, system->getElectrodeIJ(1, 1));
+    ASSERT_EQ(-1, system->getElectrodeIJ(-3, 1));
+
+    // Removing a boundary condition removes it from its electrode
+    system->setBoundaryConditionIJ(0, 0, false);
+    ASSERT_EQ(-1, system->getElectrodeIJ(0, 0));
+}
+
+TEST_F(UnsolvedElectrostaticSystemTest, CircleClippedToGrid) {
+    // Partly off the grid, with a radius that isn't a whole number
+    system->selectElectrode("core");
+    system->setBoundaryCircle(-1, 3, 5.5, 7);
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) {
+            bool inside = sqrt(pow(i+1, 2) + pow(j-3, 2)) <= 5.5;
+            ASSERT_EQ(inside, system->isBoundaryConditionIJ(i, j));
+            ASSERT_EQ(inside ? 7 : 0, system->getPotentialIJ(i, j));
+            ASSERT_EQ(inside ? 0 : -1, system->getElectrodeIJ(i, j));
+        }
+    }
+
+    // Completely off the grid
+    electrostatics::UnsolvedElectrostaticSystem empty(-18, 2, -8, 6);
+    empty.setBoundaryCircle(100, 100, 20, 1);
+    empty.setBoundaryRing(100, -100, 20, 1);
+    ASSERT_EQ(0, empty.getBoundaryConditionPositions().count());
+}
+
+TEST_F(UnsolvedElectrostaticSystemTest, RingPartlyOffGrid) {
+    system->setBoundaryRing(0, 0, 4, 3);
+    ASSERT_TRUE(system->isBoundaryConditionIJ(-4, 0));
+    ASSERT_TRUE(system->isBoundaryConditionIJ(0, -4));
+    ASSERT_TRUE(system->isBoundaryConditionIJ(0, 4));
+    ASSERT_FALSE(system->isBoundaryConditionIJ(0, 0));
+    ASSERT_FALSE(system->isBoundaryConditionIJ(-2, 1));
+    // 17 of the 24 points of the ring are on the grid (i<=2)
+    ASSERT_EQ(17, system->getBoundaryConditionPositions().count());
+}
+
+TEST_F(UnsolvedElectrostaticSystemTest, LinesOffGrid) {
+    // Lines and rectangles aren't clipped like rings and circles, and set nothing
+    ASSERT_THROW(system->setBoundaryLine(-10, 0, 5, 0, 1), std::out_of_range);
+    ASSERT_THROW(system->setBoundaryLine(0, -20, 0, 0, 1), std::out_of_range);
+    ASSERT_THROW(system->setBoundaryLine(-30, -30, 0, 0, 1), std::out_of_range);
+    ASSERT_THROW(system->setBoundaryRectangle(-10, 0, 3, -9, 1), std::out_of_range);
+    ASSERT_THROW(system->setBoundaryRectangle(-10, 3, 3, -3, 1), std::out_of_range);
+    ASSERT_EQ(0, system->getBoundaryConditionPositions().count());
+    ASSERT_EQ(0, system->getPotentials().cwiseAbs().maxCoeff());
+
+    // The edges of the grid are on it
+    system->setBoundaryRectangle(-18, 2, 6, -8, 1);
+    ASSERT_EQ(2*21 + 2*13, system->getBoundaryConditionPositions().count());
+}
+
+TEST_F(UnsolvedElectrostaticSystemTest, InteriorSpans) {
+    system->setLeftBoundary(1);
+    system->setBoundaryLine(-10, 0, -5, 0, 2);
+    system->setBoundaryPoint(2, 0, 3);
+    system->setTopBoundary(4);
+    electrostatics::RowSpans interior = system->interiorSpans();
+    ASSERT_EQ(16u, interior.rowStarts.size());
+
+    // Every point is in a span exactly when it isn't a boundary condition
+    for(int b=0; b<15; b++) {
+        std::vector<bool> covered(21, false);
+        int previousEnd = -1;
+        for(long span=interior.rowStarts[b]; span<interior.rowStarts[b+1]; span++) {
+            ASSERT_LT(previousEnd, interior.spans[span].start);
+            ASSERT_LT(interior.spans[span].start, interior.spans[span].end);
+            for(int a=interior.spans[span].start; a<interior.spans[span].end; a++) covered[a] = true;
+            previousEnd = interior.spans[span].end;
+        }
+        for(int a=0; a<21; a++) ASSERT_NE(covered[a], system->isBoundaryConditionIJ(a-18, b-8));
+    }
+    // Row j=0 is split by the line into (-17 to -11) and (-4 to 1)
+    ASSERT_EQ(2, interior.rowStarts[9] - interior.rowStarts[8]);
+    ASSERT_EQ(1, interior.spans[interior.rowStarts[8]].start);
+    ASSERT_EQ(20, interior.spans[interior.rowStarts[8]+1].end);
+    // The top row has none
+    ASSERT_EQ(interior.rowStarts[14], interior.rowStarts[15]);
+}
@@ -1,4 +1,6 @@
 #include "analyticalSolutions.h"
+#include "GridView.h"
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(analyticalSolutionsTest, Problem1) {
@@ -31,3 +33,27 @@ TEST(analyticalSolutionsTest, Problem2) {
 TEST(analyticalSolutionsTest, UniformField) {
     ASSERT_EQ(0.1, electrostatics::uniformField(-50, 50, 5, -5));
 }
+
+TEST(analyticalSolutionsTest, Problem2OnAxis) {
+    // The potential is 0 everywhere on the line through the centre perpendicular to the field
+    ASSERT_EQ(0, electrostatics::analyticalProblem2(0, 14, 5.23, 20));
+    ASSERT_EQ(0, electrostatics::analyticalProblem2(0, -30, 5.23, 20));
+}
+
+TEST(analyticalSolutionsTest, Grids) {
+    // The grids must be exactly the same as the single points, including at the centre
+    std::vector<double> potentials(41*31);
+    electrostatics::GridView<double> grid(potentials.data(), -25, -15, 41, 31);
+    electrostatics::analyticalProblem1Grid(grid, 5.23, 20.7, 9, 18);
+    for(int j=-15; j<=15; j++) {
+        for(int i=-25; i<=15; i++) {
+            ASSERT_EQ(electrostatics::analyticalProblem1(i, j, 5.23, 20.7, 9, 18), grid(i, j));
+        }
+    }
+    electrostatics::analyticalProblem2Grid(grid, 5.23, 20);
+    for(int j=-15; j<=15; j++) {
+        for(int i=-25; i<=15; i++) {
+            ASSERT_EQ(electrostatics::analyticalProblem2(i, j, 5.23, 20), grid(i, j));
+        }
+    }
+}
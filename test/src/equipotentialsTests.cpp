@@ -0,0 +1,136 @@
+#include "equipotentials.h"
+#include "GridView.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+class EquipotentialsTest : public ::testing::Test {
+    protected:
+        // Grid from (-20, -15) to (20, 15)
+        std::vector<double> data;
+        electrostatics::GridView<const double> potentials{nullptr, -20, -15, 41, 31};
+
+        virtual void SetUp() {
+            data.resize(41*31);
+            potentials = electrostatics::GridView<const double>(data.data(), -20, -15, 41, 31);
+        }
+
+        void setPotentials(double (*potential)(int i, int j)) {
+            for(int j=-15; j<=15; j++) {
+                for(int i=-20; i<=20; i++) data[(i+20) + (j+15)*41] = potential(i, j);
+            }
+        }
+};
+
+TEST_F(EquipotentialsTest, Levels) {
+    setPotentials([](int i, int j) { return (double)i; });
+    std::vector<double> levels = electrostatics::equipotentialLevels(potentials, 3);
+    ASSERT_EQ(3, (int)levels.size());
+    ASSERT_DOUBLE_EQ(-10, levels[0]);
+    ASSERT_DOUBLE_EQ(0, levels[1]);
+    ASSERT_DOUBLE_EQ(10, levels[2]);
+    ASSERT_THROW(electrostatics::equipotentialLevels(potentials, 0), std::invalid_argument);
+    ASSERT_THROW(electrostatics::findEquipotentials(potentials, levels, 0), std::invalid_argument);
+}
+
+TEST_F(EquipotentialsTest, StraightLines) {
+    // Each level is one open line across the grid, with a point on every row
+    setPotentials([](int i, int j) { return 2.0*i; });
+    std::vector<electrostatics::Equipotential> equipotentials =
+        electrostatics::findEquipotentials(potentials, {-15, 7}, 8);
+    ASSERT_EQ(2, (int)equipotentials.size());
+    ASSERT_EQ(-15, equipotentials[0].potential);
+    ASSERT_EQ(7, equipotentials[1].potential);
+    for(const electrostatics::Equipotential &equipotential : equipotentials) {
+        ASSERT_FALSE(equipotential.closed);
+        ASSERT_EQ(31, (int)equipotential.points.size());
+        std::vector<double> js;
+        for(const electrostatics::ContourPoint &point : equipotential.points) {
+            ASSERT_DOUBLE_EQ(equipotential.potential / 2, point.i);
+            js.push_back(point.j);
+        }
+        // In order from one edge of the grid to the other
+        if(js.front() > js.back()) std::reverse(js.begin(), js.end());
+        for(int n=0; n<31; n++) ASSERT_EQ(n - 15, js[n]);
+    }
+}
+
+TEST_F(EquipotentialsTest, LoopsAcrossTiles) {
+    // Circles that cross the edges of many tiles are joined into single loops
+    setPotentials([](int i, int j) { return (double)(i*i + j*j); });
+    std::vector<double> levels = {20.5, 100.5, 200.5};
+    std::vector<electrostatics::Equipotential> oneTile = electrostatics::findEquipotentials(potentials, levels, 1000);
+    for(int tileSize : {1, 3, 7}) {
+        std::vector<electrostatics::Equipotential> tiled =
+            electrostatics::findEquipotentials(potentials, levels, tileSize);
+        ASSERT_EQ(3, (int)tiled.size());
+        for(int n=0; n<3; n++) {
+            ASSERT_TRUE(tiled[n].closed);
+            ASSERT_EQ(oneTile[n].points.size(), tiled[n].points.size());
+            ASSERT_EQ(tiled[n].points.front().i, tiled[n].points.back().i);
+            ASSERT_EQ(tiled[n].points.front().j, tiled[n].points.back().j);
+            for(const electrostatics::ContourPoint &point : tiled[n].points) {
+                ASSERT_NEAR(sqrt(levels[n]), sqrt(point.i*point.i + point.j*point.j), 0.1);
+            }
+        }
+    }
+}
+
+TEST_F(EquipotentialsTest, Saddle) {
+    // Corners above the level on one diagonal and below it on the other
+    std::vector<double> saddle = {1, 0, 0, 1};
+    electrostatics::GridView<const double> cell(saddle.data(), 0, 0, 2, 2);
+    // Centre above the level, so the corners below it are cut off
+    std::vector<electrostatics::Equipotential> equipotentials = electrostatics::findEquipotentials(cell, {0.4});
+    ASSERT_EQ(2, (int)equipotentials.size());
+    for(const electrostatics::Equipotential &equipotential : equipotentials) {
+        ASSERT_FALSE(equipotential.closed);
+        ASSERT_EQ(2, (int)equipotential.points.size());
+        double i = equipotential.points[0].i + equipotential.points[1].i;
+        double j = equipotential.points[0].j + equipotential.points[1].j;
+        ASSERT_TRUE((i > 1 && j < 1) || (i < 1 && j > 1));
+    }
+    // Centre below the level, so the corners above it are cut off
+    equipotentials = electrostatics::findEquipotentials(cell, {0.6});
+    ASSERT_EQ(2, (int)equipotentials.size());
+    for(const electrostatics::Equipotential &equipotential : equipotentials) {
+        double i = equipotential.points[0].i + equipotential.points[1].i;
+        double j = equipotential.points[0].j + equipotential.points[1].j;
+        ASSERT_TRUE((i < 1 && j < 1) || (i > 1 && j > 1));
+    }
+}
+
+TEST_F(EquipotentialsTest, SaveFile) {
+    setPotentials([](int i, int j) { return (double)(i*i + j*j); });
+    std::vector<electrostatics::Equipotential> equipotentials =
+        electrostatics::findEquipotentials(potentials, {2.5, 100.5});
+    electrostatics::saveEquipotentials(equipotentials, "equipotentialsTest", true);
+
+    std::ifstream file("equipotentialsTest");
+    std::string line;
+    for(int n=0; n<2; n++) {
+        if(n) {
+            std::getline(file, line);
+            ASSERT_EQ("", line);
+        }
+        std::getline(file, line);
+        ASSERT_EQ(std::string("# potential ") + (n ? "100.5" : "2.5") + " closed", line);
+        for(const electrostatics::ContourPoint &point : equipotentials[n].points) {
+            std::getline(file, line);
+            std::istringstream lineStream(line);
+            double i, j;
+            lineStream >> i >> j;
+            ASSERT_EQ(point.i, i);
+            ASSERT_EQ(point.j, j);
+        }
+    }
+    ASSERT_FALSE(std::getline(file, line));
+    file.close();
+    std::remove("equipotentialsTest");
+}
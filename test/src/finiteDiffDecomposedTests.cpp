@@ -0,0 +1,119 @@
+#include "finiteDiffDecomposed.h"
+#include "finiteDiffIterative.h"
+#include "finiteDiffMatrix.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+class FiniteDiffDecomposedTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-30, 20, -15, 12);
+            system->setBoundaryCircle(0, 0, 5, 0);
+            system->setTopBoundary(-100);
+            system->setBottomBoundary(100);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(FiniteDiffDecomposedTest, MatchesSparseLU) {
+    electrostatics::SolvedElectrostaticSystem decomposed(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem sparseLU(-30, 20, -15, 12);
+    electrostatics::finiteDiffDecomposed(*system, decomposed, 3, 1e-10);
+    electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+    for(int i=-30; i<=20; i++) {
+        for(int j=-15; j<=12; j++) {
+            ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), decomposed.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+}
+
+TEST_F(FiniteDiffDecomposedTest, SameAsSOR) {
+    electrostatics::SolvedElectrostaticSystem sor(-30, 20, -15, 12);
+    int sorIterations = electrostatics::finiteDiffSOR(*system, sor, 1e-8);
+    // Including more processes than rows, and uneven blocks
+    for(int processes : {1, 2, 3, 5, 40}) {
+        electrostatics::SolvedElectrostaticSystem decomposed(-30, 20, -15, 12);
+        ASSERT_EQ(sorIterations, electrostatics::finiteDiffDecomposed(*system, decomposed, processes, 1e-8));
+        ASSERT_EQ(sor.getPotentials(), decomposed.getPotentials());
+    }
+}
+
+TEST_F(FiniteDiffDecomposedTest, StopsAtMaxIterations) {
+    electrostatics::SolvedElectrostaticSystem decomposed(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem sor(-30, 20, -15, 12);
+    ASSERT_EQ(5, electrostatics::finiteDiffDecomposed(*system, decomposed, 4, 1e-10, 1.5, 5, nullptr, false));
+    electrostatics::finiteDiffSOR(*system, sor, 1e-10, 1.5, 5);
+    ASSERT_EQ(sor.getPotentials(), decomposed.getPotentials());
+}
+
+TEST_F(FiniteDiffDecomposedTest, WarmStart) {
+    electrostatics::SolvedElectrostaticSystem cold(-30, 20, -15, 12);
+    electrostatics::finiteDiffDecomposed(*system, cold, 2, 1e-10);
+    electrostatics::SolvedElectrostaticSystem warm(-30, 20, -15, 12);
+    ASSERT_EQ(1, electrostatics::finiteDiffDecomposed(*system, warm, 2, 1e-6, 0, 1000000, &cold));
+
+    electrostatics::SolvedElectrostaticSystem wrongSize(-30, 20, -15, 11);
+    ASSERT_THROW(electrostatics::finiteDiffDecomposed(*system, warm, 2, 1e-8, 0, 1000000, &wrongSize),
+            std::invalid_argument);
+}
+
+/* Kills the first child process of this process that it finds. */
+static bool killChild() {
+    DIR *processes = opendir("/proc");
+    if(!processes) return false;
+    bool killed = false;
+    while(dirent *entry = readdir(processes)) {
+        pid_t pid = atoi(entry->d_name);
+        if(pid <= 0) continue;
+        std::ifstream stat(std::string("/proc/") + entry->d_name + "/stat");
+        std::string line;
+        std::getline(stat, line);
+        // The parent's pid is the second field after the command name in brackets
+        size_t nameEnd = line.rfind(')');
+        if(nameEnd == std::string::npos) continue;
+        std::istringstream fields(line.substr(nameEnd + 2));
+        std::string state;
+        pid_t parent = 0;
+        fields >> state >> parent;
+        if(parent == getpid() && kill(pid, SIGKILL) == 0) {
+            killed = true;
+            break;
+        }
+    }
+    closedir(processes);
+    return killed;
+}
+
+TEST_F(FiniteDiffDecomposedTest, WorkerKilled) {
+    // Big enough, with a tolerance small enough, that the solve is still running when a worker is killed
+    electrostatics::UnsolvedElectrostaticSystem big(-300, 300, -300, 300);
+    big.setBoundaryCircle(0, 0, 20, 100);
+    electrostatics::SolvedElectrostaticSystem decomposed(-300, 300, -300, 300);
+    std::atomic<bool> killed(false);
+    std::thread killer([&killed] {
+        for(int attempt=0; attempt<10000 && !killed; attempt++) {
+            killed = killChild();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    ASSERT_THROW(electrostatics::finiteDiffDecomposed(big, decomposed, 3, 0, 0, 1000000), std::runtime_error);
+    killer.join();
+    ASSERT_TRUE(killed);
+}
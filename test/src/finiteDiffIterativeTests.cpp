@@ -0,0 +1,97 @@
+#include "finiteDiffIterative.h"
+#include "finiteDiffMatrix.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <gtest/gtest.h>
+
+class FiniteDiffSORTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-30, 20, -15, 12);
+            system->setBoundaryCircle(0, 0, 5, 0);
+            system->setTopBoundary(-100);
+            system->setBottomBoundary(100);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(FiniteDiffSORTest, MatchesSparseLU) {
+    electrostatics::SolvedElectrostaticSystem sor(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem sparseLU(-30, 20, -15, 12);
+    electrostatics::finiteDiffSOR(*system, sor, 1e-10);
+    electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+    for(int i=-30; i<=20; i++) {
+        for(int j=-15; j<=12; j++) {
+            ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), sor.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+}
+
+TEST_F(FiniteDiffSORTest, StopsAtTolerance) {
+    electrostatics::SolvedElectrostaticSystem loose(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem tight(-30, 20, -15, 12);
+    int looseIterations = electrostatics::finiteDiffSOR(*system, loose, 1e-2);
+    int tightIterations = electrostatics::finiteDiffSOR(*system, tight, 1e-10);
+    ASSERT_LT(looseIterations, tightIterations);
+    ASSERT_LT(tightIterations, 2000);
+}
+
+TEST_F(FiniteDiffSORTest, StopsAtMaxIterations) {
+    electrostatics::SolvedElectrostaticSystem solved(-30, 20, -15, 12);
+    ASSERT_EQ(5, electrostatics::finiteDiffSOR(*system, solved, 1e-10, 1.5, 5));
+}
+
+TEST_F(FiniteDiffSORTest, DefaultOmega) {
+    // An omega outside (0, 2) means the optimal one for the grid
+    double omega = electrostatics::optimalOmega(51, 28);
+    ASSERT_GT(omega, 1);
+    ASSERT_LT(omega, 2);
+    electrostatics::SolvedElectrostaticSystem chosen(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem given(-30, 20, -15, 12);
+    ASSERT_EQ(electrostatics::finiteDiffSOR(*system, chosen, 1e-8),
+            electrostatics::finiteDiffSOR(*system, given, 1e-8, omega));
+    ASSERT_EQ(chosen.getPotentials(), given.getPotentials());
+}
+
+TEST_F(FiniteDiffSORTest, WarmStart) {
+    electrostatics::SolvedElectrostaticSystem cold(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem warm(-30, 20, -15, 12);
+    int coldIterations = electrostatics::finiteDiffSOR(*system, cold, 1e-10);
+
+    // A small change to the voltages converges quickly from the old solution
+    system->setTopBoundary(-99);
+    int warmIterations = electrostatics::finiteDiffSOR(*system, warm, 1e-10, 0, 1000000, &cold);
+    ASSERT_LT(warmIterations, coldIterations);
+    ASSERT_EQ(-99, warm.getPotentialIJ(0, 12));
+
+    // Starting from the solution itself takes a single iteration
+    electrostatics::SolvedElectrostaticSystem again(-30, 20, -15, 12);
+    ASSERT_EQ(1, electrostatics::finiteDiffSOR(*system, again, 1e-6, 0, 1000000, &warm));
+}
+
+TEST_F(FiniteDiffSORTest, WrongSizeGuess) {
+    electrostatics::SolvedElectrostaticSystem solved(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem guess(-30, 20, -15, 11);
+    ASSERT_THROW(electrostatics::finiteDiffSOR(*system, solved, 1e-8, 0, 1000000, &guess),
+            std::invalid_argument);
+    ASSERT_THROW(electrostatics::finiteDiffIterative(*system, solved, 10, &guess), std::invalid_argument);
+}
+
+TEST_F(FiniteDiffSORTest, MixedPrecisionMatchesSparseLU) {
+    electrostatics::SolvedElectrostaticSystem mixed(-30, 20, -15, 12);
+    electrostatics::SolvedElectrostaticSystem sparseLU(-30, 20, -15, 12);
+    electrostatics::finiteDiffSORMixed(*system, mixed, 1e-10);
+    electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+    for(int i=-30; i<=20; i++) {
+        for(int j=-15; j<=12; j++) {
+            ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), mixed.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+    ASSERT_EQ(-100, mixed.getPotentialIJ(0, 12));
+}
@@ -0,0 +1,137 @@
+#include "finiteDiffMatrix.h"
+#include "stencilOperator.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <vector>
+#include <stdexcept>
+
+class FiniteDiffMatrixTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-15, 15, -10, 10);
+            system->setBoundaryCircle(0, 0, 4, 0);
+            system->setBoundaryRing(0, 0, 9, 100);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+
+        void expectMatchesSparseLU(std::string method) {
+            electrostatics::SolvedElectrostaticSystem solved(-15, 15, -10, 10);
+            electrostatics::SolvedElectrostaticSystem sparseLU(-15, 15, -10, 10);
+            electrostatics::finiteDiffMatrix(*system, solved, method);
+            electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+            for(int i=-15; i<=15; i++) {
+                for(int j=-10; j<=10; j++) {
+                    ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), solved.getPotentialIJ(i, j), 1e-8);
+                }
+            }
+        }
+};
+
+TEST_F(FiniteDiffMatrixTest, ReducedSystemIsSymmetric) {
+    Eigen::SparseMatrix<double> A;
+    Eigen::VectorXd b;
+    std::vector<long> unknownPositions;
+    electrostatics::reducedSystem(*system, A, b, unknownPositions);
+
+    long boundaryPoints = 0;
+    for(long k=0; k<=system->getKMax(); k++) {
+        if(system->isBoundaryConditionK(k)) boundaryPoints++;
+    }
+    ASSERT_EQ(system->getKMax()+1-boundaryPoints, A.rows());
+    ASSERT_EQ((long)unknownPositions.size(), A.rows());
+    ASSERT_TRUE(A.isCompressed());
+    Eigen::SparseMatrix<double> difference = A - Eigen::SparseMatrix<double>(A.transpose());
+    ASSERT_EQ(0, difference.norm());
+    // Bottom left corner has two surrounding points, both unknowns
+    ASSERT_EQ(2, A.coeff(0, 0));
+    ASSERT_EQ(-1, A.coeff(1, 0));
+    ASSERT_EQ(-1, A.coeff(31, 0));
+    ASSERT_EQ(0, b(0));
+}
+
+TEST_F(FiniteDiffMatrixTest, ConjugateGradientMatchesSparseLU) {
+    expectMatchesSparseLU("eigencg");
+}
+
+TEST_F(FiniteDiffMatrixTest, LDLTMatchesSparseLU) {
+    expectMatchesSparseLU("eigenldlt");
+}
+
+TEST_F(FiniteDiffMatrixTest, MixedPrecisionMatchesSparseLU) {
+    expectMatchesSparseLU("eigencgmixed");
+    expectMatchesSparseLU("eigenbiconmixed");
+
+    // Refined to double precision accuracy, not single
+    electrostatics::SolvedElectrostaticSystem mixed(-15, 15, -10, 10);
+    electrostatics::finiteDiffMatrix(*system, mixed, "eigencgmixed");
+    ASSERT_LT(electrostatics::relativeResidual(*system, mixed), 1e-10);
+}
+
+TEST_F(FiniteDiffMatrixTest, SparseLUReusesFactorization) {
+    electrostatics::clearFactorizationCache();
+    electrostatics::SolvedElectrostaticSystem first(-15, 15, -10, 10);
+    electrostatics::finiteDiffMatrix(*system, first, "eigensparselu");
+    long hits = electrostatics::factorizationCacheHits();
+    long misses = electrostatics::factorizationCacheMisses();
+
+    // Same boundary condition positions with different potentials is a hit
+    electrostatics::UnsolvedElectrostaticSystem newPotentials(-15, 15, -10, 10);
+    newPotentials.setBoundaryCircle(0, 0, 4, -30);
+    newPotentials.setBoundaryRing(0, 0, 9, 70);
+    electrostatics::SolvedElectrostaticSystem cached(-15, 15, -10, 10);
+    electrostatics::SolvedElectrostaticSystem ldlt(-15, 15, -10, 10);
+    electrostatics::finiteDiffMatrix(newPotentials, cached, "eigensparselu");
+    ASSERT_EQ(hits+1, electrostatics::factorizationCacheHits());
+    ASSERT_EQ(misses, electrostatics::factorizationCacheMisses());
+    electrostatics::finiteDiffMatrix(newPotentials, ldlt, "eigenldlt");
+    for(int i=-15; i<=15; i++) {
+        for(int j=-10; j<=10; j++) {
+            ASSERT_NEAR(ldlt.getPotentialIJ(i, j), cached.getPotentialIJ(i, j), 1e-8);
+        }
+    }
+
+    // A new boundary condition is a miss
+    newPotentials.setBoundaryPoint(12, 0, 5);
+    electrostatics::finiteDiffMatrix(newPotentials, cached, "eigensparselu");
+    ASSERT_EQ(hits+1, electrostatics::factorizationCacheHits());
+    ASSERT_EQ(misses+1, electrostatics::factorizationCacheMisses());
+    ASSERT_EQ(5, cached.getPotentialIJ(12, 0));
+}
+
+TEST_F(FiniteDiffMatrixTest, InitialGuess) {
+    electrostatics::SolvedElectrostaticSystem guess(-15, 15, -10, 10);
+    electrostatics::finiteDiffMatrix(*system, guess, "eigensparselu");
+    system->setBoundaryRing(0, 0, 9, 101);
+    const char* methods[] = {"eigenbicon", "eigenbiconmatrixfree", "eigencg", "eigencgmixed", "viennabicon"};
+    for(const char* method : methods) {
+        electrostatics::SolvedElectrostaticSystem solved(-15, 15, -10, 10);
+        electrostatics::SolvedElectrostaticSystem sparseLU(-15, 15, -10, 10);
+        electrostatics::finiteDiffMatrix(*system, solved, method, &guess);
+        electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+        for(int i=-15; i<=15; i++) {
+            for(int j=-10; j<=10; j++) {
+                ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), solved.getPotentialIJ(i, j), 1e-5) << method;
+            }
+        }
+    }
+}
+
+TEST_F(FiniteDiffMatrixTest, SparseLUFailureThrows) {
+    // A single point that isn't a boundary condition has no equation at all
+    electrostatics::UnsolvedElectrostaticSystem noBoundaries(0, 0, 0, 0);
+    electrostatics::SolvedElectrostaticSystem solved(0, 0, 0, 0);
+    ASSERT_THROW(electrostatics::finiteDiffMatrix(noBoundaries, solved, "eigensparselu"), std::runtime_error);
+
+    // The failed factorization isn't reused
+    long misses = electrostatics::factorizationCacheMisses();
+    ASSERT_THROW(electrostatics::finiteDiffMatrix(noBoundaries, solved, "eigensparselu"), std::runtime_error);
+    ASSERT_EQ(misses+1, electrostatics::factorizationCacheMisses());
+}
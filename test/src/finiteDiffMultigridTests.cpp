@@ -0,0 +1,83 @@
+#include "finiteDiffMultigrid.h"
+#include "finiteDiffMatrix.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <gtest/gtest.h>
+
+class FiniteDiffMultigridTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-40, 33, -20, 25);
+            system->setBoundaryCircle(-10, 0, 6, 0);
+            system->setBoundaryRing(15, 5, 9, 30);
+            system->setLeftBoundary(50);
+            system->setRightBoundary(-50);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(FiniteDiffMultigridTest, MatchesSparseLU) {
+    electrostatics::SolvedElectrostaticSystem multigrid(-40, 33, -20, 25);
+    electrostatics::SolvedElectrostaticSystem sparseLU(-40, 33, -20, 25);
+    electrostatics::finiteDiffMultigrid(*system, multigrid, 1e-12);
+    electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+    for(int i=-40; i<=33; i++) {
+        for(int j=-20; j<=25; j++) {
+            ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), multigrid.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+}
+
+TEST_F(FiniteDiffMultigridTest, KeepsBoundaryConditions) {
+    electrostatics::SolvedElectrostaticSystem multigrid(-40, 33, -20, 25);
+    electrostatics::finiteDiffMultigrid(*system, multigrid);
+    ASSERT_EQ(50, multigrid.getPotentialIJ(-40, 3));
+    ASSERT_EQ(-50, multigrid.getPotentialIJ(33, -20));
+    ASSERT_EQ(0, multigrid.getPotentialIJ(-10, 0));
+    ASSERT_EQ(30, multigrid.getPotentialIJ(24, 5));
+}
+
+TEST_F(FiniteDiffMultigridTest, ConvergesInFewCycles) {
+    electrostatics::SolvedElectrostaticSystem multigrid(-40, 33, -20, 25);
+    int cycles = electrostatics::finiteDiffMultigrid(*system, multigrid, 1e-8);
+    ASSERT_GT(cycles, 0);
+    ASSERT_LT(cycles, 30);
+}
+
+TEST_F(FiniteDiffMultigridTest, WarmStart) {
+    electrostatics::SolvedElectrostaticSystem cold(-40, 33, -20, 25);
+    electrostatics::SolvedElectrostaticSystem coarse(-40, 33, -20, 25);
+    electrostatics::SolvedElectrostaticSystem warm(-40, 33, -20, 25);
+    int coldCycles = electrostatics::finiteDiffMultigrid(*system, cold, 1e-10);
+    electrostatics::coarseGridGuess(*system, coarse);
+    int warmCycles = electrostatics::finiteDiffMultigrid(*system, warm, 1e-10, 100, &coarse);
+    ASSERT_LT(warmCycles, coldCycles);
+    ASSERT_EQ(30, coarse.getPotentialIJ(24, 5));
+    ASSERT_LT((cold.getPotentials()-coarse.getPotentials()).norm(), 0.1*cold.getPotentials().norm());
+    for(int i=-40; i<=33; i++) {
+        for(int j=-20; j<=25; j++) {
+            ASSERT_NEAR(cold.getPotentialIJ(i, j), warm.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+}
+
+TEST_F(FiniteDiffMultigridTest, CoarseGuessKeepsThinBoundaries) {
+    // A line one point thick, only on odd points of the full grid, between grounded plates
+    electrostatics::UnsolvedElectrostaticSystem thin(0, 40, 0, 30);
+    thin.setLeftBoundary(0);
+    thin.setRightBoundary(0);
+    thin.setBoundaryLine(21, 5, 21, 25, 100);
+    electrostatics::SolvedElectrostaticSystem coarse(0, 40, 0, 30);
+    electrostatics::SolvedElectrostaticSystem sparseLU(0, 40, 0, 30);
+    electrostatics::coarseGridGuess(thin, coarse);
+    electrostatics::finiteDiffMatrix(thin, sparseLU, "eigensparselu");
+    ASSERT_EQ(100, coarse.getPotentialIJ(21, 15));
+    // Next to the line the guess is close to the solution (it was 0 when the line was lost)
+    ASSERT_NEAR(sparseLU.getPotentialIJ(20, 15), coarse.getPotentialIJ(20, 15), 10);
+    ASSERT_NEAR(sparseLU.getPotentialIJ(23, 15), coarse.getPotentialIJ(23, 15), 10);
+}
@@ -0,0 +1,101 @@
+#include "phaseTimer.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+static const electrostatics::PhaseTiming* findPhase(const std::vector<electrostatics::PhaseTiming> &timings,
+        std::string name) {
+    for(const electrostatics::PhaseTiming &timing : timings) {
+        if(timing.name == name) return &timing;
+    }
+    return nullptr;
+}
+
+TEST(PhaseTimerTest, RecordsWallClockTime) {
+    electrostatics::resetPhaseTimings();
+    for(int call=0; call<3; call++) {
+        electrostatics::ScopedPhase phase("test: sleep");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10*(call+1)));
+    }
+    {
+        electrostatics::ScopedPhase phase("test: stopped early");
+        phase.stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    std::vector<electrostatics::PhaseTiming> timings = electrostatics::phaseTimings();
+    ASSERT_EQ(2u, timings.size());
+    ASSERT_EQ("test: sleep", timings[0].name);   // In the order they were first recorded
+    ASSERT_EQ(3, timings[0].calls);
+    ASSERT_GE(timings[0].totalSeconds, 0.06);
+    ASSERT_GE(timings[0].maxSeconds, 0.03);
+    ASSERT_LT(timings[0].maxSeconds, timings[0].totalSeconds);
+    ASSERT_EQ(1, timings[1].calls);
+    ASSERT_LT(timings[1].totalSeconds, 0.02);
+
+    electrostatics::resetPhaseTimings();
+    ASSERT_TRUE(electrostatics::phaseTimings().empty());
+}
+
+TEST(PhaseTimerTest, SeveralThreads) {
+    electrostatics::resetPhaseTimings();
+    std::vector<std::thread> threads;
+    for(int thread=0; thread<4; thread++) {
+        threads.emplace_back([]() {
+            for(int call=0; call<1000; call++) electrostatics::ScopedPhase phase("test: threads");
+        });
+    }
+    for(std::thread &thread : threads) thread.join();
+    ASSERT_EQ(4000, findPhase(electrostatics::phaseTimings(), "test: threads")->calls);
+}
+
+TEST(PhaseTimerTest, Reports) {
+    electrostatics::resetPhaseTimings();
+    electrostatics::recordPhase("test: first", 1.5);
+    electrostatics::recordPhase("test: first", 0.5);
+    electrostatics::recordPhase("test: second", 0.25);
+
+    std::ostringstream table;
+    electrostatics::printPhaseReport(table);
+    ASSERT_NE(std::string::npos, table.str().find("test: first         2     2.000000     1.000000     1.500000"));
+    ASSERT_NE(std::string::npos, table.str().find("test: second        1     0.250000"));
+
+    std::string fileName = ::testing::TempDir() + "phaseTimerTest.json";
+    electrostatics::savePhaseReportJSON(fileName);
+    std::ifstream file(fileName);
+    std::stringstream json;
+    json << file.rdbuf();
+    ASSERT_NE(std::string::npos, json.str().find(
+                "{\"name\": \"test: first\", \"calls\": 2, \"totalSeconds\": 2, \"maxSeconds\": 1.5}"));
+    std::remove(fileName.c_str());
+
+    ASSERT_THROW(electrostatics::savePhaseReportJSON("/nonexistent/directory/report.json"), std::runtime_error);
+    electrostatics::resetPhaseTimings();
+}
+
+TEST(PhaseTimerTest, NamesFromConfig) {
+    // Phase names can be any command in a .cfg file
+    electrostatics::resetPhaseTimings();
+    std::string longName = "command: " + std::string(300, 'x');
+    electrostatics::recordPhase(longName.c_str(), 0.5);
+    electrostatics::recordPhase("command: \"quoted\\\t", 0.25);
+
+    std::ostringstream table;
+    electrostatics::printPhaseReport(table);
+    ASSERT_NE(std::string::npos, table.str().find(longName + "        1     0.500000     0.500000     0.500000\n"));
+
+    std::string fileName = ::testing::TempDir() + "phaseTimerTest.json";
+    electrostatics::savePhaseReportJSON(fileName);
+    std::ifstream file(fileName);
+    std::stringstream json;
+    json << file.rdbuf();
+    ASSERT_NE(std::string::npos, json.str().find("{\"name\": \"command: \\\"quoted\\\\\\u0009\", \"calls\": 1"));
+    std::remove(fileName.c_str());
+    electrostatics::resetPhaseTimings();
+}
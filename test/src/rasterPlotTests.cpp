@@ -0,0 +1,124 @@
+#include "rasterPlot.h"
+#include "SolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <utility>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+class RasterPlotTest : public ::testing::Test {
+    protected:
+        electrostatics::SolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            // Potential going up from 0 at i=-10 to 20 at i=10
+            system = new electrostatics::SolvedElectrostaticSystem(-10, 10, -5, 4);
+            for(int i=-10; i<=10; i++) {
+                for(int j=-5; j<=4; j++) system->setPotentialIJ(i, j, i+10);
+            }
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+static std::vector<unsigned char> readFile(std::string fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST_F(RasterPlotTest, FullSize) {
+    electrostatics::RasterImage image = electrostatics::renderPotentials(std::as_const(*system).potentialView(), 100, 100);
+    ASSERT_EQ(1, image.pointsPerPixel);
+    ASSERT_EQ(21, image.width);
+    ASSERT_EQ(10, image.height);
+    ASSERT_EQ(0, image.minPotential);
+    ASSERT_EQ(20, image.maxPotential);
+    ASSERT_EQ(21*10*3, (int)image.rgb.size());
+
+    // The ends of the palette
+    ASSERT_EQ(0xFF, image.rgb[0]);
+    ASSERT_EQ(0xFF, image.rgb[1]);
+    ASSERT_EQ(0xD9, image.rgb[2]);
+    ASSERT_EQ(0x0C, image.rgb[20*3]);
+    ASSERT_EQ(0x2C, image.rgb[20*3 + 1]);
+    ASSERT_EQ(0x84, image.rgb[20*3 + 2]);
+}
+
+TEST_F(RasterPlotTest, Downsampled) {
+    // Blocks of 3 by 3 points keep the shape of the grid, the last blocks are partial
+    system->setPotentialIJ(-10, 4, 9);
+    electrostatics::RasterImage image = electrostatics::renderPotentials(std::as_const(*system).potentialView(), 10, 10);
+    ASSERT_EQ(3, image.pointsPerPixel);
+    ASSERT_EQ(7, image.width);
+    ASSERT_EQ(4, image.height);
+    ASSERT_DOUBLE_EQ(2, image.potentials[0*7 + 0]);
+    ASSERT_DOUBLE_EQ(19, image.potentials[3*7 + 6]);
+    ASSERT_DOUBLE_EQ(1, image.potentials[1*7 + 0]);
+    ASSERT_DOUBLE_EQ(19, image.potentials[0*7 + 6]);
+}
+
+TEST_F(RasterPlotTest, ContoursAndArrows) {
+    electrostatics::RasterImage image = electrostatics::renderPotentials(std::as_const(*system).potentialView(), 100, 100);
+    std::vector<unsigned char> plain = image.rgb;
+    electrostatics::drawEquipotentials(image, electrostatics::findEquipotentials(std::as_const(*system).potentialView(), {10}));
+    // The equipotential at 10 is the column of pixels at i=0, from the top to the bottom
+    for(int y : {0, 9}) {
+        for(int x=0; x<21; x++) {
+            long pixel = (long)y*21 + x;
+            bool red = image.rgb[pixel*3] == 0xFF && image.rgb[pixel*3 + 1] == 0 && image.rgb[pixel*3 + 2] == 0;
+            ASSERT_EQ(x == 10, red);
+        }
+    }
+
+    electrostatics::drawFieldArrows(image, *system, 5);
+    ASSERT_NE(plain, image.rgb);
+    ASSERT_THROW(electrostatics::drawFieldArrows(image, *system, 0), std::invalid_argument);
+}
+
+TEST_F(RasterPlotTest, SinglePrecision) {
+    // Floats (eg a solution stored with storefloat) are drawn without copying them to doubles
+    std::vector<float> floats(system->getPotentials().data(), system->getPotentials().data() + 21*10);
+    electrostatics::GridView<const float> floatView(floats.data(), -10, -5, 21, 10);
+    electrostatics::RasterImage image = electrostatics::renderPotentials(std::as_const(*system).potentialView(), 10, 10);
+    electrostatics::RasterImage floatImage = electrostatics::renderPotentials(floatView, 10, 10);
+    ASSERT_EQ(image.potentials, floatImage.potentials);
+    ASSERT_EQ(image.rgb, floatImage.rgb);
+
+    std::vector<double> levels = electrostatics::equipotentialLevels(floatView, 3);
+    ASSERT_EQ(electrostatics::equipotentialLevels(std::as_const(*system).potentialView(), 3), levels);
+    std::vector<electrostatics::Equipotential> equipotentials = electrostatics::findEquipotentials(floatView, levels);
+    ASSERT_EQ(3, (int)equipotentials.size());
+    for(const electrostatics::ContourPoint &point : equipotentials[1].points) ASSERT_DOUBLE_EQ(0, point.i);
+}
+
+TEST_F(RasterPlotTest, SaveFiles) {
+    electrostatics::RasterImage image = electrostatics::renderPotentials(std::as_const(*system).potentialView(), 100, 100);
+    electrostatics::savePPM(image, "rasterPlotTest.ppm");
+    std::vector<unsigned char> ppm = readFile("rasterPlotTest.ppm");
+    std::string header = "P6\n21 10\n255\n";
+    ASSERT_EQ(header.size() + image.rgb.size(), ppm.size());
+    ASSERT_TRUE(std::equal(header.begin(), header.end(), ppm.begin()));
+    std::remove("rasterPlotTest.ppm");
+
+    electrostatics::savePNG(image, "rasterPlotTest.png");
+    std::vector<unsigned char> png = readFile("rasterPlotTest.png");
+    std::vector<unsigned char> signature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    ASSERT_TRUE(std::equal(signature.begin(), signature.end(), png.begin()));
+    // IHDR chunk: length, type, width and height (big endian), 8 bit RGB
+    std::vector<unsigned char> ihdr = {0, 0, 0, 13, 'I', 'H', 'D', 'R', 0, 0, 0, 21, 0, 0, 0, 10, 8, 2, 0, 0, 0};
+    ASSERT_TRUE(std::equal(ihdr.begin(), ihdr.end(), png.begin() + 8));
+    // CRC of the IHDR chunk, found with zlib's crc32
+    std::vector<unsigned char> crc = {0xD4, 0xF5, 0x82, 0x8F};
+    ASSERT_TRUE(std::equal(crc.begin(), crc.end(), png.begin() + 29));
+    // Ends with an empty IEND chunk
+    std::vector<unsigned char> iend = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82};
+    ASSERT_TRUE(std::equal(iend.begin(), iend.end(), png.end() - 12));
+    std::remove("rasterPlotTest.png");
+
+    ASSERT_THROW(electrostatics::savePNG(image, "no/such/directory.png"), std::runtime_error);
+}
@@ -0,0 +1,137 @@
+#include "solutionFile.h"
+#include "ElectrostaticSystem.h"
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+class SolutionFileTest : public ::testing::Test {
+    protected:
+        electrostatics::ElectrostaticSystem* system;
+        std::string fileName;
+
+        virtual void SetUp() {
+            system = new electrostatics::ElectrostaticSystem(-18, 2, -8, 6);
+            for(long k=0; k<=system->getKMax(); k++) system->setPotentialK(k, k / 3.0 - 40);
+            fileName = ::testing::TempDir() + "solutionFileTest.bin";
+        }
+
+        virtual void TearDown() {
+            delete system;
+            std::remove(fileName.c_str());
+        }
+};
+
+TEST_F(SolutionFileTest, DoubleRoundTrip) {
+    electrostatics::saveSolutionFile(*system, fileName);
+    electrostatics::MappedSolutionFile solutionFile(fileName);
+    ASSERT_FALSE(solutionFile.isSinglePrecision());
+    ASSERT_EQ(-18, solutionFile.getIMin());
+    ASSERT_EQ(2, solutionFile.getIMax());
+    ASSERT_EQ(-8, solutionFile.getJMin());
+    ASSERT_EQ(6, solutionFile.getJMax());
+
+    electrostatics::GridView<const double> potentials = solutionFile.potentialView();
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) {
+            ASSERT_EQ(system->getPotentialIJ(i, j), potentials(i, j));
+            ASSERT_EQ(system->getPotentialIJ(i, j), solutionFile.getPotentialIJ(i, j));
+        }
+    }
+
+    electrostatics::ElectrostaticSystem copy(-18, 2, -8, 6);
+    solutionFile.copyTo(copy);
+    ASSERT_TRUE(copy.getPotentials() == system->getPotentials());
+}
+
+TEST_F(SolutionFileTest, FloatRoundTrip) {
+    electrostatics::saveSolutionFile(*system, fileName, true);
+    electrostatics::MappedSolutionFile solutionFile(fileName);
+    ASSERT_TRUE(solutionFile.isSinglePrecision());
+    ASSERT_THROW(solutionFile.potentialView(), std::logic_error);
+
+    electrostatics::GridView<const float> potentials = solutionFile.singlePrecisionView();
+    electrostatics::ElectrostaticSystem copy(-18, 2, -8, 6);
+    solutionFile.copyTo(copy);
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) {
+            ASSERT_EQ((float)system->getPotentialIJ(i, j), potentials(i, j));
+            ASSERT_NEAR(system->getPotentialIJ(i, j), copy.getPotentialIJ(i, j), 1e-5);
+        }
+    }
+}
+
+TEST_F(SolutionFileTest, InMemory) {
+    electrostatics::MappedSolutionFile singlePrecision(*system, true);
+    electrostatics::MappedSolutionFile doublePrecision(*system, false);
+    ASSERT_TRUE(singlePrecision.isSinglePrecision());
+    ASSERT_FALSE(doublePrecision.isSinglePrecision());
+    ASSERT_EQ(-8, singlePrecision.getJMin());
+    ASSERT_EQ(2, doublePrecision.getIMax());
+
+    electrostatics::GridView<const float> floats = singlePrecision.singlePrecisionView();
+    electrostatics::GridView<const double> doubles = doublePrecision.potentialView();
+    for(int i=-18; i<=2; i++) {
+        for(int j=-8; j<=6; j++) {
+            ASSERT_EQ((float)system->getPotentialIJ(i, j), floats(i, j));
+            ASSERT_EQ(system->getPotentialIJ(i, j), doubles(i, j));
+        }
+    }
+}
+
+TEST_F(SolutionFileTest, FileSize) {
+    electrostatics::saveSolutionFile(*system, fileName);
+    std::ifstream savedFile(fileName.c_str(), std::ios::binary | std::ios::ate);
+    ASSERT_EQ(64 + 8*(system->getKMax()+1), savedFile.tellg());
+}
+
+TEST_F(SolutionFileTest, InvalidFiles) {
+    ASSERT_THROW(electrostatics::MappedSolutionFile(fileName + "missing"), std::runtime_error);
+
+    // Not a solution file
+    std::ofstream textFile(fileName.c_str());
+    textFile << "1 2 3\n4 5 6\n";
+    textFile.close();
+    ASSERT_THROW(electrostatics::MappedSolutionFile solutionFile(fileName), std::runtime_error);
+
+    // Cut short
+    electrostatics::saveSolutionFile(*system, fileName);
+    std::string truncated = fileName + "truncated";
+    std::ifstream savedFile(fileName.c_str(), std::ios::binary);
+    std::ofstream truncatedFile(truncated.c_str(), std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(savedFile)), std::istreambuf_iterator<char>());
+    truncatedFile << contents.substr(0, contents.size()-8);
+    truncatedFile.close();
+    ASSERT_THROW(electrostatics::MappedSolutionFile solutionFile(truncated), std::runtime_error);
+    std::remove(truncated.c_str());
+}
+
+TEST_F(SolutionFileTest, WrongDimensions) {
+    electrostatics::saveSolutionFile(*system, fileName);
+    electrostatics::MappedSolutionFile solutionFile(fileName);
+    electrostatics::ElectrostaticSystem other(-18, 2, -8, 5);
+    ASSERT_THROW(solutionFile.copyTo(other), std::invalid_argument);
+    ASSERT_THROW(solutionFile.getPotentialIJ(3, 0), std::out_of_range);
+}
+
+TEST_F(SolutionFileTest, DifferenceFromFile) {
+    electrostatics::saveSolutionFile(*system, fileName);
+    electrostatics::MappedSolutionFile solutionFile(fileName);
+    electrostatics::ElectrostaticSystem other(-18, 2, -8, 6);
+    electrostatics::ElectrostaticSystem difference(-18, 2, -8, 6);
+    other.setPotentialIJ(0, 0, 1000);
+    difference.setDifference(solutionFile.potentialView(), std::as_const(other).potentialView());
+    ASSERT_DOUBLE_EQ(std::abs(1000 - system->getPotentialIJ(0, 0)), difference.getPotentialIJ(0, 0));
+    ASSERT_DOUBLE_EQ(std::abs(system->getPotentialIJ(-18, -8)), difference.getPotentialIJ(-18, -8));
+
+    // A solution stored as floats is compared without copying it to doubles
+    electrostatics::MappedSolutionFile singlePrecision(*system, true);
+    difference.setDifference(singlePrecision.singlePrecisionView(), std::as_const(other).potentialView());
+    ASSERT_NEAR(std::abs(1000 - system->getPotentialIJ(0, 0)), difference.getPotentialIJ(0, 0), 1e-3);
+
+    electrostatics::ElectrostaticSystem small(-18, 2, -8, 5);
+    ASSERT_THROW(small.setDifference(solutionFile.potentialView(), std::as_const(other).potentialView()),
+            std::invalid_argument);
+}
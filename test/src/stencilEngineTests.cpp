@@ -0,0 +1,114 @@
+#include "stencilEngine.h"
+#include "finiteDiffIterative.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+
+class StencilEngineTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-37, 30, -21, 18);
+            system->setBoundaryCircle(-10, 0, 6, 13.7);
+            system->setBoundaryRing(12, 3, 8, -4.1);
+            system->setBoundaryPoint(-37, 5, 2);
+            system->setBoundaryPoint(30, -21, 1);
+            system->setTopBoundary(9.3);
+        }
+
+        virtual void TearDown() {
+            delete system;
+            electrostatics::useStencilInstructionSet(defaultInstructionSet);
+        }
+
+        /* Jacobi iterations checking whether each neighbour is inside the grid. */
+        electrostatics::doubleGrid referenceJacobi(int iterations) {
+            int lengthI = system->getLengthI();
+            int lengthJ = system->getLengthJ();
+            electrostatics::doubleGrid from = system->startingPotentials(nullptr);
+            electrostatics::doubleGrid to = from;
+            const electrostatics::boolGrid &fixed = system->getBoundaryConditionPositions();
+            for(int iter=0; iter<iterations; iter++) {
+                for(int b=0; b<lengthJ; b++) {
+                    for(int a=0; a<lengthI; a++) {
+                        if(fixed(a, b)) continue;
+                        int surroundingPoints = 0;
+                        double sum = 0;
+                        if(a<lengthI-1) { surroundingPoints += 1; sum += from(a+1, b); }
+                        if(a>0) { surroundingPoints += 1; sum += from(a-1, b); }
+                        if(b<lengthJ-1) { surroundingPoints += 1; sum += from(a, b+1); }
+                        if(b>0) { surroundingPoints += 1; sum += from(a, b-1); }
+                        to(a, b) = sum/surroundingPoints;
+                    }
+                }
+                from.swap(to);
+            }
+            return from;
+        }
+
+        std::string defaultInstructionSet = electrostatics::stencilInstructionSet();
+};
+
+TEST_F(StencilEngineTest, PaddedGridRoundTrip) {
+    electrostatics::doubleGrid potentials = electrostatics::doubleGrid::Random(5, 3);
+    electrostatics::PaddedGrid grid(5, 3);
+    grid.load(potentials);
+    ASSERT_EQ(7, grid.getStride());
+    ASSERT_EQ(0, grid.row(0)[-1]);
+    ASSERT_EQ(0, grid.row(2)[5]);
+    ASSERT_EQ(0, grid.row(0)[-grid.getStride()]);
+    ASSERT_EQ(potentials(4, 1), grid.row(1)[4]);
+    electrostatics::doubleGrid stored;
+    grid.store(stored);
+    ASSERT_EQ(potentials, stored);
+    ASSERT_THROW(grid.load(electrostatics::doubleGrid::Zero(3, 5)), std::invalid_argument);
+}
+
+TEST_F(StencilEngineTest, Runs) {
+    electrostatics::StencilEngine engine(*system);
+    long unknowns = 0;
+    for(const electrostatics::StencilRun &run : engine.getRuns()) {
+        ASSERT_LT(run.start, run.end);
+        for(int a=run.start; a<run.end; a++) {
+            ASSERT_FALSE(system->getBoundaryConditionPositions()(a, run.b));
+        }
+        unknowns += run.end - run.start;
+    }
+    ASSERT_EQ((long)(system->getKMax()+1 - system->getBoundaryConditionPositions().count()), unknowns);
+}
+
+TEST_F(StencilEngineTest, MatchesReferenceExactly) {
+    electrostatics::doubleGrid reference = referenceJacobi(57);
+    const char* instructionSets[] = {"scalar", "avx2", "avx512"};
+    for(const char* instructionSet : instructionSets) {
+        if(!electrostatics::stencilInstructionSetSupported(instructionSet)) continue;
+        electrostatics::useStencilInstructionSet(instructionSet);
+        electrostatics::SolvedElectrostaticSystem solved(-37, 30, -21, 18);
+        electrostatics::finiteDiffIterative(*system, solved, 57);
+        ASSERT_TRUE(reference == solved.getPotentials()) << instructionSet;
+    }
+}
+
+TEST_F(StencilEngineTest, UnsupportedInstructionSet) {
+    ASSERT_TRUE(electrostatics::stencilInstructionSetSupported("scalar"));
+    ASSERT_THROW(electrostatics::useStencilInstructionSet("sse9"), std::invalid_argument);
+}
+
+TEST_F(StencilEngineTest, TemporalBlockingMatchesExactly) {
+    electrostatics::doubleGrid reference = referenceJacobi(57);
+    int sweepsPerPass[] = {0, 1, 2, 3, 8, 57, 100};
+    for(int sweeps : sweepsPerPass) {
+        electrostatics::SolvedElectrostaticSystem solved(-37, 30, -21, 18);
+        electrostatics::finiteDiffIterative(*system, solved, 57, nullptr, sweeps);
+        ASSERT_TRUE(reference == solved.getPotentials()) << sweeps;
+    }
+}
+
+TEST_F(StencilEngineTest, AutoSweepsPerPass) {
+    electrostatics::StencilEngine engine(*system);
+    ASSERT_GE(engine.autoSweepsPerPass(), 1);
+    ASSERT_LE(engine.autoSweepsPerPass(), 32);
+}
@@ -0,0 +1,68 @@
+#include "stencilOperator.h"
+#include "finiteDiffMatrix.h"
+#include "SolvedElectrostaticSystem.h"
+#include "UnsolvedElectrostaticSystem.h"
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <Eigen/Dense>
+
+class StencilOperatorTest : public ::testing::Test {
+    protected:
+        electrostatics::UnsolvedElectrostaticSystem* system;
+
+        virtual void SetUp() {
+            system = new electrostatics::UnsolvedElectrostaticSystem(-12, 9, -7, 10);
+            system->setBoundaryCircle(0, 0, 3, 10);
+            system->setLeftBoundary(-20);
+        }
+
+        virtual void TearDown() {
+            delete system;
+        }
+};
+
+TEST_F(StencilOperatorTest, Product) {
+    electrostatics::StencilOperator A(*system);
+    Eigen::VectorXd ones = Eigen::VectorXd::Ones(system->getKMax()+1);
+    Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(system->getKMax()+1, 0, 1);
+    Eigen::VectorXd result = A*ones;
+    // Boundary rows are identity rows, every other row sums to zero
+    ASSERT_EQ(1, result(system->ij2k(0, 0)));
+    ASSERT_EQ(1, result(system->ij2k(-12, 4)));
+    ASSERT_NEAR(0, result(system->ij2k(5, 5)), 1e-15);
+    ASSERT_NEAR(0, result(system->ij2k(9, 10)), 1e-15);
+    result = A*x;
+    long k = system->ij2k(5, 5);
+    ASSERT_NEAR(x(k+1) + x(k-1) + x(k+22) + x(k-22) - 4*x(k), result(k), 1e-15);
+    k = system->ij2k(9, 10);
+    ASSERT_NEAR(x(k-1) + x(k-22) - 2*x(k), result(k), 1e-15);
+}
+
+TEST_F(StencilOperatorTest, MatrixFreeMatchesSparseLU) {
+    electrostatics::SolvedElectrostaticSystem matrixFree(-12, 9, -7, 10);
+    electrostatics::SolvedElectrostaticSystem sparseLU(-12, 9, -7, 10);
+    electrostatics::finiteDiffMatrix(*system, matrixFree, "eigenbiconmatrixfree");
+    electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu");
+    for(int i=-12; i<=9; i++) {
+        for(int j=-7; j<=10; j++) {
+            ASSERT_NEAR(sparseLU.getPotentialIJ(i, j), matrixFree.getPotentialIJ(i, j), 1e-6);
+        }
+    }
+}
+
+TEST_F(StencilOperatorTest, RelativeResidual) {
+    electrostatics::SolvedElectrostaticSystem sparseLU(-12, 9, -7, 10);
+    electrostatics::SolvedElectrostaticSystem eigenBicon(-12, 9, -7, 10);
+    ASSERT_EQ(0, electrostatics::finiteDiffMatrix(*system, sparseLU, "eigensparselu"));
+    ASSERT_LT(electrostatics::relativeResidual(*system, sparseLU), 1e-12);
+    ASSERT_GT(electrostatics::finiteDiffMatrix(*system, eigenBicon, "eigenbicon"), 0);
+    ASSERT_LT(electrostatics::relativeResidual(*system, eigenBicon), 1e-6);
+
+    // Every unknown at zero is the starting point
+    electrostatics::SolvedElectrostaticSystem zero(-12, 9, -7, 10);
+    zero.setPotentials(system->startingPotentials(nullptr));
+    ASSERT_DOUBLE_EQ(1, electrostatics::relativeResidual(*system, zero));
+
+    electrostatics::SolvedElectrostaticSystem wrongSize(-12, 9, -7, 11);
+    ASSERT_THROW(electrostatics::relativeResidual(*system, wrongSize), std::invalid_argument);
+}
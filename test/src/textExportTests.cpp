@@ -0,0 +1,112 @@
+#include "textExport.h"
+#include "ElectrostaticSystem.h"
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+
+static std::string readFile(std::string fileName) {
+    std::ifstream inputFile(fileName.c_str(), std::ios::binary);
+    std::stringstream contents;
+    contents << inputFile.rdbuf();
+    return contents.str();
+}
+
+TEST(TextExportTest, MatchesOstream) {
+    std::vector<double> values = {0, -0.0, 1, -1, 0.1, 1.0/3, -2.0/3, 100, 123456, 1234567, 1e-5, 1.5e-7,
+        -4.2e21, 99999.95, 0.000123456789, 5e-324, std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+        std::nan(""), -std::nan("")};
+    for(double value : values) {
+        std::ostringstream expected;
+        expected << value;
+        char buffer[electrostatics::maxDoubleCharacters];
+        char *end = electrostatics::formatDouble(buffer, value);
+        ASSERT_EQ(expected.str(), std::string(buffer, end));
+    }
+
+    char buffer[electrostatics::maxIntCharacters];
+    char *end = electrostatics::formatInt(buffer, -2147483647 - 1);
+    ASSERT_EQ("-2147483648", std::string(buffer, end));
+}
+
+TEST(TextExportTest, RoundTrip) {
+    std::vector<double> values = {1.0/3, -2.0/3, 0.1, 1e-300, -123456.789012345678, 5e-324,
+        std::numeric_limits<double>::lowest()};
+    for(double value : values) {
+        char buffer[electrostatics::maxDoubleCharacters];
+        char *end = electrostatics::formatDouble(buffer, value, true);
+        ASSERT_EQ(value, std::strtod(std::string(buffer, end).c_str(), nullptr));
+    }
+}
+
+TEST(TextExportTest, RowsInOrder) {
+    std::string fileName = ::testing::TempDir() + "textExportTest.txt";
+    std::string expected;
+    long numberOfRows = 300000;     // More than one block
+    for(long row=0; row<numberOfRows; row++) expected += std::to_string(row) + "\n";
+
+    electrostatics::writeTextRows(fileName, numberOfRows, 16, [](long row, char *out) {
+        out = electrostatics::formatInt(out, row);
+        *out++ = '\n';
+        return out;
+    });
+    ASSERT_EQ(expected, readFile(fileName));
+    std::remove(fileName.c_str());
+}
+
+TEST(TextExportTest, SaveFileMatchesOstream) {
+    std::string fileName = ::testing::TempDir() + "textExportTestSystem.txt";
+    electrostatics::ElectrostaticSystem system(-7, 5, -3, 9);
+    std::ostringstream expected;
+    for(int j=-3; j<=9; j++) {
+        for(int i=-7; i<=5; i++) {
+            double potential = sin(i*0.37) * exp(j*0.9) / 7;
+            system.setPotentialIJ(i, j, potential);
+            expected << potential << " ";
+        }
+        expected << "\n";
+    }
+    system.saveFile(fileName);
+    ASSERT_EQ(expected.str(), readFile(fileName));
+
+    // Every value reads back exactly
+    system.saveFile(fileName, true);
+    std::istringstream savedFile(readFile(fileName));
+    for(int j=-3; j<=9; j++) {
+        for(int i=-7; i<=5; i++) {
+            std::string value;
+            savedFile >> value;
+            ASSERT_EQ(system.getPotentialIJ(i, j), std::stod(value));
+        }
+    }
+    std::remove(fileName.c_str());
+}
+
+TEST(TextExportTest, SinglePrecisionMatchesSaveFile) {
+    std::string fileName = ::testing::TempDir() + "textExportTestFloat.txt";
+    electrostatics::ElectrostaticSystem rounded(-7, 5, -3, 9);
+    std::vector<float> potentials;
+    for(long k=0; k<=rounded.getKMax(); k++) {
+        potentials.push_back(sin(k*0.37) * 100 / 7);
+        rounded.setPotentialK(k, potentials.back());
+    }
+    electrostatics::GridView<const float> view(potentials.data(), -7, -3, 13, 13);
+    for(bool roundTrip : {false, true}) {
+        rounded.saveFile(fileName, roundTrip);
+        std::string expected = readFile(fileName);
+        electrostatics::savePotentialsText(view, fileName, roundTrip);
+        ASSERT_EQ(expected, readFile(fileName));
+    }
+    std::remove(fileName.c_str());
+}
+
+TEST(TextExportTest, UnwritableFile) {
+    electrostatics::ElectrostaticSystem system(0, 3, 0, 3);
+    ASSERT_THROW(system.saveFile("/nonexistent/directory/file"), std::runtime_error);
+}